@@ -56,6 +56,8 @@ def assemble(args, run_params, out_file, log_file, config_path):
     cmdline.extend(["--min-ovlp", str(run_params["min_overlap"])])
     if run_params["min_read_length"] > 0:
         cmdline.extend(["--min-read", str(run_params["min_read_length"])])
+    if run_params.get("target_coverage", 0) > 0:
+        cmdline.extend(["--target-cov", str(run_params["target_coverage"])])
 
     if args.extra_params:
         cmdline.extend(["--extra-params", args.extra_params])
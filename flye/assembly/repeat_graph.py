@@ -68,7 +68,8 @@ def analyse_repeats(args, run_params, input_assembly, out_folder,
 
 
 def generate_contigs(args, run_params, graph_edges, out_folder,
-                    log_file, config_file, repeat_graph, reads_alignment):
+                    log_file, config_file, repeat_graph, reads_alignment,
+                    reads_metadata):
     logger.debug("-----Begin contigger analyser log------")
 
     cmdline = [CONTIGGER_BIN, "contigger", "--graph-edges", graph_edges,
@@ -76,6 +77,8 @@ def generate_contigs(args, run_params, graph_edges, out_folder,
                "--config", config_file, "--repeat-graph", repeat_graph,
                "--graph-aln", reads_alignment, "--log", log_file,
                "--threads", str(args.threads)]
+    if os.path.isfile(reads_metadata):
+        cmdline.extend(["--read-meta", reads_metadata])
     if args.debug:
         cmdline.append("--debug")
     if args.keep_haplotypes:
@@ -90,14 +90,22 @@ def setup_params(args):
     if args.asm_coverage and args.asm_coverage < coverage:
         target_cov = args.asm_coverage
 
+    #reads are selected by the assembly module based on the local
+    #coverage estimates, preferring longer reads. The shortest reads
+    #beyond a multiple of the target coverage are filtered out before
+    #loading, so the whole dataset is never kept in memory
+    parameters["min_read_length"] = 0
     if target_cov:
-        logger.info("Using longest %dx reads for contig assembly", target_cov)
-        min_read = _get_downsample_threshold(read_lengths,
-                                             args.genome_size * target_cov)
-        logger.debug("Min read length cutoff: %d", min_read)
-        parameters["min_read_length"] = min_read
+        logger.info("Downsampling reads to %dx for contig assembly", target_cov)
+        parameters["target_coverage"] = target_cov
+        prefilter_cov = target_cov * cfg.vals["downsample_prefilter_ratio"]
+        if prefilter_cov < coverage:
+            min_read = _get_downsample_threshold(read_lengths,
+                                                 args.genome_size * prefilter_cov)
+            logger.debug("Min read length cutoff: %d", min_read)
+            parameters["min_read_length"] = min_read
     else:
-        parameters["min_read_length"] = 0
+        parameters["target_coverage"] = 0
 
     return parameters
 
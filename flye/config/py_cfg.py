@@ -30,6 +30,9 @@ vals = {
             "subasm" : [1000, 1000]
         },
         "max_meta_overlap" : 10000,
+        #with --asm-coverage, only the longest reads up to this multiple
+        #of the target coverage are loaded for the read selection
+        "downsample_prefilter_ratio" : 2,
 
         #polishing
         "simple_kmer_length" : 4,
@@ -38,6 +41,7 @@ vals = {
         "max_bubble_branches" : 50,
         "max_read_coverage" : 1000,
         "min_polish_aln_len" : 500,
+        "polish_chunk_size" : 1000000,
 
         #final coverage filtering
         "relative_minimum_coverage" : 5,
@@ -140,6 +140,8 @@ class JobRepeat(Job):
                                                         "repeat_graph_edges.fasta")
         self.out_files["reads_alignment"] = os.path.join(self.work_dir,
                                                          "read_alignment_dump")
+        self.out_files["reads_metadata"] = os.path.join(self.work_dir,
+                                                        "read_metadata")
         #self.out_files["repeats_dump"] = os.path.join(self.work_dir,
         #                                              "repeats_dump")
 
@@ -155,13 +157,14 @@ class JobRepeat(Job):
 
 class JobContigger(Job):
     def __init__(self, args, work_dir, log_file, repeat_graph_edges,
-                 repeat_graph, reads_alignment):
+                 repeat_graph, reads_alignment, reads_metadata):
         super(JobContigger, self).__init__()
 
         self.args = args
         self.repeat_graph_edges = repeat_graph_edges
         self.repeat_graph = repeat_graph
         self.reads_alignment = reads_alignment
+        self.reads_metadata = reads_metadata
         self.log_file = log_file
         self.name = "contigger"
 
@@ -185,7 +188,8 @@ class JobContigger(Job):
         logger.info("Generating contigs")
         repeat.generate_contigs(self.args, Job.run_params, self.repeat_graph_edges,
                                 self.work_dir, self.log_file, self.args.asm_config,
-                                self.repeat_graph, self.reads_alignment)
+                                self.repeat_graph, self.reads_alignment,
+                                self.reads_metadata)
 
         if os.path.getsize(self.out_files["contigs"]) == 0:
             raise asm.AssembleException("No contigs were assembled - "
@@ -357,6 +361,7 @@ def _create_job_list(args, work_dir, log_file):
     repeat_graph_edges = jobs[-1].out_files["repeat_graph_edges"]
     repeat_graph = jobs[-1].out_files["repeat_graph"]
     reads_alignment = jobs[-1].out_files["reads_alignment"]
+    reads_metadata = jobs[-1].out_files["reads_metadata"]
 
     #Trestle: Resolve Unbridged Repeats
     #if not args.no_trestle and not args.meta and args.read_type == "raw":
@@ -369,7 +374,7 @@ def _create_job_list(args, work_dir, log_file):
 
     #Contigger
     jobs.append(JobContigger(args, work_dir, log_file, repeat_graph_edges,
-                             repeat_graph, reads_alignment))
+                             repeat_graph, reads_alignment, reads_metadata))
     raw_contigs = jobs[-1].out_files["contigs"]
     scaffold_links = jobs[-1].out_files["scaffold_links"]
     graph_file = jobs[-1].out_files["assembly_graph"]
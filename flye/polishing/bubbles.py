@@ -9,6 +9,7 @@ Separates alignment into small bubbles for further correction
 from __future__ import absolute_import
 from __future__ import division
 import logging
+import struct
 from bisect import bisect
 from flye.six.moves import range
 from collections import defaultdict
@@ -97,7 +98,7 @@ def _thread_worker(aln_reader, chunk_feeder, contigs_info, err_mode,
             if bubbles_file_lock:
                 bubbles_file_lock.acquire()
 
-            _output_bubbles(ctg_bubbles, open(bubbles_file, "a"))
+            _output_bubbles(ctg_bubbles, open(bubbles_file, "ab"))
             results_queue.put((ctg_id, len(ctg_bubbles), num_long_bubbles,
                                num_empty, num_long_branch, aln_errors,
                                mean_cov))
@@ -119,7 +120,7 @@ def make_bubbles(alignment_path, contigs_info, contigs_path,
     """
     The main function: takes an alignment and returns bubbles
     """
-    CHUNK_SIZE = 1000000
+    CHUNK_SIZE = cfg.vals["polish_chunk_size"]
 
     contigs_fasta = fp.read_sequence_dict(contigs_path)
     manager = None if num_proc == 1 else multiprocessing.Manager()
@@ -179,19 +180,25 @@ def make_bubbles(alignment_path, contigs_info, contigs_path,
 
 def _output_bubbles(bubbles, out_stream):
     """
-    Outputs list of bubbles into file
+    Outputs list of bubbles into a binary file. Each record is prefixed
+    by its length and contains contig id, position, sub-position,
+    consensus and branches (strings are prefixed by their lengths)
     """
+    def pack_string(string):
+        encoded = string.encode()
+        return struct.pack("<I", len(encoded)) + encoded
+
     for bubble in bubbles:
         if len(bubble.branches) == 0:
             raise Exception("No branches in a bubble")
-        out_stream.write(">{0} {1} {2} {3}\n".format(bubble.contig_id,
-                                                     bubble.position,
-                                                     len(bubble.branches),
-                                                     bubble.sub_position))
-        out_stream.write(bubble.consensus + "\n")
-        for branch_id, branch in enumerate(bubble.branches):
-            out_stream.write(">{0}\n".format(branch_id))
-            out_stream.write(branch + "\n")
+        fields = [pack_string(bubble.contig_id),
+                  struct.pack("<ii", bubble.position, bubble.sub_position),
+                  pack_string(bubble.consensus),
+                  struct.pack("<I", len(bubble.branches))]
+        fields.extend(pack_string(branch) for branch in bubble.branches)
+        record = b"".join(fields)
+        out_stream.write(struct.pack("<I", len(record)))
+        out_stream.write(record)
 
     out_stream.flush()
 
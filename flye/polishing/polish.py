@@ -14,10 +14,9 @@ import os
 from collections import defaultdict
 import gzip
 
-from flye.polishing.alignment import (make_alignment, get_contigs_info,
-                                      merge_chunks, split_into_chunks)
+from flye.polishing.alignment import (make_alignment, merge_chunks,
+                                      split_into_chunks)
 from flye.utils.sam_parser import SynchronizedSamReader
-from flye.polishing.bubbles import make_bubbles
 import flye.utils.fasta_parser as fp
 from flye.utils.utils import which
 import flye.config.py_cfg as cfg
@@ -86,19 +85,17 @@ def polish(contig_seqs, read_seqs, work_dir, num_iters, num_threads, read_platfo
             alignment_file = read_seqs[0]
 
         #####
-        logger.info("Separating alignment into bubbles")
-        contigs_info = get_contigs_info(prev_assembly)
-        bubbles_file = os.path.join(work_dir,
-                                    "bubbles_{0}.fasta".format(i + 1))
-        coverage_stats, mean_aln_error = \
-            make_bubbles(alignment_file, contigs_info, prev_assembly,
-                         read_platform, num_threads,
-                         bubbles_file)
-
-        logger.info("Alignment error rate: %f", mean_aln_error)
+        logger.info("Separating alignment into bubbles and correcting them")
         consensus_out = os.path.join(work_dir, "consensus_{0}.fasta".format(i + 1))
         polished_file = os.path.join(work_dir, "polished_{0}.fasta".format(i + 1))
-        if os.path.getsize(bubbles_file) == 0:
+        bubbles_stats = os.path.join(work_dir, "bubbles_stats_{0}.txt".format(i + 1))
+        _run_polish_bin(alignment_file, prev_assembly, read_platform,
+                        subs_matrix, hopo_matrix, consensus_out, bubbles_stats,
+                        num_threads, output_progress, use_hopo)
+        coverage_stats, mean_aln_error = _read_bubbles_stats(bubbles_stats)
+        logger.info("Alignment error rate: %f", mean_aln_error)
+
+        if os.path.getsize(consensus_out) == 0:
             logger.info("No reads were aligned during polishing")
             if not output_progress:
                 logger.disabled = logger_state
@@ -107,16 +104,12 @@ def polish(contig_seqs, read_seqs, work_dir, num_iters, num_threads, read_platfo
             gzip.open(bed_coverage, "wt")
             return polished_file, stats_file
 
-        #####
-        logger.info("Correcting bubbles")
-        _run_polish_bin(bubbles_file, subs_matrix, hopo_matrix,
-                        consensus_out, num_threads, output_progress, use_hopo)
         polished_fasta, polished_lengths, bubble_coverages = _compose_sequence(consensus_out)
         fp.write_fasta_dict(polished_fasta, polished_file)
 
         #Cleanup
-        os.remove(bubbles_file)
         os.remove(consensus_out)
+        os.remove(bubbles_stats)
         if not bam_input:
             os.remove(alignment_file)
 
@@ -280,14 +273,27 @@ def filter_by_coverage(args, stats_in, contigs_in, stats_out, contigs_out):
                     ctg_stats[ctg_id][0], ctg_stats[ctg_id][1]))
 
 
-def _run_polish_bin(bubbles_in, subs_matrix, hopo_matrix,
-                    consensus_out, num_threads, output_progress, use_hopo):
+def _run_polish_bin(alignment_bam, contigs_fasta, read_platform, subs_matrix,
+                    hopo_matrix, consensus_out, bubbles_stats, num_threads,
+                    output_progress, use_hopo):
     """
-    Invokes polishing binary
+    Invokes polishing binary. Bubbles are generated from
+    the read alignment by the binary itself
     """
-    cmdline = [POLISH_BIN, "polisher", "--bubbles", bubbles_in, "--subs-mat", subs_matrix,
-               "--hopo-mat", hopo_matrix, "--out", consensus_out,
-               "--threads", str(num_threads)]
+    err_mode = cfg.vals["err_modes"][read_platform]
+    cmdline = [POLISH_BIN, "polisher", "--bam", alignment_bam,
+               "--contigs", contigs_fasta, "--stats", bubbles_stats,
+               "--solid-missmatch", str(err_mode["solid_missmatch"]),
+               "--solid-indel", str(err_mode["solid_indel"]),
+               "--solid-kmer-len", str(cfg.vals["solid_kmer_length"]),
+               "--simple-kmer-len", str(cfg.vals["simple_kmer_length"]),
+               "--max-bubble-len", str(cfg.vals["max_bubble_length"]),
+               "--max-bubble-branches", str(cfg.vals["max_bubble_branches"]),
+               "--max-read-coverage", str(cfg.vals["max_read_coverage"]),
+               "--min-aln-len", str(cfg.vals["min_polish_aln_len"]),
+               "--chunk-size", str(cfg.vals["polish_chunk_size"]),
+               "--subs-mat", subs_matrix, "--hopo-mat", hopo_matrix,
+               "--out", consensus_out, "--threads", str(num_threads)]
     if not output_progress:
         cmdline.append("--quiet")
 
@@ -304,6 +310,23 @@ def _run_polish_bin(bubbles_in, subs_matrix, hopo_matrix,
         raise PolishException(str(e))
 
 
+def _read_bubbles_stats(stats_file):
+    """
+    Reads per-contig coverage and the mean alignment error rate
+    written by the polishing binary
+    """
+    coverage_stats = {}
+    mean_aln_error = 0.0
+    with open(stats_file, "r") as f:
+        for line in f:
+            tokens = line.strip().split("\t")
+            if tokens[0] == "#mean_aln_error":
+                mean_aln_error = float(tokens[1])
+            else:
+                coverage_stats[tokens[0]] = int(tokens[1])
+    return coverage_stats, mean_aln_error
+
+
 def _compose_sequence(consensus_file):
     """
     Concatenates bubbles consensuses into genome
@@ -0,0 +1,269 @@
+//(c) 2020 by Authors
+//This file is a part of Flye program.
+//Released under the BSD license (see LICENSE file)
+
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+#include "containment_filter.h"
+#include "../sequence/alignment.h"
+#include "../common/config.h"
+#include "../common/logger.h"
+#include "../common/parallel.h"
+
+
+void ContainmentFilter::removeContained(std::vector<FastaRecord>& sequences)
+{
+	//rank sequences from the longest to the shortest,
+	//so that a sequence could only be contained by the lower ranks
+	std::vector<size_t> order(sequences.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(),
+					 [&sequences](size_t a, size_t b)
+					 {return sequences[a].sequence.length() >
+					 		 sequences[b].sequence.length();});
+	std::vector<const DnaSequence*> rankedSeqs;
+	for (size_t seqId : order) rankedSeqs.push_back(&sequences[seqId].sequence);
+
+	this->buildSketch(rankedSeqs);
+
+	//first, every sequence is queried against all longer ones in parallel
+	std::vector<uint32_t> allRanks(rankedSeqs.size());
+	std::iota(allRanks.begin(), allRanks.end(), 0);
+	const std::vector<char> noneRemoved(rankedSeqs.size(), false);
+	std::vector<char> contained(rankedSeqs.size(), false);
+	std::vector<uint32_t> containers(rankedSeqs.size(), 0);
+	std::function<void(const uint32_t&)> checkFunc =
+	[this, &rankedSeqs, &noneRemoved, &contained, &containers] 
+		(const uint32_t& rank)
+	{
+		contained[rank] = this->isContained(rankedSeqs, rank, noneRemoved,
+											containers[rank]);
+	};
+	processInParallel(allRanks, checkFunc,
+					  Parameters::get().numThreads, false);
+
+	//containment is not transitive with the overhang tolerance, so
+	//only the kept sequences may contain others. If the container that
+	//was found is removed itself, the query is repeated against the
+	//kept sequences only (this is rare, so it is done sequentially)
+	for (uint32_t rank = 0; rank < rankedSeqs.size(); ++rank)
+	{
+		if (contained[rank] && contained[containers[rank]])
+		{
+			contained[rank] = this->isContained(rankedSeqs, rank, contained,
+												containers[rank]);
+		}
+	}
+	_sketch.clear();
+
+	std::vector<char> containedById(sequences.size(), false);
+	for (size_t rank = 0; rank < order.size(); ++rank)
+	{
+		containedById[order[rank]] = contained[rank];
+	}
+
+	std::vector<FastaRecord> newSequences;
+	for (size_t i = 0; i < sequences.size(); ++i)
+	{
+		if (!containedById[i]) newSequences.push_back(std::move(sequences[i]));
+	}
+	Logger::get().info() << "Contained seqs: "
+		<< sequences.size() - newSequences.size();
+	newSequences.swap(sequences);
+}
+
+
+void ContainmentFilter::buildSketch(const std::vector<const DnaSequence*>& sequences)
+{
+	std::vector<std::vector<KmerPosition>> seqMinimizers(sequences.size());
+	std::vector<uint32_t> allRanks(sequences.size());
+	std::iota(allRanks.begin(), allRanks.end(), 0);
+	std::function<void(const uint32_t&)> sketchFunc =
+	[this, &sequences, &seqMinimizers] (const uint32_t& rank)
+	{
+		seqMinimizers[rank] = yieldMinimizers(*sequences[rank], _minimizerWindow);
+	};
+	processInParallel(allRanks, sketchFunc,
+					  Parameters::get().numThreads, false);
+
+	//distribute minimizers into partitions, standard k-mer form
+	//is used so both strands are matched with a single lookup
+	_sketch.assign(NUM_PARTITIONS, std::vector<SketchEntry>());
+	size_t totalLen = 0;
+	size_t totalEntries = 0;
+	for (uint32_t rank = 0; rank < sequences.size(); ++rank)
+	{
+		for (auto kmerPos : seqMinimizers[rank])
+		{
+			SketchEntry entry;
+			entry.revComp = kmerPos.kmer.standardForm();
+			entry.kmer = kmerPos.kmer;
+			entry.seqRank = rank;
+			entry.position = kmerPos.position;
+			_sketch[entry.kmer.hash() % NUM_PARTITIONS].push_back(entry);
+		}
+		totalLen += sequences[rank]->length();
+		totalEntries += seqMinimizers[rank].size();
+		seqMinimizers[rank] = std::vector<KmerPosition>();
+	}
+
+	std::vector<size_t> allPartitions(NUM_PARTITIONS);
+	std::iota(allPartitions.begin(), allPartitions.end(), 0);
+	std::function<void(const size_t&)> sortFunc =
+	[this] (const size_t& partId)
+	{
+		std::sort(_sketch[partId].begin(), _sketch[partId].end(),
+				  [](const SketchEntry& e1, const SketchEntry& e2)
+				  {return e1.kmer.numRepr() < e2.kmer.numRepr();});
+	};
+	processInParallel(allPartitions, sortFunc,
+					  Parameters::get().numThreads, false);
+
+	size_t uniqueKmers = 0;
+	for (auto& partition : _sketch)
+	{
+		for (size_t i = 0; i < partition.size(); ++i)
+		{
+			if (i == 0 || partition[i].kmer != partition[i - 1].kmer) ++uniqueKmers;
+		}
+	}
+
+	//same repeat cutoff as in the read index
+	float meanFreq = (float)totalEntries / std::max(uniqueKmers, (size_t)1);
+	_maxKmerFreq = std::max(1.0f, meanFreq * (float)Config::get("repeat_kmer_rate"));
+	_sampleRate = (float)totalLen / std::max(totalEntries, (size_t)1);
+	Logger::get().debug() << "Containment sketch: " << totalEntries << " entries, "
+		<< uniqueKmers << " k-mers, max freq: " << _maxKmerFreq;
+}
+
+
+bool ContainmentFilter::isContained(const std::vector<const DnaSequence*>& sequences,
+									uint32_t qryRank, 
+									const std::vector<char>& removed,
+									uint32_t& outContainer) const
+{
+	if (qryRank == 0) return false;
+
+	const int32_t kmerSize = Parameters::get().kmerSize;
+	const DnaSequence& qrySeq = *sequences[qryRank];
+	const int32_t qryLen = qrySeq.length();
+	if (qryLen < kmerSize + _minimizerWindow) return false;
+
+	//collect minimizer matches against longer sequences only.
+	//For matches on the opposite strand, query coordinates are
+	//converted to the reverse-complement query
+	std::vector<SeedMatch> matches;
+	for (auto kmerPos : yieldMinimizers(qrySeq, _minimizerWindow))
+	{
+		bool qryRevComp = kmerPos.kmer.standardForm();
+		auto& partition = _sketch[kmerPos.kmer.hash() % NUM_PARTITIONS];
+		auto range = std::equal_range(partition.begin(), partition.end(),
+									  SketchEntry {kmerPos.kmer, 0, 0, 0},
+									  [](const SketchEntry& e1, const SketchEntry& e2)
+									  {return e1.kmer.numRepr() < e2.kmer.numRepr();});
+		if ((size_t)(range.second - range.first) > _maxKmerFreq) continue;
+
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			if (it->seqRank >= qryRank || removed[it->seqRank]) continue;
+
+			bool revComp = (it->revComp != qryRevComp);
+			int32_t qryPos = !revComp ? kmerPos.position :
+										qryLen - kmerPos.position - kmerSize;
+			matches.push_back({it->seqRank, revComp, it->position - qryPos,
+							   qryPos, it->position});
+		}
+	}
+
+	//longer targets first - they are the most likely to contain the query
+	std::sort(matches.begin(), matches.end(),
+			  [](const SeedMatch& m1, const SeedMatch& m2)
+			  {
+			  	if (m1.seqRank != m2.seqRank) return m1.seqRank < m2.seqRank;
+				if (m1.revComp != m2.revComp) return m1.revComp < m2.revComp;
+				return m1.diagonal < m2.diagonal;
+			  });
+
+	const DnaSequence qryComplement = qrySeq.complement();
+	size_t clusterStart = 0;
+	for (size_t i = 1; i <= matches.size(); ++i)
+	{
+		//split by target, strand and large jumps in diagonal
+		if (i < matches.size() &&
+			matches[i].seqRank == matches[clusterStart].seqRank &&
+			matches[i].revComp == matches[clusterStart].revComp &&
+			matches[i].diagonal - matches[i - 1].diagonal < _maxJump) continue;
+
+		const DnaSequence& clusterQry = !matches[clusterStart].revComp ?
+										qrySeq : qryComplement;
+		if (this->checkCluster(clusterQry,
+							   *sequences[matches[clusterStart].seqRank],
+							   matches.begin() + clusterStart,
+							   matches.begin() + i))
+		{
+			outContainer = matches[clusterStart].seqRank;
+			return true;
+		}
+		clusterStart = i;
+	}
+
+	return false;
+}
+
+
+//checks if the chain of seed matches spans the entire query
+//with no large gaps and estimates the sequence divergence
+bool ContainmentFilter::checkCluster(const DnaSequence& qrySeq,
+									 const DnaSequence& trgSeq,
+									 std::vector<SeedMatch>::iterator begin,
+									 std::vector<SeedMatch>::iterator end) const
+{
+	const int32_t kmerSize = Parameters::get().kmerSize;
+	const int32_t qryLen = qrySeq.length();
+
+	//quick rejection of spurious clusters: the matched minimizers,
+	//scaled by the sampling rate, should cover at least 1% of the query.
+	//The actual divergence threshold is checked below
+	const float MIN_SEED_RATE = 0.01f;
+	if ((end - begin) * _sampleRate < MIN_SEED_RATE * qryLen) return false;
+
+	std::sort(begin, end, [](const SeedMatch& m1, const SeedMatch& m2)
+						  {return m1.qryPos < m2.qryPos;});
+	if (begin->qryPos > _maxOverhang) return false;
+	if (qryLen - ((end - 1)->qryPos + kmerSize) > _maxOverhang) return false;
+
+	int32_t trgBegin = begin->trgPos;
+	int32_t trgEnd = begin->trgPos;
+	int32_t uniqueSeeds = 0;
+	for (auto it = begin; it != end; ++it)
+	{
+		if (it != begin)
+		{
+			if (it->qryPos - (it - 1)->qryPos > _maxJump) return false;
+			if (it->qryPos == (it - 1)->qryPos) continue;
+		}
+		++uniqueSeeds;
+		trgBegin = std::min(trgBegin, it->trgPos);
+		trgEnd = std::max(trgEnd, it->trgPos);
+	}
+
+	OverlapRange ovlp(FastaRecord::ID_NONE, FastaRecord::ID_NONE,
+					  begin->qryPos, trgBegin, qryLen, trgSeq.length());
+	ovlp.curEnd = (end - 1)->qryPos + kmerSize - 1;
+	ovlp.extEnd = trgEnd + kmerSize - 1;
+	if (ovlp.curRange() <= 0 || ovlp.extRange() <= 0) return false;
+
+	//same estimates as in OverlapDetector
+	float matchRate = (float)uniqueSeeds * _sampleRate /
+					  std::max(ovlp.curRange(), ovlp.extRange());
+	matchRate = std::min(matchRate, 1.0f);
+	float divergence = std::log(1 / matchRate) / kmerSize;
+	if (_nuclAlignment)
+	{
+		divergence = getAlignmentErrEdlib(ovlp, qrySeq, trgSeq,
+										  _maxDivergence, _useHpc);
+	}
+	return divergence < _maxDivergence;
+}
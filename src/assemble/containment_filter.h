@@ -0,0 +1,82 @@
+//(c) 2020 by Authors
+//This file is a part of Flye program.
+//Released under the BSD license (see LICENSE file)
+
+//Finds sequences (e.g. disjointigs) that are contained
+//inside other, longer sequences. Unlike the general overlap
+//detection, it does not require the full k-mer index and
+//all-vs-all overlaps: each sequence is queried against a minimizer
+//sketch of the longer sequences, and the search stops as soon as
+//the first containing sequence is confirmed. Only the sequences
+//that are kept are considered as containers.
+
+#pragma once
+
+#include <vector>
+
+#include "../sequence/sequence_container.h"
+#include "../sequence/kmer.h"
+
+class ContainmentFilter
+{
+public:
+	ContainmentFilter(int minimizerWindow, int maxOverhang, int maxJump,
+					  float maxDivergence, bool nuclAlignment, bool useHpc):
+		_minimizerWindow(minimizerWindow),
+		_maxOverhang(maxOverhang),
+		_maxJump(maxJump),
+		_maxDivergence(maxDivergence),
+		_nuclAlignment(nuclAlignment),
+		_useHpc(useHpc),
+		_sampleRate(1.0f),
+		_maxKmerFreq(0)
+	{}
+
+	//removes contained sequences, keeping the order of the rest
+	void removeContained(std::vector<FastaRecord>& sequences);
+
+private:
+	struct SketchEntry
+	{
+		Kmer kmer;
+		uint32_t seqRank : 31;
+		uint32_t revComp : 1;
+		int32_t  position;
+	};
+	static_assert(sizeof(SketchEntry) == 16,
+				  "Unexpected size of SketchEntry structure");
+
+	struct SeedMatch
+	{
+		uint32_t seqRank;
+		bool	 revComp;
+		int32_t  diagonal;
+		int32_t  qryPos;
+		int32_t  trgPos;
+	};
+
+	void buildSketch(const std::vector<const DnaSequence*>& sequences);
+	//finds the longest sequence (not marked as removed) that contains
+	//the query, the search is limited to the longer sequences
+	bool isContained(const std::vector<const DnaSequence*>& sequences,
+					 uint32_t qryRank, const std::vector<char>& removed,
+					 uint32_t& outContainer) const;
+	bool checkCluster(const DnaSequence& qrySeq, const DnaSequence& trgSeq,
+					  std::vector<SeedMatch>::iterator begin,
+					  std::vector<SeedMatch>::iterator end) const;
+
+	const int   _minimizerWindow;
+	const int   _maxOverhang;
+	const int   _maxJump;
+	const float _maxDivergence;
+	const bool  _nuclAlignment;
+	const bool  _useHpc;
+
+	float  _sampleRate;
+	size_t _maxKmerFreq;
+
+	//sketch is partitioned by k-mer hash, each
+	//partition is sorted by k-mer for binary search
+	const size_t NUM_PARTITIONS = 1024;
+	std::vector<std::vector<SketchEntry>> _sketch;
+};
@@ -16,6 +16,8 @@
 #include "../common/config.h"
 #include "../assemble/extender.h"
 #include "../assemble/parameters_estimator.h"
+#include "../assemble/containment_filter.h"
+#include "../assemble/read_subsampler.h"
 #include "../common/logger.h"
 #include "../common/utils.h"
 #include "../common/memory_info.h"
@@ -26,14 +28,15 @@ bool parseArgs(int argc, char** argv, std::string& readsFasta,
 			   std::string& outAssembly, std::string& logFile, size_t& genomeSize,
 			   int& kmerSize, bool& debug, size_t& numThreads, int& minOverlap, 
 			   std::string& configPath, int& minReadLength, bool& unevenCov, 
-			   std::string& extraParams, bool& shortMode)
+			   std::string& extraParams, bool& shortMode, int& targetCoverage)
 {
 	auto printUsage = []()
 	{
 		std::cerr << "Usage: flye-assemble "
 				  << " --reads path --out-asm path --config path [--genome-size size]\n"
 				  << "\t\t[--min-read length] [--log path] [--treads num] [--extra-params]\n"
-				  << "\t\t[--kmer size] [--meta] [--short] [--min-ovlp size] [--debug] [-h]\n\n"
+				  << "\t\t[--kmer size] [--meta] [--short] [--min-ovlp size] [--target-cov cov]\n"
+				  << "\t\t[--debug] [-h]\n\n"
 				  << "Required arguments:\n"
 				  << "  --reads path\tcomma-separated list of read files\n"
 				  << "  --out-asm path\tpath to output file\n"
@@ -43,6 +46,8 @@ bool parseArgs(int argc, char** argv, std::string& readsFasta,
 				  << "  --kmer size\tk-mer size [default = 15] \n"
 				  << "  --min-ovlp size\tminimum overlap between reads "
 				  << "[default = 5000] \n"
+				  << "  --target-cov cov\tdownsample reads to the given coverage "
+				  << "[default = not set] \n"
 				  << "  --debug \t\tenable debug output "
 				  << "[default = false] \n"
 				  << "  --meta \t\tenable uneven coverage (metagenome) mode "
@@ -70,6 +75,7 @@ bool parseArgs(int argc, char** argv, std::string& readsFasta,
 		{"kmer", required_argument, 0, 0},
 		{"min-ovlp", required_argument, 0, 0},
 		{"extra-params", required_argument, 0, 0},
+		{"target-cov", required_argument, 0, 0},
 		{"meta", no_argument, 0, 0},
 		{"short", no_argument, 0, 0},
 		{"debug", no_argument, 0, 0},
@@ -108,6 +114,8 @@ bool parseArgs(int argc, char** argv, std::string& readsFasta,
 				configPath = optarg;
 			else if (!strcmp(longOptions[optionIndex].name, "extra-params"))
 				extraParams = optarg;
+			else if (!strcmp(longOptions[optionIndex].name, "target-cov"))
+				targetCoverage = atoi(optarg);
 			break;
 
 		case 'h':
@@ -128,60 +136,16 @@ bool parseArgs(int argc, char** argv, std::string& readsFasta,
 void removeContainedDisjointigs(std::vector<FastaRecord>& disjointigs,
 								float divergenceThreshold)
 {
-	SequenceContainer disjSequences;
-	for (auto& disj : disjointigs) disjSequences.addSequence(disj.sequence, disj.description);
-	disjSequences.buildPositionIndex();
-
-	VertexIndex vertIndex(disjSequences);
+	Logger::get().info() << "Filtering contained disjointigs";
 	bool useMinimizers = Config::get("use_minimizers");
 	int minWnd = useMinimizers ? Config::get("minimizer_window") : 1;
-	vertIndex.buildIndexMinimizers(/*min freq*/ 1, minWnd);
-
-	const int FLANK = (int)Config::get("maximum_overhang");
-
-	OverlapDetector ovlp(disjSequences, vertIndex,
-						 (int)Config::get("maximum_jump"), 
-						 Parameters::get().minimumOverlap,
-						 (int)Config::get("maximum_overhang"),
-						 /*store alignment*/ false,
-						 /*only max ovlp*/ true,
-						 divergenceThreshold,
-						 (bool)Config::get("reads_base_alignment"),
-						 /*partition bad map*/ false,
-						 (bool)Config::get("hpc_scoring_on"));
-	OverlapContainer disjOverlaps(ovlp, disjSequences);
-
-	Logger::get().info() << "Filtering contained disjointigs";
-	disjOverlaps.findAllOverlaps();
-	std::unordered_set<std::string> containedDisj;
-	for (auto& seq : disjSequences.iterSeqs())
-	{
-		for (auto& ovlp : disjOverlaps.lazySeqOverlaps(seq.id))
-		{
-			//Logger::get().debug() << disjSequences.seqName(ovlp.curId) << " " << ovlp.curLen << " " <<
-			//	ovlp.curBegin << " " << ovlp.curEnd << " " << disjSequences.seqName(ovlp.extId)
-			//	<< " " << ovlp.extLen << " " << ovlp.extBegin << " " << ovlp.extEnd;
-
-			bool contained = (std::max(ovlp.curBegin, ovlp.curLen - ovlp.curEnd) < FLANK) ||
-							 (std::max(ovlp.extBegin, ovlp.extLen - ovlp.extEnd) < FLANK);
-			if (contained)
-			{
-				FastaRecord::Id contId = ovlp.curLen < ovlp.extLen ? ovlp.curId : ovlp.extId;
-				containedDisj.insert(disjSequences.seqName(contId).substr(1));
-			}
-		}
-	}
-	Logger::get().info() << "Contained seqs: " << containedDisj.size();
-
-	std::vector<FastaRecord> newDisj;
-	for (auto& disj : disjointigs)
-	{
-		if (!containedDisj.count(disj.description))
-		{
-			newDisj.push_back(disj);
-		}
-	}
-	newDisj.swap(disjointigs);
+	ContainmentFilter filter(minWnd,
+							 (int)Config::get("maximum_overhang"),
+							 (int)Config::get("maximum_jump"),
+							 divergenceThreshold,
+							 (bool)Config::get("reads_base_alignment"),
+							 (bool)Config::get("hpc_scoring_on"));
+	filter.removeContained(disjointigs);
 }
 
 int assemble_main(int argc, char** argv)
@@ -199,6 +163,7 @@ int assemble_main(int argc, char** argv)
 	bool unevenCov = false;
 	size_t numThreads = 1;
 	bool shortMode = false;
+	int targetCoverage = 0;
 	std::string readsFasta;
 	std::string outAssembly;
 	std::string logFile;
@@ -207,7 +172,8 @@ int assemble_main(int argc, char** argv)
 
 	if (!parseArgs(argc, argv, readsFasta, outAssembly, logFile, genomeSize,
 				   kmerSize, debugging, numThreads, minOverlap, configPath, 
-				   minReadLength, unevenCov, extraParams, shortMode)) return 1;
+				   minReadLength, unevenCov, extraParams, shortMode,
+				   targetCoverage)) return 1;
 
 	Logger::get().setDebugging(debugging);
 	if (!logFile.empty()) Logger::get().setOutputFile(logFile);
@@ -248,9 +214,25 @@ int assemble_main(int argc, char** argv)
 		//only use reads that are longer than minOverlap,
 		//or a specified threshold (used for downsampling)
 		minReadLength = std::max(minReadLength, minOverlap);
+		SequenceContainer allReads;
+		SequenceContainer& loadedReads = targetCoverage > 0 ? 
+										 allReads : readsContainer;
 		for (auto& readsFile : readsList)
 		{
-			readsContainer.loadFromFile(readsFile, minReadLength);
+			loadedReads.loadFromFile(readsFile, minReadLength);
+		}
+
+		//coverage-based downsampling before indexing
+		if (targetCoverage > 0)
+		{
+			bool useMinimizers = Config::get("use_minimizers");
+			int minWnd = useMinimizers ? Config::get("minimizer_window") : 1;
+			ReadSubsampler subsampler(allReads, minWnd);
+			for (auto readId : subsampler.selectReads(targetCoverage))
+			{
+				readsContainer.addSequence(allReads.getSeq(readId),
+										   allReads.seqName(readId).substr(1));
+			}
 		}
 	}
 	catch (SequenceContainer::ParseException& e)
@@ -283,7 +265,16 @@ int assemble_main(int argc, char** argv)
 	}
 	else	//indexing using solid k-mers
 	{
-		vertexIndex.countKmers();
+		//streaming estimate of the k-mer statistics, used to choose
+		//the k-mer counter and to pre-allocate the index
+		ParametersEstimator estimator(readsContainer);
+		estimator.sketchKmers();
+
+		bool useFlatCounter = estimator.preferFlatCounter();
+		Logger::get().debug() << "Using " << (useFlatCounter ? "flat" : "hash")
+			<< " k-mer counter";
+		vertexIndex.setExpectedIndexSize(estimator.solidKmers(MIN_FREQ));
+		vertexIndex.countKmers(useFlatCounter, estimator.distinctKmers());
 		vertexIndex.buildIndexUnevenCoverage(MIN_FREQ, SELECT_RATE, 
 											 TANDEM_FREQ);
 	}
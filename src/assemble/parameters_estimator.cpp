@@ -2,70 +2,119 @@
 //This file is a part of ABruijn program.
 //Released under the BSD license (see LICENSE file)
 
+#include <cmath>
+
 #include "parameters_estimator.h"
 #include "../common/logger.h"
+#include "../common/parallel.h"
+#include "../common/memory_info.h"
 
 
-size_t ParametersEstimator::genomeSizeEstimate()
+void ParametersEstimator::addToSketch(Kmer kmer)
 {
-	return _takenKmers;
+	size_t hash = kmer.hash();
+
+	//HyperLogLog: low bits select the register, the rest
+	//of the hash gives the position of the first set bit
+	size_t regId = hash & (HLL_REGISTERS - 1);
+	size_t rest = hash >> HLL_BITS;
+	uint8_t rank = 1;
+	while (rank <= 64 - HLL_BITS && !(rest & 1))
+	{
+		++rank;
+		rest >>= 1;
+	}
+	uint8_t expected = _hllRegisters[regId];
+	while (expected < rank &&
+		   !_hllRegisters[regId].compare_exchange_weak(expected, rank)) {}
+
+	//middle bits are used for sampling, since the low bits
+	//also define the bucket of the hash table
+	if ((hash >> 32) % SAMPLE_RATE == 0)
+	{
+		_sampledCounts.upsert(kmer, [](size_t& num){++num;}, 1);
+	}
 }
 
 
-void ParametersEstimator::estimateMinKmerCount()
+size_t ParametersEstimator::hllEstimate() const
 {
-	const int MIN_CUTOFF = 2;
+	const double alpha = 0.7213 / (1 + 1.079 / HLL_REGISTERS);
+	double sum = 0;
+	size_t zeroRegisters = 0;
+	for (size_t i = 0; i < HLL_REGISTERS; ++i)
+	{
+		sum += std::pow(2.0, -(double)_hllRegisters[i]);
+		if (_hllRegisters[i] == 0) ++zeroRegisters;
+	}
+	double estimate = alpha * HLL_REGISTERS * HLL_REGISTERS / sum;
 
-	size_t takenKmers = 0;
-	size_t cutoff = 0;
-	size_t prevDiff = 0;
-	for (auto mapPair = _vertexIndex.getKmerHist().rbegin();
-		 mapPair != _vertexIndex.getKmerHist().rend(); ++mapPair)
+	//linear counting for small cardinalities
+	if (estimate < 2.5 * HLL_REGISTERS && zeroRegisters > 0)
 	{
-		takenKmers += mapPair->second;
-		if (takenKmers >= _genomeSize)
-		{
-			if (std::max(takenKmers, _genomeSize) - 
-				std::min(takenKmers, _genomeSize) < prevDiff)
-			{
-				cutoff = mapPair->first;
-			}
-			else
-			{
-				cutoff = mapPair->first + 1;
-				takenKmers -= mapPair->second;
-			}
-			break;
-		}
-		prevDiff = std::max(takenKmers, _genomeSize) - 
-				   std::min(takenKmers, _genomeSize);
+		estimate = HLL_REGISTERS * std::log((double)HLL_REGISTERS / zeroRegisters);
 	}
+	return estimate;
+}
+
 
-	size_t filteredKmers = 0;
-	for (auto itKmer : _vertexIndex.getKmerHist())
+void ParametersEstimator::sketchKmers()
+{
+	std::vector<FastaRecord::Id> allReads;
+	for (const auto& seq : _seqContainer.iterSeqs())
 	{
-		if (itKmer.first >= cutoff) break;
-		filteredKmers += itKmer.second;
+		if (seq.id.strand()) allReads.push_back(seq.id);
 	}
 
-	if (cutoff < 2)
+	std::function<void(const FastaRecord::Id&)> readUpdate =
+	[this] (const FastaRecord::Id& readId)
 	{
-		if ((bool)Config::get("low_cutoff_warning"))
+		for (auto kmerPos : IterKmers(_seqContainer.getSeq(readId)))
 		{
-			Logger::get().warning() << "Unable to separate erroneous k-mers "
-						  "from solid k-mers. Possible reasons: \n"
-						  "\t(1) Incorrect expected assembly size parameter \n"
-						  "\t(2) Highly uneven coverage of the assembly \n"
-						  "\t(3) Running with error-corrected reads in raw reads mode\n"
-						  "\tAssembly will continue, but results might not be optimal";
+			kmerPos.kmer.standardForm();
+			this->addToSketch(kmerPos.kmer);
 		}
-		cutoff = MIN_CUTOFF;
+	};
+	processInParallel(allReads, readUpdate,
+					  Parameters::get().numThreads, false);
+
+	_distinctKmers = this->hllEstimate();
+	_kmerDistribution.clear();
+	for (const auto& kmer : _sampledCounts.lock_table())
+	{
+		_kmerDistribution[kmer.second] += SAMPLE_RATE;
 	}
-	
-	Logger::get().debug() << "Estimated minimum kmer coverage: " << cutoff;
-	//Logger::get().debug() << takenKmers << " unique kmers selected";
-	Logger::get().debug() << "Filtered " << filteredKmers << " erroneous k-mers";
+	_sampledCounts.clear();
+	_sampledCounts.reserve(0);
+
+	Logger::get().debug() << "Estimated distinct k-mers: " << _distinctKmers;
+	Logger::get().debug() << "Estimated solid k-mers: " << this->solidKmers(2);
+}
+
+
+size_t ParametersEstimator::solidKmers(size_t minFreq) const
+{
+	size_t solid = 0;
+	for (auto itKmer = _kmerDistribution.lower_bound(minFreq);
+		 itKmer != _kmerDistribution.end(); ++itKmer)
+	{
+		solid += itKmer->second;
+	}
+	return solid;
+}
+
+
+bool ParametersEstimator::preferFlatCounter() const
+{
+	//flat counter uses 4 bits for each possible k-mer (8Gb for k=17)
+	//and is faster to update, so it is used whenever it fits into the
+	//available memory. Otherwise, the hash table (roughly 32 bytes per
+	//k-mer) is used, if it is smaller
+	const size_t MAX_FLAT_KMER = 17;
+	const size_t HASH_ENTRY_SIZE = 32;
+	if ((size_t)Parameters::get().kmerSize > MAX_FLAT_KMER) return false;
 
-	_takenKmers = takenKmers;
-	_minKmerCount = cutoff;
+	size_t flatSize = std::pow(4, Parameters::get().kmerSize) / 2;
+	if (flatSize <= getFreeMemorySize()) return true;
+	return _distinctKmers * HASH_ENTRY_SIZE >= flatSize;
 }
@@ -2,29 +2,61 @@
 //This file is a part of ABruijn program.
 //Released under the BSD license (see LICENSE file)
 
+//Estimates the k-mer statistics of a read set in a separate
+//pass over all reads, before the exact k-mer counting. The number of
+//distinct k-mers is estimated with HyperLogLog, and the k-mer frequency
+//histogram is computed exactly for a hash-sampled subset of k-mers and
+//then scaled. The estimates are used to choose the k-mer counter
+//and to pre-size the counter and index tables.
+
+#pragma once
+
+#include <atomic>
+#include <map>
+
+#include <cuckoohash_map.hh>
+
 #include "../sequence/vertex_index.h"
 #include "../sequence/sequence_container.h"
-#include <limits>
 
 class ParametersEstimator
 {
 public:
-	ParametersEstimator(const SequenceContainer& seqContainer,
-						const VertexIndex& vertexIndex, size_t genomeSize):
-		_vertexIndex(vertexIndex), 
+	ParametersEstimator(const SequenceContainer& seqContainer):
 		_seqContainer(seqContainer),
-		_genomeSize(genomeSize),
-		_minKmerCount(std::numeric_limits<size_t>::max())
-	{}
+		_distinctKmers(0),
+		_hllRegisters(new std::atomic<uint8_t>[HLL_REGISTERS])
+	{
+		for (size_t i = 0; i < HLL_REGISTERS; ++i) _hllRegisters[i] = 0;
+	}
+
+	~ParametersEstimator()
+	{
+		delete[] _hllRegisters;
+	}
+
+	ParametersEstimator(const ParametersEstimator&) = delete;
+	void operator=(const ParametersEstimator&) = delete;
+
+	void    sketchKmers();
+	size_t  distinctKmers() const {return _distinctKmers;}
+	size_t  solidKmers(size_t minFreq) const;
+	bool    preferFlatCounter() const;
 
-	void    estimateMinKmerCount();
-	size_t  genomeSizeEstimate();
-	size_t 	minKmerCount() {return _minKmerCount;}
 private:
+	void addToSketch(Kmer kmer);
+	size_t hllEstimate() const;
 
-	const VertexIndex& _vertexIndex;
 	const SequenceContainer& _seqContainer;
-	const size_t _genomeSize;
-	size_t _takenKmers;
-	size_t _minKmerCount;
+	size_t _distinctKmers;
+
+	//2^14 registers give ~1% standard error
+	static const size_t HLL_BITS = 14;
+	static const size_t HLL_REGISTERS = 1 << HLL_BITS;
+	std::atomic<uint8_t>* _hllRegisters;
+
+	//one of SAMPLE_RATE k-mers is counted exactly
+	static const size_t SAMPLE_RATE = 64;
+	cuckoohash_map<Kmer, size_t> _sampledCounts;
+	KmerDistribution _kmerDistribution;
 };
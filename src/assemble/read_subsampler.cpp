@@ -0,0 +1,180 @@
+//(c) 2020 by Authors
+//This file is a part of Flye program.
+//Released under the BSD license (see LICENSE file)
+
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+
+#include "read_subsampler.h"
+#include "../common/config.h"
+#include "../common/logger.h"
+#include "../common/parallel.h"
+
+
+std::vector<Kmer> ReadSubsampler::sketchRead(FastaRecord::Id readId) const
+{
+	std::vector<Kmer> sketch;
+	for (auto kmerPos : yieldMinimizers(_seqContainer.getSeq(readId),
+										_minimizerWindow))
+	{
+		kmerPos.kmer.standardForm();
+		if (kmerPos.kmer.hash() % SKETCH_DENSITY == 0)
+		{
+			sketch.push_back(kmerPos.kmer);
+		}
+	}
+	return sketch;
+}
+
+
+void ReadSubsampler::countSketch(const std::vector<FastaRecord::Id>& reads)
+{
+	_readSketches.assign(reads.size(), std::vector<Kmer>());
+	std::vector<size_t> readIdx(reads.size());
+	for (size_t i = 0; i < readIdx.size(); ++i) readIdx[i] = i;
+	std::function<void(const size_t&)> countFunc =
+	[this, &reads] (const size_t& idx)
+	{
+		_readSketches[idx] = this->sketchRead(reads[idx]);
+		for (auto kmer : _readSketches[idx])
+		{
+			_totalCounts.upsert(kmer, [](uint32_t& count){++count;}, 1);
+		}
+	};
+	processInParallel(readIdx, countFunc,
+					  Parameters::get().numThreads, false);
+
+	//coverage is estimated as the median count of solid
+	//sketch k-mers, weighted by their occurrences in reads
+	std::map<uint32_t, size_t> countHist;
+	size_t totalOccurrences = 0;
+	for (const auto& kmerRec : _totalCounts.lock_table())
+	{
+		if (kmerRec.second < 2) continue;
+		countHist[kmerRec.second] += kmerRec.second;
+		totalOccurrences += kmerRec.second;
+	}
+	size_t cumulative = 0;
+	for (auto& histRec : countHist)
+	{
+		cumulative += histRec.second;
+		if (cumulative * 2 >= totalOccurrences)
+		{
+			_coverageEstimate = histRec.first;
+			break;
+		}
+	}
+	Logger::get().debug() << "Coverage sketch size: " << _totalCounts.size()
+		<< ", estimated coverage: " << _coverageEstimate;
+}
+
+
+std::vector<FastaRecord::Id> ReadSubsampler::selectReads(int targetCoverage)
+{
+	std::vector<FastaRecord::Id> allReads;
+	for (const auto& seq : _seqContainer.iterSeqs())
+	{
+		if (seq.id.strand()) allReads.push_back(seq.id);
+	}
+
+	Logger::get().info() << "Estimating read coverage";
+	this->countSketch(allReads);
+	if (_coverageEstimate <= targetCoverage)
+	{
+		Logger::get().info() << "Estimated coverage " << _coverageEstimate
+			<< "x does not exceed " << targetCoverage << "x, using all reads";
+		_totalCounts.clear();
+		_readSketches.clear();
+		return allReads;
+	}
+	Logger::get().info() << "Downsampling reads from " << _coverageEstimate
+		<< "x to " << targetCoverage << "x";
+
+	//reads are prioritized by length, weighted by the fraction
+	//of solid sketch k-mers (to penalize reads with high error rate).
+	//Only solid k-mers are kept in the sketches for the selection below
+	std::vector<float> readScores(allReads.size(), 0);
+	std::vector<size_t> readIdx(allReads.size());
+	for (size_t i = 0; i < readIdx.size(); ++i) readIdx[i] = i;
+	std::function<void(const size_t&)> scoreFunc =
+	[this, &allReads, &readScores] (const size_t& idx)
+	{
+		auto& sketch = _readSketches[idx];
+		if (sketch.empty()) return;
+
+		size_t sketchSize = sketch.size();
+		sketch.erase(std::remove_if(sketch.begin(), sketch.end(),
+									[this](const Kmer& kmer)
+									{return _totalCounts.find(kmer) < 2;}),
+					 sketch.end());
+		readScores[idx] = (float)_seqContainer.seqLen(allReads[idx]) *
+						  sketch.size() / sketchSize;
+	};
+	processInParallel(readIdx, scoreFunc,
+					  Parameters::get().numThreads, false);
+	std::stable_sort(readIdx.begin(), readIdx.end(),
+					 [&readScores](size_t a, size_t b)
+					 {return readScores[a] > readScores[b];});
+
+	//greedy selection in the priority order: a read is taken if the
+	//majority of its sketch k-mers have not yet reached the target coverage.
+	//For repetitive k-mers the target is scaled by their multiplicity,
+	//and regions with coverage below the target keep all reads.
+	//Reads without solid sketch k-mers (e.g. from the regions with coverage
+	//too low to get repeated k-mers) can't be judged, so they are kept.
+	//They have the zero score, so they come last and don't affect the others.
+	//Each decision depends on the previous ones, so this pass is sequential
+	//(which also makes the selection independent of the number of threads)
+	const float covRatio = (float)targetCoverage / _coverageEstimate;
+	std::unordered_map<Kmer, uint32_t> selectedCounts;
+	std::vector<char> selected(allReads.size(), false);
+	size_t noSolidReads = 0;
+	for (size_t idx : readIdx)
+	{
+		const auto& solidKmers = _readSketches[idx];
+		if (solidKmers.empty())
+		{
+			selected[idx] = true;
+			++noSolidReads;
+			continue;
+		}
+
+		size_t needCoverage = 0;
+		for (auto kmer : solidKmers)
+		{
+			uint32_t totalCount = _totalCounts.find(kmer);
+			float required = std::max((float)std::min(totalCount,
+													   (uint32_t)targetCoverage),
+									  totalCount * covRatio);
+			auto selIt = selectedCounts.find(kmer);
+			uint32_t selectedCount = selIt != selectedCounts.end() ? 
+									 selIt->second : 0;
+			if (selectedCount < required) ++needCoverage;
+		}
+		if (needCoverage * 2 <= solidKmers.size()) continue;
+
+		selected[idx] = true;
+		for (auto kmer : solidKmers) ++selectedCounts[kmer];
+	}
+
+	std::vector<FastaRecord::Id> selectedReads;
+	size_t totalLength = 0;
+	size_t selectedLength = 0;
+	for (size_t i = 0; i < allReads.size(); ++i)
+	{
+		totalLength += _seqContainer.seqLen(allReads[i]);
+		if (!selected[i]) continue;
+		selectedReads.push_back(allReads[i]);
+		selectedLength += _seqContainer.seqLen(allReads[i]);
+	}
+	Logger::get().debug() << "Kept " << noSolidReads 
+		<< " reads without solid sketch k-mers";
+	Logger::get().info() << "Selected " << selectedReads.size() << " / "
+		<< allReads.size() << " reads (" << selectedLength << " / "
+		<< totalLength << " bp)";
+
+	_totalCounts.clear();
+	_readSketches.clear();
+	return selectedReads;
+}
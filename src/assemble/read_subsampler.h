@@ -0,0 +1,48 @@
+//(c) 2020 by Authors
+//This file is a part of Flye program.
+//Released under the BSD license (see LICENSE file)
+
+//Selects a subset of reads with a reduced coverage before
+//the k-mer index is built. Coverage is estimated locally using
+//a sparse minimizer sketch, so regions with low coverage
+//keep all their reads, while redundant reads from the
+//high-coverage regions are dropped.
+
+#pragma once
+
+#include <vector>
+
+#include <cuckoohash_map.hh>
+
+#include "../sequence/sequence_container.h"
+#include "../sequence/kmer.h"
+
+class ReadSubsampler
+{
+public:
+	ReadSubsampler(const SequenceContainer& seqContainer, int minimizerWindow):
+		_seqContainer(seqContainer),
+		_minimizerWindow(minimizerWindow),
+		_coverageEstimate(0)
+	{}
+
+	//returns positive strand ids of the selected reads
+	std::vector<FastaRecord::Id> selectReads(int targetCoverage);
+
+	int coverageEstimate() const {return _coverageEstimate;}
+
+private:
+	std::vector<Kmer> sketchRead(FastaRecord::Id readId) const;
+	void countSketch(const std::vector<FastaRecord::Id>& reads);
+
+	const SequenceContainer& _seqContainer;
+	const int _minimizerWindow;
+	int _coverageEstimate;
+
+	//only a fraction of minimizers goes to the sketch
+	const size_t SKETCH_DENSITY = 16;
+
+	cuckoohash_map<Kmer, uint32_t> _totalCounts;
+	//sketches of the reads, in the same order as the input reads
+	std::vector<std::vector<Kmer>> _readSketches;
+};
@@ -0,0 +1,59 @@
+//(c) 2020 by Authors
+//This file is a part of Flye program.
+//Released under the BSD license (see LICENSE file)
+
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+//Multi-producer, multi-consumer queue of a limited capacity.
+//Producers are blocked while the queue is full, consumers
+//are blocked while the queue is empty and not closed
+template <class T>
+class BoundedQueue
+{
+public:
+	explicit BoundedQueue(size_t capacity):
+		_capacity(capacity), _closed(false) {}
+
+	void push(T&& item)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_notFull.wait(lock, [this]{return _items.size() < _capacity;});
+		_items.push_back(std::move(item));
+		lock.unlock();
+		_notEmpty.notify_one();
+	}
+
+	//returns false if the queue is closed and there are no more items
+	bool pop(T& item)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_notEmpty.wait(lock, [this]{return !_items.empty() || _closed;});
+		if (_items.empty()) return false;
+
+		item = std::move(_items.front());
+		_items.pop_front();
+		lock.unlock();
+		_notFull.notify_one();
+		return true;
+	}
+
+	//no more items will be pushed
+	void close()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_closed = true;
+		_notEmpty.notify_all();
+	}
+
+private:
+	const size_t 			_capacity;
+	bool 					_closed;
+	std::deque<T> 			_items;
+	std::mutex 				_mutex;
+	std::condition_variable _notFull;
+	std::condition_variable _notEmpty;
+};
@@ -2,77 +2,210 @@
 //This file is a part of Ragout program.
 //Released under the BSD license (see LICENSE file)
 
+//Index-based disjoint sets over elements [0, size). Elements
+//are stored in flat arrays, so there is no per-element allocation,
+//and find is iterative (path halving), without recursion.
+
+#pragma once
+
 #include <vector>
-#include <unordered_map>
+#include <atomic>
+#include <algorithm>
+#include <limits>
 
-template <class T>
-struct SetNode
+//Sequential disjoint set with union by size
+class DisjointSet
 {
-	SetNode(const T& data): parent(this), rank(0), data(data) {}
+public:
+	explicit DisjointSet(size_t size = 0):
+		_parents(size), _sizes(size, 1)
+	{
+		for (size_t i = 0; i < size; ++i) _parents[i] = i;
+	}
 
-	SetNode* parent;
-	int rank;
-	T data;
-};
+	size_t size() const {return _parents.size();}
 
-template <class T>
-SetNode<T>* findSet(SetNode<T>* elem)
-{
-	if (elem->parent != elem)
+	//adds a new singleton set, returns its element
+	size_t addElement()
 	{
-		elem->parent = findSet(elem->parent);
-		return elem->parent;
+		_parents.push_back(_parents.size());
+		_sizes.push_back(1);
+		return _parents.size() - 1;
 	}
-	else
+
+	size_t findSet(size_t elem)
 	{
+		while (_parents[elem] != elem)
+		{
+			_parents[elem] = _parents[_parents[elem]];
+			elem = _parents[elem];
+		}
 		return elem;
 	}
-}
 
-template <class T>
-void unionSet(SetNode<T>* node1, SetNode<T>* node2)
+	bool unionSet(size_t elem1, size_t elem2)
+	{
+		size_t root1 = this->findSet(elem1);
+		size_t root2 = this->findSet(elem2);
+		if (root1 == root2) return false;
+
+		if (_sizes[root1] < _sizes[root2]) std::swap(root1, root2);
+		_parents[root2] = root1;
+		_sizes[root1] += _sizes[root2];
+		return true;
+	}
+
+	bool sameSet(size_t elem1, size_t elem2)
+	{
+		return this->findSet(elem1) == this->findSet(elem2);
+	}
+
+	size_t setSize(size_t elem)
+	{
+		return _sizes[this->findSet(elem)];
+	}
+
+private:
+	std::vector<size_t> _parents;
+	std::vector<size_t> _sizes;
+};
+
+//Disjoint set, which supports concurrent findSet / unionSet
+//calls from multiple threads (lock-free, CAS-based).
+//A larger root is always linked under the smaller one, so
+//the representative of a set is its minimum element and does
+//not depend on the order of unions
+class ConcurrentDisjointSet
 {
-	SetNode<T>* root1 = findSet(node1);
-	SetNode<T>* root2 = findSet(node2);
-	if (root1 == root2) return;
+public:
+	explicit ConcurrentDisjointSet(size_t size):
+		_parents(size)
+	{
+		for (size_t i = 0; i < size; ++i) _parents[i] = i;
+	}
+
+	ConcurrentDisjointSet(const ConcurrentDisjointSet&) = delete;
+	void operator=(const ConcurrentDisjointSet&) = delete;
 
-	if (root1->rank > root2->rank)
+	size_t size() const {return _parents.size();}
+
+	size_t findSet(size_t elem)
 	{
-		root2->parent = root1;
+		while (true)
+		{
+			size_t parent = _parents[elem].load(std::memory_order_relaxed);
+			if (parent == elem) return elem;
+
+			//path halving: point to the grandparent
+			size_t grandParent = _parents[parent].load(std::memory_order_relaxed);
+			if (parent != grandParent)
+			{
+				_parents[elem].compare_exchange_weak(parent, grandParent,
+													 std::memory_order_relaxed);
+			}
+			elem = grandParent;
+		}
 	}
-	else
+
+	bool unionSet(size_t elem1, size_t elem2)
 	{
-		root1->parent = root2;
-		if (root1->rank == root2->rank)
+		while (true)
 		{
-			++root2->rank;
+			size_t root1 = this->findSet(elem1);
+			size_t root2 = this->findSet(elem2);
+			if (root1 == root2) return false;
+			if (root1 > root2) std::swap(root1, root2);
+
+			//might fail if root2 was linked by another thread
+			size_t expected = root2;
+			if (_parents[root2].compare_exchange_strong(expected, root1,
+														std::memory_order_relaxed))
+			{
+				return true;
+			}
 		}
 	}
-}
 
-template <typename T>
-std::unordered_map<SetNode<T>*, std::vector<T>> 
-	groupBySet(const std::vector<SetNode<T>*>& sets)
-{
-	std::unordered_map<SetNode<T>*, std::vector<T>> groups;
-	for (auto& setNode : sets)
+	bool sameSet(size_t elem1, size_t elem2)
 	{
-		groups[findSet(setNode)].push_back(setNode->data);
+		return this->findSet(elem1) == this->findSet(elem2);
 	}
-	return groups;
-}
 
-//Vector that stores the set nodes and automatically deletes
-//them in the end. Does not have virtual table - do not use polymorphism!
-//All set elements should be pushed before any set operations are
-//applied (like union) - do not modify the vector afterwards
-template <typename T>
-class SetVec : public std::vector<SetNode<T>*>
+private:
+	std::vector<std::atomic<size_t>> _parents;
+};
+
+//Partition of elements into sets in the compressed (CSR) form.
+//Groups are ordered by their minimum element, elements
+//within a group are in the increasing order
+class SetGroups
 {
 public:
-	~SetVec()
+	class Group
 	{
-		for (auto& x : *this) delete x;
+	public:
+		Group(const size_t* first, const size_t* last):
+			_first(first), _last(last) {}
+
+		const size_t* begin() const {return _first;}
+		const size_t* end() const {return _last;}
+		size_t size() const {return _last - _first;}
+		size_t front() const {return *_first;}
+		size_t operator[](size_t i) const {return _first[i];}
+
+	private:
+		const size_t* _first;
+		const size_t* _last;
+	};
+
+	size_t size() const {return _offsets.size() - 1;}
+	Group operator[](size_t group) const
+	{
+		return Group(_elements.data() + _offsets[group],
+					 _elements.data() + _offsets[group + 1]);
 	}
+
+	template <class DisjointSetType>
+	friend SetGroups groupBySet(DisjointSetType& sets);
+
+private:
+	SetGroups(): _offsets(1, 0) {}
+
+	std::vector<size_t> _offsets;
+	std::vector<size_t> _elements;
 };
 
+//groups all elements by their sets in linear time
+template <class DisjointSetType>
+SetGroups groupBySet(DisjointSetType& sets)
+{
+	const size_t NO_GROUP = std::numeric_limits<size_t>::max();
+
+	SetGroups groups;
+	std::vector<size_t> elemGroups(sets.size());
+	std::vector<size_t> rootGroups(sets.size(), NO_GROUP);
+	for (size_t i = 0; i < sets.size(); ++i)
+	{
+		size_t root = sets.findSet(i);
+		if (rootGroups[root] == NO_GROUP)
+		{
+			rootGroups[root] = groups._offsets.size() - 1;
+			groups._offsets.push_back(0);
+		}
+		elemGroups[i] = rootGroups[root];
+		++groups._offsets[elemGroups[i] + 1];
+	}
+	for (size_t i = 1; i < groups._offsets.size(); ++i)
+	{
+		groups._offsets[i] += groups._offsets[i - 1];
+	}
+
+	groups._elements.resize(sets.size());
+	std::vector<size_t> fillPos(groups._offsets.begin(),
+								groups._offsets.end() - 1);
+	for (size_t i = 0; i < sets.size(); ++i)
+	{
+		groups._elements[fillPos[elemGroups[i]]++] = i;
+	}
+	return groups;
+}
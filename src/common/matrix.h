@@ -6,12 +6,13 @@
 #include <stdexcept>
 #include <cassert>
 #include <vector>
+#include <algorithm>
 
 template <class T>
 class Matrix
 {
 public:
-	Matrix(): _rows(0), _cols(0), _data(nullptr) {}
+	Matrix(): _rows(0), _cols(0), _capacity(0), _data(nullptr) {}
 	Matrix(const Matrix& other):
 		Matrix(other._rows, other._cols)
 	{
@@ -24,12 +25,14 @@ public:
 	{
 		std::swap(_cols, other._cols);
 		std::swap(_rows, other._rows);
+		std::swap(_capacity, other._capacity);
 		std::swap(_data, other._data);
 	}
 	Matrix& operator=(Matrix && other)
 	{
 		std::swap(_cols, other._cols);
 		std::swap(_rows, other._rows);
+		std::swap(_capacity, other._capacity);
 		std::swap(_data, other._data);
 		return *this;
 	}
@@ -38,12 +41,13 @@ public:
 		Matrix temp(other);
 		std::swap(_cols, temp._cols);
 		std::swap(_rows, temp._rows);
+		std::swap(_capacity, temp._capacity);
 		std::swap(_data, temp._data);
 		return *this;
 	}
 
 	Matrix(size_t rows, size_t cols, T val = 0):
-		_rows(rows), _cols(cols)
+		_rows(rows), _cols(cols), _capacity(rows)
 	{
 		if (!rows || !cols)
 			throw std::runtime_error("Zero matrix dimension");
@@ -60,8 +64,27 @@ public:
 	size_t nrows() const {return _rows;}
 	size_t ncols() const {return _cols;}
 
+	//changes the number of rows, keeping the values of the
+	//first min(rows, nrows()) rows. New rows are not initialized.
+	//Memory is reallocated only if the matrix grows beyond its capacity
+	void resizeRows(size_t rows)
+	{
+		if (!rows) throw std::runtime_error("Zero matrix dimension");
+		if (rows > _capacity)
+		{
+			size_t newCapacity = std::max(rows, _capacity + _capacity / 2);
+			T* newData = new T[newCapacity * _cols];
+			for (size_t i = 0; i < _rows * _cols; ++i) newData[i] = _data[i];
+			if (_data) delete[] _data;
+			_data = newData;
+			_capacity = newCapacity;
+		}
+		_rows = rows;
+	}
+
 private:
 	size_t _rows;
 	size_t _cols;
+	size_t _capacity;
 	T* _data;
 };
@@ -58,6 +58,22 @@ void ContigExtender::generateUnbranchingPaths()
 }
 
 
+std::unordered_set<FastaRecord::Id> ContigExtender::getExtensionReads() const
+{
+	//contigs are extended using sequences of the reads
+	//that are aligned to multiple edges (see generateContigs)
+	std::unordered_set<FastaRecord::Id> readIds;
+	for (auto& aln : _aligner.getAlignments())
+	{
+		if (aln.size() > 1)
+		{
+			readIds.insert(aln.front().overlap.curId);
+			readIds.insert(aln.front().overlap.curId.rc());
+		}
+	}
+	return readIds;
+}
+
 void ContigExtender::generateContigs()
 {
 	Logger::get().debug() << "Extending contigs into repeats";
@@ -72,15 +88,17 @@ void ContigExtender::generateContigs()
 		upathsSeqs[&_unbranchingPaths[i]] = &coreSeqs[i];
 	}
 
-	std::unordered_map<GraphEdge*, 
-					   std::vector<const GraphAlignment*>> alnIndex;
-	for (auto& aln : _aligner.getAlignments())
+	//alignments are indexed by their chain ids
+	const auto& readAlignments = _aligner.getAlignments();
+	std::unordered_map<GraphEdge*, std::vector<size_t>> alnIndex;
+	for (size_t chainId = 0; chainId < readAlignments.size(); ++chainId)
 	{
+		auto aln = readAlignments[chainId];
 		if (aln.size() > 1)
 		{
-			for (auto edge : aln)
+			for (size_t i = 0; i < aln.size(); ++i)
 			{
-				alnIndex[edge.edge].push_back(&aln);
+				alnIndex[aln.edgeAt(i)].push_back(chainId);
 			}
 		}
 	}
@@ -97,7 +115,7 @@ void ContigExtender::generateContigs()
 	typedef std::pair<GraphPath, std::string> PathAndSeq;
 	auto extendPathRight =
 		[this, &coveredRepeats, &repeatDirections, &upathsSeqs, 
-		 &canTraverse, &alnIndex, graphContinue] 
+		 &canTraverse, &alnIndex, &readAlignments, graphContinue] 
 	(UnbranchingPath& upath)
 	{
 
@@ -107,19 +125,19 @@ void ContigExtender::generateContigs()
 		//first, choose the longest aligned read from this edge
 		int32_t maxExtension = 0;
 		GraphAlignment bestAlignment;
-		for (auto pathPtr : alnIndex[upath.path.back()])
+		for (size_t chainId : alnIndex[upath.path.back()])
 		{
-			const GraphAlignment& path = *pathPtr;
+			auto path = readAlignments[chainId];
 			for (size_t i = 0; i < path.size(); ++i)
 			{
-				if (path[i].edge == upath.path.back() &&
+				if (path.edgeAt(i) == upath.path.back() &&
 					i < path.size() - 1)
 				{
 					size_t j = i + 1;
 					while (j < path.size() && 
-						   path[j].edge->repetitive &&
-						   !path[j].edge->altHaplotype &&
-						   canTraverse(path[j].edge)) ++j;
+						   path.edgeAt(j)->repetitive &&
+						   !path.edgeAt(j)->altHaplotype &&
+						   canTraverse(path.edgeAt(j))) ++j;
 					if (j == i + 1) break;
 
 					int32_t alnLen = path[j - 1].overlap.curEnd - 
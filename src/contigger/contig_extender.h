@@ -21,6 +21,8 @@ public:
 
 	void generateUnbranchingPaths();
 	void generateContigs();
+	//reads, which sequences might be used for contig extension
+	std::unordered_set<FastaRecord::Id> getExtensionReads() const;
 	void outputContigs(const std::string& filename);
 	void outputStatsTable(const std::string& filename);
 	void outputScaffoldConnections(const std::string& filename);
@@ -18,6 +18,7 @@
 #include "../repeat_graph/repeat_graph.h"
 #include "../repeat_graph/read_aligner.h"
 #include "../repeat_graph/output_generator.h"
+#include "../repeat_graph/dump_io.h"
 #include "../contigger/contig_extender.h"
 
 #include <getopt.h>
@@ -28,7 +29,7 @@ bool parseArgs(int argc, char** argv, std::string& readsFasta,
 			   int& minOverlap, bool& debug, size_t& numThreads, 
 			   std::string& configPath, std::string& inRepeatGraph,
 			   std::string& inReadsAlignment, bool& noScaffold,
-			   std::string& extraParams)
+			   std::string& extraParams, std::string& inReadsMeta)
 {
 	auto printUsage = []()
 	{
@@ -36,7 +37,7 @@ bool parseArgs(int argc, char** argv, std::string& readsFasta,
 				  << " --graph-edges path --reads path --out-dir path --config path\n"
 				  << "\t\t--repeat-graph path --graph-aln path\n"
 				  << "\t\t[--log path] [--treads num] [--kmer size] [--no-scaffold]\n"
-				  << "\t\t[--min-ovlp size] [--debug] [--extra-params] [-h]\n\n"
+				  << "\t\t[--min-ovlp size] [--debug] [--extra-params] [--read-meta path] [-h]\n\n"
 				  << "Required arguments:\n"
 				  << "  --graph-edges path\tpath to fasta with graph edges\n"
 				  << "  --repeat-graph path\tpath to serialized repeat graph\n"
@@ -56,6 +57,8 @@ bool parseArgs(int argc, char** argv, std::string& readsFasta,
 				  << "[default = not set] \n"
 				  << "  --extra-params additional config parameters "
 				  << "[default = not set] \n"
+				  << "  --read-meta path\tread metadata from the repeat stage, "
+				  << "reads are then loaded only if needed [default = not set] \n"
 				  << "  --threads num_threads\tnumber of parallel threads "
 				  << "[default = 1] \n";
 	};
@@ -74,6 +77,7 @@ bool parseArgs(int argc, char** argv, std::string& readsFasta,
 		{"kmer", required_argument, 0, 0},
 		{"min-ovlp", required_argument, 0, 0},
 		{"extra-params", required_argument, 0, 0},
+		{"read-meta", required_argument, 0, 0},
 		{"debug", no_argument, 0, 0},
 		{"no-scaffold", no_argument, 0, 0},
 		{0, 0, 0, 0}
@@ -111,6 +115,8 @@ bool parseArgs(int argc, char** argv, std::string& readsFasta,
 				configPath = optarg;
 			else if (!strcmp(longOptions[optionIndex].name, "extra-params"))
 				extraParams = optarg;
+			else if (!strcmp(longOptions[optionIndex].name, "read-meta"))
+				inReadsMeta = optarg;
 			break;
 
 		case 'h':
@@ -149,10 +155,12 @@ int contigger_main(int argc, char** argv)
 	std::string logFile;
 	std::string configPath;
 	std::string extraParams;
+	std::string inReadsMeta;
 	if (!parseArgs(argc, argv, readsFasta, outFolder, logFile, inGraphEdges,
 				   kmerSize, minOverlap, debugging, 
 				   numThreads, configPath, inRepeatGraph, 
-				   inReadsAlignment, noScaffold, extraParams))  return 1;
+				   inReadsAlignment, noScaffold, extraParams,
+				   inReadsMeta))  return 1;
 	
 	Logger::get().setDebugging(debugging);
 	if (!logFile.empty()) Logger::get().setOutputFile(logFile);
@@ -186,9 +194,18 @@ int contigger_main(int argc, char** argv)
 	try
 	{
 		seqGraphEdges.loadFromFile(inGraphEdges);
-		for (auto& readsFile : readsList)
+		if (!inReadsMeta.empty())
 		{
-			seqReads.loadFromFile(readsFile);
+			//only names and lengths, sequences are loaded later
+			loadReadMetadata(inReadsMeta, seqReads);
+		}
+		else
+		{
+			for (auto& readsFile : readsList)
+			{
+				seqReads.loadFromFile(readsFile);
+			}
+			seqReads.buildPositionIndex();
 		}
 	}
 	catch (SequenceContainer::ParseException& e)
@@ -196,7 +213,6 @@ int contigger_main(int argc, char** argv)
 		Logger::get().error() << e.what();
 		return 1;
 	}
-	seqReads.buildPositionIndex();
 	//seqAssembly.buildPositionIndex();
 
 	SequenceContainer emptyContainer;
@@ -207,9 +223,25 @@ int contigger_main(int argc, char** argv)
 	aln.loadAlignments(inReadsAlignment);
 	OutputGenerator outGen(rg, aln);
 
+	ContigExtender extender(rg, aln, emptyContainer, seqReads);
+	if (!inReadsMeta.empty())
+	{
+		auto extensionReads = extender.getExtensionReads();
+		Logger::get().debug() << "Loading " << extensionReads.size() / 2
+			<< " reads for contig extension";
+		try
+		{
+			seqReads.loadSequences(readsList, extensionReads);
+		}
+		catch (SequenceContainer::ParseException& e)
+		{
+			Logger::get().error() << e.what();
+			return 1;
+		}
+	}
+
 	//Logger::get().info() << "Generating contigs";
 
-	ContigExtender extender(rg, aln, emptyContainer, seqReads);
 	extender.generateUnbranchingPaths();
 	extender.generateContigs();
 	extender.outputContigs(outFolder + "/contigs.fasta");
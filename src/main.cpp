@@ -9,12 +9,13 @@ int assemble_main(int argc, char** argv);
 int repeat_main(int argc, char** argv);
 int contigger_main(int argc, char** argv);
 int polisher_main(int argc, char** argv);
+int dump_convert_main(int argc, char** argv);
 
 int main(int argc, char** argv)
 {
 	if (argc < 2)
 	{
-		std::cerr << "Usage: flye-modules [assemble | repeat | contigger | polisher] ..." 
+		std::cerr << "Usage: flye-modules [assemble | repeat | contigger | polisher | dump-convert] ..." 
 				  << std::endl;
 		return 1;
 	}
@@ -35,9 +36,13 @@ int main(int argc, char** argv)
 	{
 		return polisher_main(argc - 1, argv + 1);
 	}
+	else if (module == "dump-convert")
+	{
+		return dump_convert_main(argc - 1, argv + 1);
+	}
 	else
 	{
-		std::cerr << "Usage: flye-modules [assemble | repeat | contigger | polisher] ..." 
+		std::cerr << "Usage: flye-modules [assemble | repeat | contigger | polisher | dump-convert] ..." 
 				  << std::endl;
 		return 1;
 	}
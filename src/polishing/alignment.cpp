@@ -3,188 +3,684 @@
 //Released under the BSD license (see LICENSE file)
 
 #include "alignment.h"
-#include <chrono>
 
+namespace
+{
+	const char NUCLEOTIDES[] = {'A', 'C', 'G', 'T'};
 
-Alignment::Alignment(size_t size, const SubstitutionMatrix& sm):
-	_forwardScores(size),
-	_reverseScores(size),
+	int nucleotideIndex(char c)
+	{
+		switch (c)
+		{
+			case 'A': return 0;
+			case 'C': return 1;
+			case 'G': return 2;
+			case 'T': return 3;
+			default: return -1;
+		}
+	}
+}
+
+template <class ScoreT>
+const ScoreT Alignment::BandedAlignment<ScoreT>::NEG_INF;
+template <class ScoreT>
+const ScoreT Alignment::BandedAlignment<ScoreT>::SAFE_MIN;
+
+
+Alignment::Alignment(size_t size, const SubstitutionMatrix& sm,
+					 size_t bandWidth):
+	_narrowAlignments(size),
+	_wideAlignments(size),
+	_wideScores(false),
+	_aligned(false),
+	_bandWidth(bandWidth),
 	_subsMatrix(sm)
-{ 
+{
 }
 
 
 AlnScoreType Alignment::globalAlignment(const std::string& consensus,
 							 			const std::vector<std::string>& reads)
 {
+	//rows of the forward matrices that correspond to the common prefix
+	//of the new and the previous consensus are still valid, as well as
+	//the reverse matrix rows that correspond to the common suffix
+	size_t validPrefix = 0;
+	size_t validSuffix = 0;
+	if (_aligned)
+	{
+		size_t maxCommon = std::min(consensus.size(), _consensus.size());
+		while (validPrefix < maxCommon &&
+			   consensus[validPrefix] == _consensus[validPrefix]) ++validPrefix;
+		while (validSuffix < maxCommon &&
+			   consensus[consensus.size() - validSuffix - 1] ==
+			   _consensus[_consensus.size() - validSuffix - 1]) ++validSuffix;
+	}
+
 	AlnScoreType finalScore = 0;
-	for (size_t readId = 0; readId < _forwardScores.size(); ++readId)
+	if (!_wideScores)
 	{
-		unsigned int x = consensus.size() + 1;
-		unsigned int y = reads[readId].size() + 1;
-		ScoreMatrix scoreMat(x, y, 0);
-			
-		AlnScoreType score = this->getScoringMatrix(consensus, reads[readId], 
-													  scoreMat);
-		_forwardScores[readId] = std::move(scoreMat);
+		finalScore = this->alignAll(_narrowAlignments, consensus, reads,
+									validPrefix, validSuffix);
+		for (auto& aln : _narrowAlignments)
+		{
+			if (aln.overflow()) _wideScores = true;
+		}
+		//scores might overflow, realign everything with 64-bit scores
+		if (_wideScores)
+		{
+			_narrowAlignments.clear();
+			_narrowAlignments.shrink_to_fit();
+		}
+	}
+	if (_wideScores)
+	{
+		finalScore = this->alignAll(_wideAlignments, consensus, reads,
+									validPrefix, validSuffix);
+	}
 
-		//The reverse alignment is similar, but we need
-		//the scoring matrix with of the reverse alignment (I guess)
-		std::string revConsensus(consensus.rbegin(), consensus.rend());
-		std::string revRead(reads[readId].rbegin(), reads[readId].rend());
+	_consensus = consensus;
+	_aligned = true;
+	return finalScore;
+}
 
-		ScoreMatrix scoreMatRev(x, y, 0);
-		this->getScoringMatrix(revConsensus, revRead, scoreMatRev);
-		_reverseScores[readId] = std::move(scoreMatRev);
+template <class ScoreT>
+AlnScoreType Alignment::alignAll(std::vector<BandedAlignment<ScoreT>>& alignments,
+								 const std::string& consensus,
+								 const std::vector<std::string>& reads,
+								 size_t validPrefix, size_t validSuffix)
+{
+	AlnScoreType finalScore = 0;
+	for (size_t readId = 0; readId < alignments.size(); ++readId)
+	{
+		auto& aln = alignments[readId];
+		size_t forwardFrom = validPrefix + 1;
+		size_t reverseFrom = validSuffix + 1;
+		if (!_aligned || aln.needsReset(consensus.size()))
+		{
+			aln.reset(reads[readId], consensus.size(), _subsMatrix,
+					  std::max(_bandWidth, aln.bandWidth()));
+			forwardFrom = 0;
+			reverseFrom = 0;
+		}
+		AlnScoreType score = aln.update(consensus, forwardFrom, reverseFrom,
+										_subsMatrix);
 
+		//the best alignment might not fit into the band,
+		//repeat with the doubled band until it does
+		while (!aln.overflow() && aln.touchesBandEdge(score))
+		{
+			aln.reset(reads[readId], consensus.size(), _subsMatrix,
+					  2 * aln.bandWidth());
+			score = aln.update(consensus, 0, 0, _subsMatrix);
+		}
 		finalScore += score;
 	}
 	return finalScore;
 }
 
-AlnScoreType Alignment::addDeletion(unsigned int letterIndex) const
+void Alignment::scoreEdits(size_t position, EditScores& scores) const
 {
-	AlnScoreType finalScore = 0;
-	for (size_t readId = 0; readId < _forwardScores.size(); ++readId)
+	scores.deletion = 0;
+	for (size_t i = 0; i < 4; ++i)
+	{
+		scores.insertions[i] = 0;
+		scores.substitutions[i] = 0;
+	}
+
+	if (!_wideScores)
+	{
+		this->scoreEditsAll(_narrowAlignments, position, scores);
+	}
+	else
 	{
-		const ScoreMatrix& forwardScore = _forwardScores[readId];
-		const ScoreMatrix& reverseScore = _reverseScores[readId];
+		this->scoreEditsAll(_wideAlignments, position, scores);
+	}
 
-		//Note: We subtract 2 because of zero indexing and an extra added row and column count
-		//unsigned int index = (reverseScore.nrows() - 1) - letterIndex;
-		size_t frontRow = letterIndex - 1;
-		size_t revRow = reverseScore.nrows() - 1 - letterIndex;
-		
-		AlnScoreType maxVal = std::numeric_limits<AlnScoreType>::lowest();
-		for (size_t col = 0; col < forwardScore.ncols(); ++col)
+	if (position == _consensus.size())
+	{
+		scores.deletion = std::numeric_limits<AlnScoreType>::lowest();
+		for (size_t i = 0; i < 4; ++i)
 		{
-			size_t backCol = forwardScore.ncols() - col - 1;
-			AlnScoreType sum = forwardScore.at(frontRow, col) + 
-							reverseScore.at(revRow, backCol);
-			maxVal = std::max(maxVal, sum);
+			scores.substitutions[i] = std::numeric_limits<AlnScoreType>::lowest();
 		}
-		finalScore += maxVal;
 	}
-	return finalScore;
 }
 
+template <class ScoreT>
+void Alignment::scoreEditsAll(const std::vector<BandedAlignment<ScoreT>>& alignments,
+							  size_t position, EditScores& scores) const
+{
+	for (auto& aln : alignments)
+	{
+		aln.addEditScores(position, _subsMatrix, scores);
+	}
+}
 
-//AlnScoreType Alignment::addSubstitution(unsigned int wordIndex, 
-//							   			unsigned int letterIndex,
-//							   			char base, const std::string& read) 
-
-AlnScoreType Alignment::addSubstitution(unsigned int letterIndex, char base, 
-										const std::vector<std::string>& reads) const
+AlnScoreType Alignment::addDeletion(unsigned int letterIndex) const
 {
 	AlnScoreType finalScore = 0;
-	for (size_t readId = 0; readId < reads.size(); ++readId)
+	if (!_wideScores)
+	{
+		for (auto& aln : _narrowAlignments)
+		{
+			finalScore += aln.deletionScore(letterIndex);
+		}
+	}
+	else
 	{
-		//LetterIndex must start with 1 and go until (row.size - 1)
-		const ScoreMatrix& forwardScore = _forwardScores[readId];
-		const ScoreMatrix& reverseScore = _reverseScores[readId];
+		for (auto& aln : _wideAlignments)
+		{
+			finalScore += aln.deletionScore(letterIndex);
+		}
+	}
+	return finalScore;
+}
 
-		size_t frontRow = letterIndex - 1;
-		size_t revRow = reverseScore.nrows() - 1 - letterIndex;
+AlnScoreType Alignment::addSubstitution(unsigned int letterIndex, char base,
+										const std::vector<std::string>&) const
+{
+	//LetterIndex must start with 1 and go until (row.size - 1)
+	size_t frontRow = letterIndex - 1;
+	size_t revRow = _consensus.size() - letterIndex;
 
-		std::vector<AlnScoreType> sub(reads[readId].size() + 1);
-		sub[0] = forwardScore.at(frontRow, 0) + _subsMatrix.getScore(base, '-');
-		for (size_t i = 0; i < reads[readId].size(); ++i)
+	AlnScoreType finalScore = 0;
+	if (!_wideScores)
+	{
+		for (auto& aln : _narrowAlignments)
+		{
+			finalScore += aln.insertionScore(frontRow, revRow, base,
+											 _subsMatrix);
+		}
+	}
+	else
+	{
+		for (auto& aln : _wideAlignments)
 		{
-			AlnScoreType match = forwardScore.at(frontRow, i) + 
-							_subsMatrix.getScore(base, reads[readId][i]);
-			AlnScoreType ins = forwardScore.at(frontRow, i + 1) + 
-							_subsMatrix.getScore(base, '-');
-			sub[i + 1] = std::max(match, ins);
+			finalScore += aln.insertionScore(frontRow, revRow, base,
+											 _subsMatrix);
 		}
+	}
+	return finalScore;
+}
+
+
+AlnScoreType Alignment::addInsertion(unsigned int pos, char base,
+									 const std::vector<std::string>&) const
+{
+	size_t frontRow = pos - 1;
+	size_t revRow = _consensus.size() + 1 - pos;
 
-		AlnScoreType maxVal = std::numeric_limits<AlnScoreType>::lowest();
-		for (size_t col = 0; col < forwardScore.ncols(); ++col)
+	AlnScoreType finalScore = 0;
+	if (!_wideScores)
+	{
+		for (auto& aln : _narrowAlignments)
 		{
-			size_t backCol = forwardScore.ncols() - col - 1;
-			AlnScoreType sum = sub[col] + reverseScore.at(revRow, backCol);
-			maxVal = std::max(maxVal, sum);
+			finalScore += aln.insertionScore(frontRow, revRow, base,
+											 _subsMatrix);
+		}
+	}
+	else
+	{
+		for (auto& aln : _wideAlignments)
+		{
+			finalScore += aln.insertionScore(frontRow, revRow, base,
+											 _subsMatrix);
 		}
-		finalScore += maxVal;
 	}
 	return finalScore;
 }
 
+AlnScoreType Alignment::replacementScore(size_t start, size_t end,
+										 const std::string& segment) const
+{
+	if (!_wideScores)
+	{
+		return this->replacementScoreAll(_narrowAlignments, start, end, segment);
+	}
+	return this->replacementScoreAll(_wideAlignments, start, end, segment);
+}
 
-AlnScoreType Alignment::addInsertion(unsigned int pos, char base, 
-									 const std::vector<std::string>& reads) const
+template <class ScoreT>
+AlnScoreType
+Alignment::replacementScoreAll(const std::vector<BandedAlignment<ScoreT>>& alignments,
+							   size_t start, size_t end,
+							   const std::string& segment) const
 {
+	std::vector<ScoreT> buffer;
 	AlnScoreType finalScore = 0;
-	for (size_t readId = 0; readId < reads.size(); ++readId)
+	for (auto& aln : alignments)
 	{
-		//LetterIndex must start with 1 and go until (row.size - 1)
-		const ScoreMatrix& forwardScore = _forwardScores[readId];
-		const ScoreMatrix& reverseScore = _reverseScores[readId];
+		finalScore += aln.replacementScore(start, end, segment,
+										   _subsMatrix, buffer);
+	}
+	return finalScore;
+}
 
-		size_t frontRow = pos - 1;
-		size_t revRow = reverseScore.nrows() - pos;
+template <class ScoreT>
+bool Alignment::BandedAlignment<ScoreT>::needsReset(size_t consensusLen) const
+{
+	if (_forwardScores.nrows() == 0) return true;
+	if (consensusLen > _maxConsensusLen) return true;
+
+	//the end of the alignment should be well within the band
+	int lengthDiff = std::abs((int)_readLen - (int)consensusLen);
+	return lengthDiff > _radius - (int)_bandWidth / 2;
+}
 
-		std::vector<AlnScoreType> sub(reads[readId].size() + 1);
-		sub[0] = forwardScore.at(frontRow, 0) + _subsMatrix.getScore(base, '-');
-		for (size_t i = 0; i < reads[readId].size(); ++i)
+template <class ScoreT>
+void Alignment::BandedAlignment<ScoreT>::reset(const std::string& read,
+											   size_t consensusLen,
+											   const SubstitutionMatrix& sm,
+											   size_t bandWidth)
+{
+	_read = read;
+	_readLen = read.size();
+	_consensusLen = consensusLen;
+	_maxConsensusLen = consensusLen + bandWidth;
+	_bandWidth = bandWidth;
+	_overflow = false;
+
+	//band is wide enough to fit the length difference between the
+	//read and consensus, but does not go beyond the matrix boundaries
+	_radius = bandWidth + std::abs((int)_readLen - (int)consensusLen);
+	_diagLo = -std::min(_radius, (int)_maxConsensusLen);
+	_diagHi = std::min(_radius, (int)_readLen);
+	size_t width = _diagHi - _diagLo + 1;
+	_forwardScores = ScoreMatrix(consensusLen + 1, width, NEG_INF);
+	_reverseScores = ScoreMatrix(consensusLen + 1, width, NEG_INF);
+
+	for (size_t i = 0; i < 4; ++i)
+	{
+		_profiles[i].assign(_readLen + 2, 0);
+		for (size_t j = 0; j < _readLen; ++j)
 		{
-			AlnScoreType match = forwardScore.at(frontRow, i) + 
-							_subsMatrix.getScore(base, reads[readId][i]);
-			AlnScoreType ins = forwardScore.at(frontRow, i + 1) + 
-							_subsMatrix.getScore(base, '-');
-			sub[i + 1] = std::max(match, ins);
+			_profiles[i][j + 1] = sm.getScore(NUCLEOTIDES[i], read[j]);
 		}
+	}
+	_insertionProfile.assign(_readLen + 2, 0);
+	for (size_t j = 0; j < _readLen; ++j)
+	{
+		_insertionProfile[j + 1] = sm.getScore('-', read[j]);
+	}
+}
+
+template <class ScoreT>
+const ScoreT*
+Alignment::BandedAlignment<ScoreT>::matchProfile(char base,
+												 const SubstitutionMatrix& sm,
+												 std::vector<ScoreT>& buffer) const
+{
+	int index = nucleotideIndex(base);
+	if (index >= 0) return _profiles[index].data();
+
+	buffer.assign(_readLen + 2, 0);
+	for (size_t j = 0; j < _readLen; ++j)
+	{
+		buffer[j + 1] = sm.getScore(base, _read[j]);
+	}
+	return buffer.data();
+}
+
+template <class ScoreT>
+AlnScoreType
+Alignment::BandedAlignment<ScoreT>::update(const std::string& consensus,
+										   size_t forwardFrom,
+										   size_t reverseFrom,
+										   const SubstitutionMatrix& sm)
+{
+	_consensusLen = consensus.size();
+	_forwardScores.resizeRows(_consensusLen + 1);
+	_reverseScores.resizeRows(_consensusLen + 1);
+
+	for (size_t row = forwardFrom; row < _consensusLen + 1; ++row)
+	{
+		this->fillForwardRow(consensus, row, sm);
+	}
+	for (size_t row = reverseFrom; row < _consensusLen + 1; ++row)
+	{
+		this->fillReverseRow(consensus, row, sm);
+	}
+
+	if (consensus.empty() || _read.empty()) return 0;
+	int lastIndex = (int)_readLen - (int)_consensusLen - _diagLo;
+	return _forwardScores.at(_consensusLen, lastIndex);
+}
+
+//Forward row i stores cells (i, j) at index k = j - i - diagLo.
+template <class ScoreT>
+void Alignment::BandedAlignment<ScoreT>::fillForwardRow(const std::string& consensus,
+														size_t row,
+														const SubstitutionMatrix& sm)
+{
+	ScoreT* cur = &_forwardScores.at(row, 0);
+	if (row == 0)
+	{
+		const int width = _diagHi - _diagLo + 1;
+		const int kLo = std::max(0, -_diagLo);
+		const int kHi = std::min(width - 1, (int)_readLen - _diagLo);
+		const ScoreT* insertion = _insertionProfile.data() + _diagLo;
+
+		for (int k = 0; k < kLo; ++k) cur[k] = NEG_INF;
+		for (int k = std::max(kLo, kHi + 1); k < width; ++k) cur[k] = NEG_INF;
+		if (kLo > kHi) return;
 
-		AlnScoreType maxVal = std::numeric_limits<AlnScoreType>::lowest();
-		for (size_t col = 0; col < forwardScore.ncols(); ++col)
+		cur[kLo] = 0;
+		for (int k = kLo + 1; k <= kHi; ++k)
 		{
-			size_t backCol = forwardScore.ncols() - col - 1;
-			AlnScoreType sum = sub[col] + reverseScore.at(revRow, backCol);
-			maxVal = std::max(maxVal, sum);
+			cur[k] = cur[k - 1] + insertion[k];
 		}
-		finalScore += maxVal;
+		return;
 	}
-	return finalScore;
+
+	ScoreT rowMin = this->nextForwardRow(&_forwardScores.at(row - 1, 0), cur,
+										 row, consensus[row - 1], sm);
+	if (rowMin < SAFE_MIN) _overflow = true;
 }
 
+//Computes the forward row from the previous one, given the consensus
+//letter of the row. First, the diagonal and vertical moves are computed
+//(independent for all cells, vectorized by the compiler), then
+//horizontal moves. Returns the minimum score in the row
+template <class ScoreT>
+ScoreT Alignment::BandedAlignment<ScoreT>::nextForwardRow(const ScoreT* prev,
+														  ScoreT* cur, size_t row,
+														  char letter,
+														  const SubstitutionMatrix& sm) const
+{
+	const int width = _diagHi - _diagLo + 1;
+	const int jShift = (int)row + _diagLo;
+	const int kLo = std::max(0, -jShift);
+	const int kHi = std::min(width - 1, (int)_readLen - jShift);
+	const ScoreT* insertion = _insertionProfile.data() + jShift;
+
+	for (int k = 0; k < kLo; ++k) cur[k] = NEG_INF;
+	for (int k = std::max(kLo, kHi + 1); k < width; ++k) cur[k] = NEG_INF;
+	if (kLo > kHi) return 0;
+
+	const ScoreT deletion = sm.getScore(letter, '-');
+	std::vector<ScoreT> buffer;
+	const ScoreT* match = this->matchProfile(letter, sm, buffer) + jShift;
+
+	const int kVert = std::min(kHi, width - 2);
+	for (int k = kLo; k <= kVert; ++k)
+	{
+		cur[k] = std::max(prev[k + 1] + deletion, prev[k] + match[k]);
+	}
+	if (kHi == width - 1) cur[kHi] = prev[kHi] + match[kHi];
+
+	ScoreT rowMin = cur[kLo];
+	for (int k = kLo + 1; k <= kHi; ++k)
+	{
+		cur[k] = std::max(cur[k], cur[k - 1] + insertion[k]);
+		rowMin = std::min(rowMin, cur[k]);
+	}
+	return rowMin;
+}
 
-AlnScoreType Alignment::getScoringMatrix(const std::string& v, 
-										 const std::string& w,
-								  		 ScoreMatrix& scoreMat) 
+//Reverse row i aligns the last i letters of the consensus
+//to the read suffixes. Cell with the read suffix starting from
+//the column j is stored at index k = j + i + diagHi - readLen
+template <class ScoreT>
+void Alignment::BandedAlignment<ScoreT>::fillReverseRow(const std::string& consensus,
+														size_t row,
+														const SubstitutionMatrix& sm)
 {
-	AlnScoreType score = 0;
-	
-	for (size_t i = 0; i < v.size(); i++) 
+	const int width = _diagHi - _diagLo + 1;
+	const int jShift = (int)_readLen - (int)row - _diagHi;
+	const int kLo = std::max(0, -jShift);
+	const int kHi = std::min(width - 1, (int)_readLen - jShift);
+	ScoreT* cur = &_reverseScores.at(row, 0);
+	const ScoreT* insertion = _insertionProfile.data() + jShift + 1;
+
+	for (int k = 0; k < kLo; ++k) cur[k] = NEG_INF;
+	for (int k = std::max(kLo, kHi + 1); k < width; ++k) cur[k] = NEG_INF;
+	if (kLo > kHi) return;
+
+	if (row == 0)
 	{
-		AlnScoreType score = _subsMatrix.getScore(v[i], '-');
-		scoreMat.at(i + 1, 0) = scoreMat.at(i, 0) + score;
+		cur[kHi] = 0;
+		for (int k = kHi - 1; k >= kLo; --k)
+		{
+			cur[k] = cur[k + 1] + insertion[k];
+		}
+		return;
 	}
 
+	const ScoreT* prev = &_reverseScores.at(row - 1, 0);
+	const char letter = consensus[_consensusLen - row];
+	const ScoreT deletion = sm.getScore(letter, '-');
+	std::vector<ScoreT> buffer;
+	const ScoreT* match = this->matchProfile(letter, sm, buffer) + jShift + 1;
 
-	for (size_t i = 0; i < w.size(); i++) {
-		AlnScoreType score = _subsMatrix.getScore('-', w[i]);
-		scoreMat.at(0, i + 1) = scoreMat.at(0, i) + score;
+	const int kVert = std::max(kLo, 1);
+	if (kLo == 0) cur[0] = prev[0] + match[0];
+	for (int k = kVert; k <= kHi; ++k)
+	{
+		cur[k] = std::max(prev[k - 1] + deletion, prev[k] + match[k]);
 	}
 
+	ScoreT rowMin = cur[kHi];
+	for (int k = kHi - 1; k >= kLo; --k)
+	{
+		cur[k] = std::max(cur[k], cur[k + 1] + insertion[k]);
+		rowMin = std::min(rowMin, cur[k]);
+	}
+	if (rowMin < SAFE_MIN) _overflow = true;
+}
+
+//Checks if the best alignment goes through a cell on the band
+//edge, i.e. if the sum of the forward and reverse scores of the
+//cell is equal to the total score. Edges that coincide with the
+//matrix boundaries are not limiting, so they are skipped
+template <class ScoreT>
+bool Alignment::BandedAlignment<ScoreT>::touchesBandEdge(AlnScoreType score) const
+{
+	if (_consensusLen == 0 || _readLen == 0) return false;
 
-	for (size_t i = 1; i < v.size() + 1; i++)
+	const int width = _diagHi - _diagLo + 1;
+	const int shift = (int)_consensusLen + _diagLo + _diagHi - (int)_readLen;
+	std::vector<int> edges;
+	if (_diagLo > -(int)_consensusLen) edges.push_back(0);
+	if (_diagHi < (int)_readLen) edges.push_back(width - 1);
+
+	for (size_t row = 0; row < _consensusLen + 1; ++row)
 	{
-		char key1 = v[i - 1];
-		for (size_t j = 1; j < w.size() + 1; j++) 
+		const ScoreT* front = &_forwardScores.at(row, 0);
+		const ScoreT* reverse = &_reverseScores.at(_consensusLen - row, 0);
+		for (int k : edges)
 		{
-			char key2 = w[j - 1];
+			if (k + shift < 0 || k + shift >= width) continue;
+			if ((AlnScoreType)front[k] + reverse[k + shift] == score) return true;
+		}
+	}
+	return false;
+}
 
-			AlnScoreType left = scoreMat.at(i, j - 1) + 
-							_subsMatrix.getScore('-', key2);
-			AlnScoreType up = scoreMat.at(i - 1, j) + 
-							_subsMatrix.getScore(key1, '-');
-			score = std::max(left, up);
+//maximum sum of the forward row cells and the reverse row cells
+//that correspond to the same read column
+template <class ScoreT>
+AlnScoreType
+Alignment::BandedAlignment<ScoreT>::combineRows(const ScoreT* front,
+												size_t frontRow,
+												size_t revRow) const
+{
+	const int width = _diagHi - _diagLo + 1;
+	const int shift = (int)frontRow + (int)revRow + _diagLo + _diagHi -
+					  (int)_readLen;
+	const ScoreT* reverse = &_reverseScores.at(revRow, 0);
+	const int kLo = std::max(0, -shift);
+	const int kHi = std::min(width, width - shift);
 
-			AlnScoreType cross = scoreMat.at(i - 1, j - 1) + 
-							_subsMatrix.getScore(key1, key2);
-			score = std::max(score, cross);
-			scoreMat.at(i, j) = score;
-		}
+	ScoreT maxVal = NEG_INF;
+	for (int k = kLo; k < kHi; ++k)
+	{
+		maxVal = std::max(maxVal, (ScoreT)(front[k] + reverse[k + shift]));
+	}
+	return maxVal;
+}
+
+template <class ScoreT>
+AlnScoreType
+Alignment::BandedAlignment<ScoreT>::deletionScore(size_t letterIndex) const
+{
+	size_t frontRow = letterIndex - 1;
+	size_t revRow = _consensusLen - letterIndex;
+	return this->combineRows(&_forwardScores.at(frontRow, 0),
+							 frontRow, revRow);
+}
+
+//Score of the alignment with the consensus segment [start, end)
+//replaced by the given sequence. Forward rows of the new letters
+//are computed from the row of the consensus prefix, the last one
+//is combined with the reverse row of the consensus suffix
+template <class ScoreT>
+AlnScoreType
+Alignment::BandedAlignment<ScoreT>::replacementScore(size_t start, size_t end,
+													 const std::string& segment,
+													 const SubstitutionMatrix& sm,
+													 std::vector<ScoreT>& buffer) const
+{
+	//same as for the full alignment of an empty sequence
+	if (_readLen == 0 ||
+		_consensusLen - (end - start) + segment.size() == 0) return 0;
+
+	const int width = _diagHi - _diagLo + 1;
+	buffer.resize(2 * width);
+	const ScoreT* front = &_forwardScores.at(start, 0);
+	for (size_t i = 0; i < segment.size(); ++i)
+	{
+		ScoreT* cur = buffer.data() + (i % 2) * width;
+		this->nextForwardRow(front, cur, start + i + 1, segment[i], sm);
+		front = cur;
 	}
+	return this->combineRows(front, start + segment.size(),
+							 _consensusLen - end);
+}
 
-	return score;
+//Score of the alignment with a new letter inserted after the
+//consensus prefix of the length frontRow, followed by the consensus
+//suffix of the length revRow (substitution is a special case).
+//Forward row for the new letter is computed in the band of
+//frontRow and combined with the reverse row on the fly
+template <class ScoreT>
+AlnScoreType
+Alignment::BandedAlignment<ScoreT>::insertionScore(size_t frontRow,
+												   size_t revRow, char base,
+												   const SubstitutionMatrix& sm) const
+{
+	const int width = _diagHi - _diagLo + 1;
+	const int shift = (int)frontRow + (int)revRow + _diagLo + _diagHi -
+					  (int)_readLen;
+	const ScoreT* prev = &_forwardScores.at(frontRow, 0);
+	const ScoreT* reverse = &_reverseScores.at(revRow, 0);
+	const ScoreT deletion = sm.getScore(base, '-');
+	std::vector<ScoreT> buffer;
+	const int jShift = (int)frontRow + _diagLo;
+	const ScoreT* match = this->matchProfile(base, sm, buffer) + jShift;
+
+	//cells should be within the reverse row band and the read
+	const int kLo = std::max(std::max(0, -shift), -jShift);
+	const int kHi = std::min(std::min(width, width - shift), 
+							 (int)_readLen - jShift + 1);
+	if (kLo >= kHi) return NEG_INF;
+
+	ScoreT maxVal = NEG_INF;
+	if (kLo == 0)
+	{
+		ScoreT newCell = std::max((ScoreT)(prev[0] + deletion), NEG_INF);
+		maxVal = std::max(maxVal, (ScoreT)(newCell + reverse[shift]));
+	}
+	for (int k = std::max(kLo, 1); k < kHi; ++k)
+	{
+		ScoreT newCell = std::max((ScoreT)(prev[k - 1] + match[k]),
+								  (ScoreT)(prev[k] + deletion));
+		newCell = std::max(newCell, NEG_INF);
+		maxVal = std::max(maxVal, (ScoreT)(newCell + reverse[k + shift]));
+	}
+	return maxVal;
+}
+
+//Adds the scores of all edits at the position to the given scores.
+//All edits share the forward row of the consensus prefix, so the new
+//letter cells are computed for the four nucleotides together and combined
+//with the reverse row of the suffix that starts with the position letter
+//(insertions) or the next one (deletion and substitutions)
+template <class ScoreT>
+void Alignment::BandedAlignment<ScoreT>::addEditScores(size_t position,
+													   const SubstitutionMatrix& sm,
+													   EditScores& scores) const
+{
+	const int jShift = (int)position + _diagLo;
+	const ScoreT* match[4];
+	ScoreT deletion[4];
+	for (size_t i = 0; i < 4; ++i)
+	{
+		match[i] = _profiles[i].data() + jShift;
+		deletion[i] = sm.getScore(NUCLEOTIDES[i], '-');
+	}
+
+	ScoreT maxVals[4];
+	this->combineNewRows(position, _consensusLen - position, 
+						 match, deletion, maxVals);
+	for (size_t i = 0; i < 4; ++i) scores.insertions[i] += maxVals[i];
+	if (position == _consensusLen) return;
+
+	const size_t revRow = _consensusLen - position - 1;
+	this->combineNewRows(position, revRow, match, deletion, maxVals);
+	for (size_t i = 0; i < 4; ++i) scores.substitutions[i] += maxVals[i];
+	scores.deletion += this->combineRows(&_forwardScores.at(position, 0),
+										 position, revRow);
+}
+
+//Same as insertionScore, but for all four nucleotides in one sweep
+template <class ScoreT>
+void Alignment::BandedAlignment<ScoreT>::combineNewRows(size_t frontRow,
+														size_t revRow,
+														const ScoreT* const* match,
+														const ScoreT* deletion,
+														ScoreT* maxVals) const
+{
+	const int width = _diagHi - _diagLo + 1;
+	const int shift = (int)frontRow + (int)revRow + _diagLo + _diagHi -
+					  (int)_readLen;
+	const ScoreT* prev = &_forwardScores.at(frontRow, 0);
+	const ScoreT* reverse = &_reverseScores.at(revRow, 0) + shift;
+	const int jShift = (int)frontRow + _diagLo;
+
+	const int kLo = std::max(std::max(0, -shift), -jShift);
+	const int kHi = std::min(std::min(width, width - shift), 
+							 (int)_readLen - jShift + 1);
+	for (size_t i = 0; i < 4; ++i) maxVals[i] = NEG_INF;
+	if (kLo >= kHi) return;
+
+	if (kLo == 0)
+	{
+		for (size_t i = 0; i < 4; ++i)
+		{
+			ScoreT newCell = std::max((ScoreT)(prev[0] + deletion[i]), NEG_INF);
+			maxVals[i] = std::max(maxVals[i], (ScoreT)(newCell + reverse[0]));
+		}
+	}
+	ScoreT maxA = maxVals[0];
+	ScoreT maxC = maxVals[1];
+	ScoreT maxG = maxVals[2];
+	ScoreT maxT = maxVals[3];
+	auto newCell = [prev, match, deletion](int k, int i)
+	{
+		ScoreT cell = std::max((ScoreT)(prev[k - 1] + match[i][k]),
+							   (ScoreT)(prev[k] + deletion[i]));
+		return std::max(cell, NEG_INF);
+	};
+	for (int k = std::max(kLo, 1); k < kHi; ++k)
+	{
+		maxA = std::max(maxA, (ScoreT)(newCell(k, 0) + reverse[k]));
+		maxC = std::max(maxC, (ScoreT)(newCell(k, 1) + reverse[k]));
+		maxG = std::max(maxG, (ScoreT)(newCell(k, 2) + reverse[k]));
+		maxT = std::max(maxT, (ScoreT)(newCell(k, 3) + reverse[k]));
+	}
+	maxVals[0] = maxA;
+	maxVals[1] = maxC;
+	maxVals[2] = maxG;
+	maxVals[3] = maxT;
 }
@@ -9,33 +9,163 @@
 #include <algorithm>
 #include <iomanip>
 #include <stdexcept>
+#include <limits>
 
 #include "../common/matrix.h"
 #include "subs_matrix.h"
 
 
-class Alignment 
+//Computes the likelihood of a consensus given a set of reads
+//(sum of the global alignment scores), as well as the likelihoods
+//of the single-letter consensus edits. Consensus and reads are
+//nearly identical, so the dynamic programming is restricted to a
+//diagonal band around the main diagonal. If the best banded alignment
+//of a read touches the band edge, it is recomputed with the doubled band.
+//This is a heuristic: an alignment that leaves the band entirely could
+//still be better than the banded one. Scores are stored as 32-bit
+//integers, and if they might overflow, the alignment switches to 64-bit.
+class Alignment
 {
 
 public:
-	Alignment(size_t size, const SubstitutionMatrix& sm);
+	static const size_t DEFAULT_BAND_WIDTH = 32;
 
-	typedef Matrix<AlnScoreType> ScoreMatrix;
+	Alignment(size_t size, const SubstitutionMatrix& sm,
+			  size_t bandWidth = DEFAULT_BAND_WIDTH);
 
+	//Aligns the consensus to all reads and stores the forward and
+	//reverse DP matrices. The reads must be the same in all calls.
+	//Only the rows that are affected by the consensus changes since
+	//the previous call (outside of the common prefix / suffix)
+	//are recomputed
 	AlnScoreType globalAlignment(const std::string& consensus,
 								 const std::vector<std::string>& reads);
 
+	//Scores of all single-letter edits at a consensus position
+	//(indexed by the nucleotide: A, C, G, T). Insertions go before
+	//the letter at the position; for the position equal to the consensus
+	//length only insertions (at the end) are defined
+	struct EditScores
+	{
+		AlnScoreType deletion;
+		AlnScoreType insertions[4];
+		AlnScoreType substitutions[4];
+	};
+
+	//computes all edit scores at the position in a single pass
+	//over the forward / reverse rows of each read
+	void scoreEdits(size_t position, EditScores& scores) const;
+
 	AlnScoreType addDeletion(unsigned int letterIndex) const;
 	AlnScoreType addSubstitution(unsigned int letterIndex,
 						   		 char base, const std::vector<std::string>& reads) const;
 	AlnScoreType addInsertion(unsigned int positionIndex,
 						   	  char base, const std::vector<std::string>& reads) const;
 
+	//Score of the consensus with the segment [start, end) replaced
+	//by the given sequence. Only the rows of the new letters
+	//are computed, the rest is taken from the current alignment
+	AlnScoreType replacementScore(size_t start, size_t end,
+								  const std::string& segment) const;
+
 private:
-	std::vector<ScoreMatrix> _forwardScores;
-	std::vector<ScoreMatrix> _reverseScores;
-	const SubstitutionMatrix& _subsMatrix;
+	//Banded forward and reverse alignment matrices of a single read.
+	//Row i of the forward matrix stores cells (i, j) with
+	//j - i in [diagLo, diagHi], at index j - i - diagLo. Reverse matrix
+	//aligns the reversed sequences, its row i stores cells with
+	//the same band in the reversed coordinates, but in the order of
+	//the forward read columns, so the rows of both matrices could
+	//be combined by a linear scan. Cells outside of the read are NEG_INF.
+	template <class ScoreT>
+	class BandedAlignment
+	{
+	public:
+		static const ScoreT NEG_INF = std::numeric_limits<ScoreT>::min() / 2;
+		//if scores go below this value, they might overflow
+		static const ScoreT SAFE_MIN = std::numeric_limits<ScoreT>::min() / 8;
+
+		BandedAlignment(): _readLen(0), _consensusLen(0), _maxConsensusLen(0),
+			_bandWidth(0), _radius(0), _diagLo(0), _diagHi(0), _overflow(false) {}
+
+		//returns true if the band should be rebuilt for the new consensus
+		bool needsReset(size_t consensusLen) const;
+		void reset(const std::string& read, size_t consensusLen,
+				   const SubstitutionMatrix& sm, size_t bandWidth);
+
+		AlnScoreType update(const std::string& consensus,
+							size_t forwardFrom, size_t reverseFrom,
+							const SubstitutionMatrix& sm);
+		bool overflow() const {return _overflow;}
+		size_t bandWidth() const {return _bandWidth;}
+		bool touchesBandEdge(AlnScoreType score) const;
+
+		AlnScoreType deletionScore(size_t letterIndex) const;
+		AlnScoreType insertionScore(size_t frontRow, size_t revRow,
+									char base, const SubstitutionMatrix& sm) const;
+		AlnScoreType replacementScore(size_t start, size_t end,
+									  const std::string& segment,
+									  const SubstitutionMatrix& sm,
+									  std::vector<ScoreT>& buffer) const;
+		void addEditScores(size_t position, const SubstitutionMatrix& sm,
+						   EditScores& scores) const;
+
+	private:
+		typedef Matrix<ScoreT> ScoreMatrix;
 
-	AlnScoreType getScoringMatrix(const std::string& v, const std::string& w,
-							      ScoreMatrix& scoreMat);
+		void fillForwardRow(const std::string& consensus, size_t row,
+							const SubstitutionMatrix& sm);
+		void fillReverseRow(const std::string& consensus, size_t row,
+							const SubstitutionMatrix& sm);
+		ScoreT nextForwardRow(const ScoreT* prev, ScoreT* cur, size_t row,
+							  char letter, const SubstitutionMatrix& sm) const;
+		AlnScoreType combineRows(const ScoreT* front, size_t frontRow,
+								 size_t revRow) const;
+		void combineNewRows(size_t frontRow, size_t revRow,
+							const ScoreT* const* match, const ScoreT* deletion,
+							ScoreT* maxVals) const;
+		const ScoreT* matchProfile(char base, const SubstitutionMatrix& sm,
+								   std::vector<ScoreT>& buffer) const;
+
+		ScoreMatrix _forwardScores;
+		ScoreMatrix _reverseScores;
+
+		//scores of aligning each of the nucleotides (and a gap) to the
+		//read letters. Profile position j + 1 corresponds to read letter j,
+		//positions outside of the read are padded
+		std::vector<ScoreT> _profiles[4];
+		std::vector<ScoreT> _insertionProfile;
+		std::string _read;
+
+		size_t _readLen;
+		size_t _consensusLen;
+		size_t _maxConsensusLen;
+		size_t _bandWidth;
+		int _radius;
+		int _diagLo;
+		int _diagHi;
+		bool _overflow;
+	};
+
+	template <class ScoreT>
+	void scoreEditsAll(const std::vector<BandedAlignment<ScoreT>>& alignments,
+					   size_t position, EditScores& scores) const;
+
+	template <class ScoreT>
+	AlnScoreType replacementScoreAll(const std::vector<BandedAlignment<ScoreT>>&
+										alignments, size_t start, size_t end,
+									 const std::string& segment) const;
+
+	template <class ScoreT>
+	AlnScoreType alignAll(std::vector<BandedAlignment<ScoreT>>& alignments,
+						  const std::string& consensus,
+						  const std::vector<std::string>& reads,
+						  size_t validPrefix, size_t validSuffix);
+
+	std::vector<BandedAlignment<int32_t>> 		_narrowAlignments;
+	std::vector<BandedAlignment<AlnScoreType>> 	_wideAlignments;
+	bool _wideScores;
+	std::string _consensus;
+	bool _aligned;
+	size_t _bandWidth;
+	const SubstitutionMatrix& _subsMatrix;
 };
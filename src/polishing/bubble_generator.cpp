@@ -0,0 +1,1004 @@
+//(c) 2020 by Authors
+//This file is a part of Flye program.
+//Released under the BSD license (see LICENSE file)
+
+#include <algorithm>
+#include <cctype>
+#include <random>
+#include <fstream>
+#include <stdexcept>
+#include <exception>
+
+#include <htslib/sam.h>
+#include <zlib.h>
+
+#include "bubble_generator.h"
+#include "../common/parallel.h"
+
+namespace
+{
+	//reads (possibly gzipped) fasta as is, only converting to upper case.
+	//Unlike SequenceContainer, ambiguous bases are kept
+	std::vector<std::pair<std::string, std::string>> 
+		readFastaRaw(const std::string& filename)
+	{
+		gzFile fd = gzopen(filename.c_str(), "rb");
+		if (!fd)
+		{
+			throw std::runtime_error("Can't open contigs file " + filename);
+		}
+
+		std::vector<std::pair<std::string, std::string>> records;
+		const int BUF_SIZE = 1024 * 1024;
+		std::vector<char> buffer(BUF_SIZE);
+		std::string line;
+		while (gzgets(fd, buffer.data(), BUF_SIZE))
+		{
+			line += buffer.data();
+			if (line.back() != '\n' && !gzeof(fd)) continue;
+
+			while (!line.empty() && std::isspace((unsigned char)line.back())) line.pop_back();
+			if (line.empty()) continue;
+			if (line[0] == '>')
+			{
+				size_t nameEnd = line.find_first_of(" \t");
+				records.emplace_back(line.substr(1, nameEnd == std::string::npos ?
+												 std::string::npos : nameEnd - 1),
+									 "");
+			}
+			else if (!records.empty())
+			{
+				for (char& c : line) c = std::toupper((unsigned char)c);
+				records.back().second += line;
+			}
+			line.clear();
+		}
+		gzclose(fd);
+		return records;
+	}
+
+	//Fisher-Yates shuffle with an explicit reduction of the generator
+	//output, so the order is the same with any standard library
+	//(std::shuffle and std::uniform_int_distribution are implementation-defined).
+	//Does not reproduce the order of Python's random.shuffle
+	template <class T>
+	void deterministicShuffle(std::vector<T>& values, uint32_t seed)
+	{
+		std::mt19937 generator(seed);
+		for (size_t i = values.size(); i > 1; --i)
+		{
+			//maps 32-bit output into [0, i)
+			size_t j = ((uint64_t)generator() * i) >> 32;
+			std::swap(values[i - 1], values[j]);
+		}
+	}
+
+	template <class T>
+	double getMedian(std::vector<T> values)
+	{
+		if (values.empty()) return 0;
+		std::sort(values.begin(), values.end());
+		size_t mid = values.size() / 2;
+		if (values.size() % 2 == 1) return values[mid];
+		return ((double)values[mid - 1] + values[mid]) / 2;
+	}
+
+	//shifts all ambiguous query gaps to the right
+	std::string shiftGaps(const std::string& seqTrg, const std::string& seqQry)
+	{
+		std::string lstTrg = "$" + seqTrg + "$";
+		std::string lstQry = "$" + seqQry + "$";
+		bool isGap = false;
+		int gapStart = 0;
+		for (int i = 0; i < (int)lstTrg.size(); ++i)
+		{
+			if (isGap && lstQry[i] != '-')
+			{
+				isGap = false;
+				int swapLeft = gapStart - 1;
+				int swapRight = i - 1;
+				while (swapLeft > 0 && swapRight >= gapStart &&
+					   lstQry[swapLeft] == lstTrg[swapRight])
+				{
+					std::swap(lstQry[swapLeft], lstQry[swapRight]);
+					--swapLeft;
+					--swapRight;
+				}
+			}
+			if (!isGap && lstQry[i] == '-')
+			{
+				isGap = true;
+				gapStart = i;
+			}
+		}
+		return lstQry.substr(1, lstQry.size() - 2);
+	}
+
+	//read segment without gaps, ambiguous nucleotides are replaced
+	std::string toAcgt(const std::string& gappedSeq, size_t start, size_t end)
+	{
+		static const std::string FROM = "URYKMSWBVDHNX";
+		static const std::string TO   = "ACGTACGTACGTA";
+		std::string result;
+		result.reserve(end - start);
+		for (size_t i = start; i < end; ++i)
+		{
+			char c = gappedSeq[i];
+			if (c == '-') continue;
+			size_t pos = FROM.find(c);
+			result += (pos == std::string::npos) ? c : TO[pos];
+		}
+		return result;
+	}
+
+	bool lengthLess(const std::string& s1, const std::string& s2)
+	{
+		return s1.length() < s2.length();
+	}
+
+	std::string medianBranch(const std::vector<std::string>& branches)
+	{
+		std::vector<std::string> sorted(branches);
+		std::stable_sort(sorted.begin(), sorted.end(), lengthLess);
+		return sorted[sorted.size() / 2];
+	}
+}
+
+struct BubbleGenerator::BamReader
+{
+	BamReader(const std::string& bamPath):
+		file(nullptr), header(nullptr), index(nullptr)
+	{
+		file = hts_open(bamPath.c_str(), "r");
+		if (!file) throw std::runtime_error("Can't open " + bamPath);
+		header = sam_hdr_read(file);
+		if (!header) throw std::runtime_error("Error reading header of " + bamPath);
+		index = sam_index_load(file, bamPath.c_str());
+		if (!index) throw std::runtime_error("Bam not indexed: " + bamPath);
+	}
+	~BamReader()
+	{
+		if (index) hts_idx_destroy(index);
+		if (header) bam_hdr_destroy(header);
+		if (file) hts_close(file);
+	}
+
+	htsFile* 	file;
+	bam_hdr_t* 	header;
+	hts_idx_t* 	index;
+};
+
+BubbleGenerator::BubbleGenerator(const std::string& bamPath,
+								 const std::string& contigsPath,
+								 const BubbleGeneratorParameters& parameters):
+	_bamPath(bamPath),
+	_params(parameters),
+	_sumAlnErrors(0),
+	_numAlnErrors(0)
+{
+	for (auto& rec : readFastaRaw(contigsPath))
+	{
+		_contigOrder.push_back(rec.first);
+		_contigs[rec.first] = std::move(rec.second);
+	}
+
+	//checking that the alignment could be opened
+	this->returnReader(this->takeReader());
+}
+
+BubbleGenerator::~BubbleGenerator()
+{
+}
+
+std::unique_ptr<BubbleGenerator::BamReader> BubbleGenerator::takeReader()
+{
+	{
+		std::lock_guard<std::mutex> lock(_readersMutex);
+		if (!_readers.empty())
+		{
+			auto reader = std::move(_readers.back());
+			_readers.pop_back();
+			return reader;
+		}
+	}
+	return std::unique_ptr<BamReader>(new BamReader(_bamPath));
+}
+
+void BubbleGenerator::returnReader(std::unique_ptr<BamReader> reader)
+{
+	std::lock_guard<std::mutex> lock(_readersMutex);
+	_readers.push_back(std::move(reader));
+}
+
+void BubbleGenerator::generate(int numThreads, bool showProgress,
+							   std::function<void(std::vector<Bubble>&)>
+							   		bubblesCallback)
+{
+	std::vector<ContigRegion> regions;
+	for (const auto& ctgId : _contigOrder)
+	{
+		int32_t ctgLen = _contigs.at(ctgId).length();
+		int32_t numChunks = std::max(ctgLen / _params.chunkSize, 1);
+		for (int32_t i = 0; i < numChunks; ++i)
+		{
+			int32_t start = i * _params.chunkSize;
+			int32_t end = (i + 1) * _params.chunkSize;
+			if (ctgLen - end < _params.chunkSize) end = ctgLen;
+			regions.push_back({ctgId, start, end});
+		}
+	}
+
+	std::mutex errorMutex;
+	std::exception_ptr error;
+	std::function<void(const ContigRegion&)> chunkWorker =
+		[this, &bubblesCallback, &errorMutex, &error]
+		(const ContigRegion& region)
+	{
+		try
+		{
+			auto bubbles = this->processChunk(region);
+			if (!bubbles.empty()) bubblesCallback(bubbles);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(errorMutex);
+			if (!error) error = std::current_exception();
+		}
+	};
+	processInParallel(regions, chunkWorker, numThreads, showProgress);
+	if (error) std::rethrow_exception(error);
+}
+
+void BubbleGenerator::writeStats(const std::string& filename) const
+{
+	std::ofstream fout(filename);
+	if (!fout.is_open())
+	{
+		throw std::runtime_error("Error opening stats file");
+	}
+
+	fout << "#mean_aln_error\t" << _sumAlnErrors / (_numAlnErrors + 1) << "\n";
+	for (const auto& ctgId : _contigOrder)
+	{
+		auto it = _chunkCoverage.find(ctgId);
+		if (it == _chunkCoverage.end()) continue;
+		double sumCoverage = 0;
+		for (double cov : it->second) sumCoverage += cov;
+		fout << ctgId << "\t" << (int)(sumCoverage / it->second.size()) << "\n";
+	}
+}
+
+std::vector<Bubble> BubbleGenerator::processChunk(const ContigRegion& region)
+{
+	std::vector<int32_t> depth;
+	auto alignments = this->getAlignments(region, depth);
+	if (alignments.empty()) return {};
+
+	//since we are working with contig chunks, tranform alignment coorinates
+	alignments = this->trimAndTranspose(alignments, region);
+	double meanCoverage = 0;
+	alignments = this->getUniformAlignments(alignments, region.end - region.start,
+											meanCoverage);
+	if (alignments.empty()) return {};
+
+	std::string refSeq = _contigs.at(region.ctgId).substr(region.start,
+													   region.end - region.start);
+	std::vector<double> alnErrors;
+	auto profile = this->computeProfile(alignments, refSeq, alnErrors);
+	auto partition = this->getPartition(profile);
+	auto bubbles = this->getBubbleSeqs(alignments, profile, partition,
+									   region.ctgId, region.end - region.start);
+
+	//with very high coverage, alignments were subsampled
+	if (meanCoverage > 0.9 * _params.maxReadCoverage)
+	{
+		meanCoverage = getMedian(depth);
+	}
+
+	bubbles = this->postprocessBubbles(bubbles);
+	bubbles = this->splitLongBubbles(bubbles);
+
+	//transform coordinates back
+	for (auto& bubble : bubbles) bubble.position += region.start;
+
+	std::lock_guard<std::mutex> lock(_statsMutex);
+	for (double err : alnErrors) _sumAlnErrors += err;
+	_numAlnErrors += alnErrors.size();
+	_chunkCoverage[region.ctgId].push_back(meanCoverage);
+	return bubbles;
+}
+
+//Reads alignments that overlap the region (in random order,
+//until the maximum coverage is reached), and computes the read
+//depth of the region (as "samtools depth -Q 10 -l 100")
+std::vector<BubbleGenerator::ReadAlignment>
+	BubbleGenerator::getAlignments(const ContigRegion& region,
+								   std::vector<int32_t>& depth)
+{
+	const int DEPTH_MIN_MAPQ = 10;
+	const int DEPTH_MIN_LEN = 100;
+	const uint16_t DEPTH_FILTER = BAM_FUNMAP | BAM_FSECONDARY |
+								  BAM_FQCFAIL | BAM_FDUP;
+
+	const std::string& contigStr = _contigs.at(region.ctgId);
+	std::vector<bam1_t*> records;
+	auto reader = this->takeReader();
+	int tid = bam_name2id(reader->header, region.ctgId.c_str());
+	if (tid >= 0)
+	{
+		hts_itr_t* iter = sam_itr_queryi(reader->index, tid,
+										 std::max(region.start - 1, 0),
+										 region.end);
+		bam1_t* record = bam_init1();
+		while (iter && sam_itr_next(reader->file, iter, record) >= 0)
+		{
+			records.push_back(record);
+			record = bam_init1();
+		}
+		bam_destroy1(record);
+		hts_itr_destroy(iter);
+	}
+	this->returnReader(std::move(reader));
+
+	//depth is computed using differences between the adjacent positions
+	std::vector<int32_t> depthDiff(region.end - region.start + 1, 0);
+	for (auto record : records)
+	{
+		const uint32_t* cigar = bam_get_cigar(record);
+		if ((record->core.flag & DEPTH_FILTER) ||
+			record->core.qual < DEPTH_MIN_MAPQ ||
+			bam_cigar2qlen(record->core.n_cigar, cigar) < DEPTH_MIN_LEN) continue;
+
+		int32_t trgPos = record->core.pos;
+		for (uint32_t i = 0; i < record->core.n_cigar; ++i)
+		{
+			int op = bam_cigar_op(cigar[i]);
+			int32_t size = bam_cigar_oplen(cigar[i]);
+			if (op == BAM_CMATCH || op == BAM_CEQUAL || op == BAM_CDIFF)
+			{
+				int32_t left = std::max(trgPos, region.start);
+				int32_t right = std::min(trgPos + size, region.end);
+				if (left < right)
+				{
+					++depthDiff[left - region.start];
+					--depthDiff[right - region.start];
+				}
+			}
+			if (bam_cigar_type(op) & 2) trgPos += size;
+		}
+	}
+	depth.assign(region.end - region.start, 0);
+	int32_t curDepth = 0;
+	for (size_t i = 0; i < depth.size(); ++i)
+	{
+		curDepth += depthDiff[i];
+		depth[i] = curDepth;
+	}
+
+	//shuffle alignments so that they uniformly distributed. Needed for
+	//max coverage subsampling. Using the same seed for determinism
+	deterministicShuffle(records, 42);
+
+	std::vector<ReadAlignment> alignments;
+	int64_t sequenceLength = 0;
+	for (auto record : records)
+	{
+		if (record->core.flag & BAM_FUNMAP) continue;
+		if (record->core.l_qseq == 0) continue;
+
+		std::string readStr(record->core.l_qseq, 'N');
+		const uint8_t* seq = bam_get_seq(record);
+		for (int i = 0; i < record->core.l_qseq; ++i)
+		{
+			readStr[i] = seq_nt16_str[bam_seqi(seq, i)];
+		}
+
+		ReadAlignment aln;
+		aln.readId = bam_get_qname(record);
+		aln.isSecondary = record->core.flag & BAM_FSECONDARY;
+		aln.mapQv = record->core.qual;
+
+		int32_t trgPos = record->core.pos;
+		int32_t qryPos = 0;
+		int32_t qryStart = 0;
+		int32_t hardClippedLeft = 0;
+		int32_t softClippedLeft = 0;
+		int32_t softClippedRight = 0;
+		bool leftHard = true;
+		bool leftSoft = true;
+		const uint32_t* cigar = bam_get_cigar(record);
+		for (uint32_t i = 0; i < record->core.n_cigar; ++i)
+		{
+			int op = bam_cigar_op(cigar[i]);
+			int32_t size = bam_cigar_oplen(cigar[i]);
+			if (op == BAM_CHARD_CLIP)
+			{
+				if (leftHard)
+				{
+					qryStart += size;
+					hardClippedLeft += size;
+				}
+			}
+			else if (op == BAM_CSOFT_CLIP)
+			{
+				qryPos += size;
+				if (leftSoft) softClippedLeft += size;
+				else softClippedRight += size;
+			}
+			else if (op == BAM_CMATCH || op == BAM_CEQUAL || op == BAM_CDIFF)
+			{
+				aln.qrySeq += readStr.substr(qryPos, size);
+				aln.trgSeq += contigStr.substr(trgPos, size);
+				qryPos += size;
+				trgPos += size;
+			}
+			else if (op == BAM_CINS)
+			{
+				aln.qrySeq += readStr.substr(qryPos, size);
+				aln.trgSeq += std::string(size, '-');
+				qryPos += size;
+			}
+			else if (op == BAM_CDEL)
+			{
+				aln.qrySeq += std::string(size, '-');
+				aln.trgSeq += contigStr.substr(trgPos, size);
+				trgPos += size;
+			}
+			else
+			{
+				throw std::runtime_error("Unsupported CIGAR operation: " +
+										 std::string(1, BAM_CIGAR_STR[op]));
+			}
+			leftHard = false;
+			if (op != BAM_CHARD_CLIP) leftSoft = false;
+		}
+		std::transform(aln.trgSeq.begin(), aln.trgSeq.end(),
+					   aln.trgSeq.begin(), ::toupper);
+
+		size_t matches = 0;
+		for (size_t i = 0; i < aln.trgSeq.size(); ++i)
+		{
+			if (aln.trgSeq[i] == aln.qrySeq[i]) ++matches;
+		}
+		aln.errRate = !aln.trgSeq.empty() ?
+					  1 - (double)matches / aln.trgSeq.size() : 1;
+		aln.trgStart = record->core.pos;
+		aln.trgEnd = trgPos;
+		aln.qryStart = qryStart + softClippedLeft;
+		aln.qryEnd = qryPos + hardClippedLeft - softClippedRight;
+
+		sequenceLength += aln.qryEnd - aln.qryStart;
+		alignments.push_back(std::move(aln));
+		if (sequenceLength / (int64_t)contigStr.length() >
+			_params.maxReadCoverage) break;
+	}
+	for (auto record : records) bam_destroy1(record);
+
+	//finally, sort alignments by read and by length
+	std::stable_sort(alignments.begin(), alignments.end(),
+					 [](const ReadAlignment& a1, const ReadAlignment& a2)
+					 {
+					 	if (a1.readId != a2.readId) return a1.readId < a2.readId;
+						return a1.qryEnd - a1.qryStart > a2.qryEnd - a2.qryStart;
+					 });
+	return alignments;
+}
+
+//Transforms alignments so that the are strictly within the region,
+//and shifts the coordinates relative to the region
+std::vector<BubbleGenerator::ReadAlignment>
+	BubbleGenerator::trimAndTranspose(const std::vector<ReadAlignment>& alignments,
+									  const ContigRegion& region)
+{
+	const int32_t MIN_ALN = 100;
+
+	std::vector<ReadAlignment> trimmedAln;
+	for (const auto& aln : alignments)
+	{
+		if (aln.trgStart >= region.start && aln.trgEnd <= region.end)
+		{
+			trimmedAln.push_back(aln);
+			continue;
+		}
+
+		//trimming from left
+		int32_t newQryStart = aln.qryStart;
+		int32_t newTrgStart = aln.trgStart;
+		size_t leftOffset = 0;
+		for (; leftOffset < aln.trgSeq.size(); ++leftOffset)
+		{
+			if (newTrgStart >= region.start) break;
+			if (aln.trgSeq[leftOffset] != '-') ++newTrgStart;
+			if (aln.qrySeq[leftOffset] != '-') ++newQryStart;
+		}
+
+		//trimming from right
+		int32_t newQryEnd = aln.qryEnd;
+		int32_t newTrgEnd = aln.trgEnd;
+		size_t rightOffset = 0;
+		for (; rightOffset < aln.trgSeq.size(); ++rightOffset)
+		{
+			if (newTrgEnd <= region.end) break;
+			if (aln.trgSeq[aln.trgSeq.size() - 1 - rightOffset] != '-') --newTrgEnd;
+			if (aln.qrySeq[aln.qrySeq.size() - 1 - rightOffset] != '-') --newQryEnd;
+		}
+
+		if (newTrgEnd - newTrgStart > MIN_ALN)
+		{
+			ReadAlignment trimmed = aln;
+			size_t newLength = aln.trgSeq.size() - leftOffset - rightOffset;
+			trimmed.qryStart = newQryStart;
+			trimmed.qryEnd = newQryEnd;
+			trimmed.trgStart = newTrgStart;
+			trimmed.trgEnd = newTrgEnd;
+			trimmed.qrySeq = aln.qrySeq.substr(leftOffset, newLength);
+			trimmed.trgSeq = aln.trgSeq.substr(leftOffset, newLength);
+			trimmedAln.push_back(std::move(trimmed));
+		}
+	}
+
+	for (auto& aln : trimmedAln)
+	{
+		aln.trgStart -= region.start;
+		aln.trgEnd -= region.start;
+	}
+	return trimmedAln;
+}
+
+//Leaves top alignments for each position within contig
+//assuming uniform coverage distribution
+std::vector<BubbleGenerator::ReadAlignment>
+	BubbleGenerator::getUniformAlignments(const std::vector<ReadAlignment>&
+											alignments,
+										  int32_t seqLength,
+										  double& medianCoverage)
+{
+	const int32_t WINDOW = 100;
+	const int MIN_COV = 20;
+	const double GOOD_RATE = 0.66;
+	const int MIN_QV = 20;
+
+	auto isReliable = [MIN_QV](const ReadAlignment& aln)
+	{
+		return !aln.isSecondary && aln.mapQv >= MIN_QV;
+	};
+
+	//split contig into windows, get median read coverage over all windows and
+	//determine the quality threshold cutoffs for each window
+	std::vector<int> wndPrimaryCov(seqLength / WINDOW + 1, 0);
+	for (const auto& aln : alignments)
+	{
+		if (!isReliable(aln)) continue;
+		for (int32_t i = aln.trgStart / WINDOW; i <= aln.trgEnd / WINDOW; ++i)
+		{
+			++wndPrimaryCov[i];
+		}
+	}
+	int covThreshold = std::max((int)getMedian(wndPrimaryCov), MIN_COV);
+
+	auto alnScore = [&wndPrimaryCov, covThreshold, WINDOW]
+		(const ReadAlignment& aln, int& wndGood, int& wndBad)
+	{
+		wndGood = 0;
+		wndBad = 0;
+		for (int32_t i = aln.trgStart / WINDOW; i <= aln.trgEnd / WINDOW; ++i)
+		{
+			if (wndPrimaryCov[i] < covThreshold) ++wndGood;
+			else ++wndBad;
+		}
+	};
+
+	//always keep primary alignments, regardless of local coverage.
+	//For each read, only the last secondary alignment is considered
+	std::vector<ReadAlignment> selected;
+	struct SecondaryScore
+	{
+		int wndGood;
+		int wndBad;
+		const ReadAlignment* aln;
+	};
+	std::vector<SecondaryScore> secondaryScores;
+	std::unordered_map<std::string, size_t> secondaryIds;
+	for (const auto& aln : alignments)
+	{
+		if (isReliable(aln))
+		{
+			selected.push_back(aln);
+			continue;
+		}
+
+		SecondaryScore score;
+		alnScore(aln, score.wndGood, score.wndBad);
+		score.aln = &aln;
+		auto it = secondaryIds.find(aln.readId);
+		if (it != secondaryIds.end())
+		{
+			secondaryScores[it->second] = score;
+		}
+		else
+		{
+			secondaryIds[aln.readId] = secondaryScores.size();
+			secondaryScores.push_back(score);
+		}
+	}
+
+	//now, greedily add secondary alignments, until they add useful coverage
+	std::stable_sort(secondaryScores.begin(), secondaryScores.end(),
+					 [](const SecondaryScore& s1, const SecondaryScore& s2)
+					 {
+					 	int score1 = s1.wndGood - 2 * s1.wndBad;
+					 	int score2 = s2.wndGood - 2 * s2.wndBad;
+						if (score1 != score2) return score1 > score2;
+						return s1.aln->trgEnd - s1.aln->trgStart >
+							   s2.aln->trgEnd - s2.aln->trgStart;
+					 });
+	for (const auto& score : secondaryScores)
+	{
+		int wndGood = 0;
+		int wndBad = 0;
+		alnScore(*score.aln, wndGood, wndBad);
+		if ((double)wndGood / (wndGood + wndBad) > GOOD_RATE)
+		{
+			selected.push_back(*score.aln);
+			for (int32_t i = score.aln->trgStart / WINDOW;
+				 i <= score.aln->trgEnd / WINDOW; ++i)
+			{
+				++wndPrimaryCov[i];
+			}
+		}
+	}
+
+	medianCoverage = getMedian(wndPrimaryCov);
+	return selected;
+}
+
+std::vector<BubbleGenerator::ProfileInfo>
+	BubbleGenerator::computeProfile(const std::vector<ReadAlignment>& alignments,
+									const std::string& refSequence,
+									std::vector<double>& alnErrors)
+{
+	const int32_t genomeLen = refSequence.length();
+	const size_t minAlnLen = std::min(_params.minPolishAlnLength, genomeLen / 2);
+
+	std::vector<ProfileInfo> profile(genomeLen);
+	for (int32_t i = 0; i < genomeLen; ++i) profile[i].nucl = refSequence[i];
+
+	std::unordered_map<std::string, size_t> readIndices;
+	for (const auto& aln : alignments)
+	{
+		if (aln.qrySeq.length() < minAlnLen) continue;
+		alnErrors.push_back(aln.errRate);
+
+		auto readIt = readIndices.find(aln.readId);
+		if (readIt == readIndices.end())
+		{
+			readIt = readIndices.emplace(aln.readId, readIndices.size()).first;
+		}
+		size_t readIndex = readIt->second;
+
+		std::string qrySeq = shiftGaps(aln.trgSeq, aln.qrySeq);
+		std::string trgSeq = shiftGaps(qrySeq, aln.trgSeq);
+
+		int32_t trgPos = aln.trgStart;
+		for (size_t i = 0; i < trgSeq.size(); ++i)
+		{
+			if (trgSeq[i] == '-')
+			{
+				//insertion is attributed to the previous position
+				if (trgPos > 0)
+				{
+					auto& insertions = profile[trgPos - 1].insertions;
+					if (!insertions.empty() && insertions.back().first == readIndex)
+					{
+						++insertions.back().second;
+					}
+					else
+					{
+						bool found = false;
+						for (auto& ins : insertions)
+						{
+							if (ins.first == readIndex)
+							{
+								++ins.second;
+								found = true;
+								break;
+							}
+						}
+						if (!found) insertions.emplace_back(readIndex, 1);
+					}
+				}
+				continue;
+			}
+
+			auto& profElem = profile[trgPos];
+			++profElem.coverage;
+			if (qrySeq[i] == '-')
+			{
+				++profElem.numDeletions;
+			}
+			else if (trgSeq[i] != qrySeq[i])
+			{
+				++profElem.numMissmatch;
+			}
+			++trgPos;
+		}
+	}
+
+	//each insertion is propagated to the neighboring positions
+	//within its length
+	std::vector<int32_t> propagatedDiff(genomeLen + 1, 0);
+	for (int32_t i = 0; i < genomeLen; ++i)
+	{
+		for (const auto& ins : profile[i].insertions)
+		{
+			int32_t span = ins.second;
+			++propagatedDiff[std::max(0, i - span)];
+			--propagatedDiff[std::min(i + span + 1, genomeLen)];
+		}
+	}
+	int32_t propagated = 0;
+	for (int32_t i = 0; i < genomeLen; ++i)
+	{
+		propagated += propagatedDiff[i];
+		profile[i].propagatedIns = propagated;
+	}
+
+	return profile;
+}
+
+//checks if the kmer at the given position is solid
+bool BubbleGenerator::isSolidKmer(const std::vector<ProfileInfo>& profile,
+								  int32_t position)
+{
+	for (int32_t i = position; i < position + _params.solidKmerLength; ++i)
+	{
+		if (profile[i].coverage == 0) return false;
+		double localMissmatch = (double)(profile[i].numMissmatch +
+										 profile[i].numDeletions) /
+								profile[i].coverage;
+		double localIns = (double)profile[i].propagatedIns / profile[i].coverage;
+		if (localMissmatch > _params.solidMissmatch ||
+			localIns > _params.solidIndel) return false;
+	}
+	return true;
+}
+
+//checks if the kmer with center at the given position is simple
+bool BubbleGenerator::isSimpleKmer(const std::vector<ProfileInfo>& profile,
+								   int32_t position)
+{
+	const int32_t simpleLen = _params.simpleKmerLength;
+	const int32_t extendedLen = simpleLen * 2;
+	auto nucl = [&profile, position, extendedLen](int32_t i)
+	{
+		return profile[position - extendedLen / 2 + i].nucl;
+	};
+
+	//single nucleotide homopolymers
+	for (int32_t i = extendedLen / 2 - simpleLen / 2;
+		 i < extendedLen / 2 + simpleLen / 2 - 1; ++i)
+	{
+		if (nucl(i) == nucl(i + 1)) return false;
+	}
+
+	//dinucleotide homopolymers
+	for (int32_t shift = 0; shift < 2; ++shift)
+	{
+		for (int32_t i = 0; i < simpleLen - shift - 1; ++i)
+		{
+			int32_t pos = extendedLen / 2 - simpleLen + shift + i * 2;
+			if (nucl(pos) == nucl(pos + 2) &&
+				nucl(pos + 1) == nucl(pos + 3)) return false;
+		}
+	}
+	return true;
+}
+
+//partitions genome into sub-alignments at solid regions / simple kmers
+std::vector<int32_t>
+	BubbleGenerator::getPartition(const std::vector<ProfileInfo>& profile)
+{
+	const int32_t solidLen = _params.solidKmerLength;
+	const int32_t simpleLen = _params.simpleKmerLength;
+	const int32_t profileLen = profile.size();
+
+	std::vector<bool> solidFlags(profileLen, false);
+	int32_t profPos = 0;
+	while (profPos < profileLen - solidLen)
+	{
+		if (this->isSolidKmer(profile, profPos))
+		{
+			for (int32_t i = profPos; i < profPos + solidLen; ++i)
+			{
+				solidFlags[i] = true;
+			}
+			profPos += solidLen;
+		}
+		else
+		{
+			++profPos;
+		}
+	}
+
+	std::vector<int32_t> partition;
+	int32_t prevPartition = solidLen;
+	profPos = solidLen;
+	while (profPos < profileLen - solidLen)
+	{
+		int32_t curPartition = profPos + simpleLen / 2;
+		bool landmark = std::all_of(solidFlags.begin() + profPos,
+									solidFlags.begin() +
+										std::min(profPos + simpleLen, profileLen),
+									[](bool f) {return f;}) &&
+						this->isSimpleKmer(profile, curPartition);
+
+		if (landmark || profPos - prevPartition > _params.maxBubbleLength)
+		{
+			partition.push_back(curPartition);
+			prevPartition = curPartition;
+			profPos += solidLen;
+		}
+		else
+		{
+			++profPos;
+		}
+	}
+	return partition;
+}
+
+//given genome landmarks, forms bubble sequences
+std::vector<Bubble>
+	BubbleGenerator::getBubbleSeqs(const std::vector<ReadAlignment>& alignments,
+								   const std::vector<ProfileInfo>& profile,
+								   const std::vector<int32_t>& partition,
+								   const std::string& contigId,
+								   int32_t contigLength)
+{
+	if (partition.empty() || alignments.empty()) return {};
+
+	std::vector<int32_t> extPartition = {0};
+	extPartition.insert(extPartition.end(), partition.begin(), partition.end());
+	extPartition.push_back(contigLength);
+
+	std::vector<Bubble> bubbles;
+	for (size_t i = 0; i + 1 < extPartition.size(); ++i)
+	{
+		Bubble bubble;
+		bubble.header = contigId;
+		bubble.position = extPartition[i];
+		bubble.subPosition = 0;
+		for (int32_t p = extPartition[i]; p < extPartition[i + 1]; ++p)
+		{
+			bubble.candidate += profile[p].nucl;
+		}
+		bubbles.push_back(std::move(bubble));
+	}
+
+	auto bubbleIndex = [&extPartition](int32_t pos)
+	{
+		return std::upper_bound(extPartition.begin(), extPartition.end(), pos) -
+			   extPartition.begin() - 1;
+	};
+
+	for (const auto& aln : alignments)
+	{
+		int32_t bubbleId = bubbleIndex(aln.trgStart);
+		int32_t nextBubbleStart = extPartition[bubbleId + 1];
+		bool chromosomeEnd = aln.trgEnd >= extPartition.back();
+
+		bool incompleteSegment = aln.trgStart > extPartition[bubbleId];
+		int32_t trgPos = aln.trgStart;
+		size_t branchStart = 0;
+		for (size_t i = 0; i < aln.trgSeq.size(); ++i)
+		{
+			if (aln.trgSeq[i] == '-') continue;
+
+			if (trgPos >= nextBubbleStart)
+			{
+				if (!incompleteSegment)
+				{
+					bubbles[bubbleId].branches
+						.push_back(toAcgt(aln.qrySeq, branchStart, i));
+				}
+				incompleteSegment = false;
+				bubbleId = bubbleIndex(trgPos);
+				nextBubbleStart = extPartition[bubbleId + 1];
+				branchStart = i;
+			}
+			++trgPos;
+		}
+
+		if (chromosomeEnd)
+		{
+			bubbles.back().branches
+				.push_back(toAcgt(aln.qrySeq, branchStart, aln.qrySeq.size()));
+		}
+	}
+	return bubbles;
+}
+
+std::vector<Bubble> BubbleGenerator::postprocessBubbles(std::vector<Bubble>& bubbles)
+{
+	std::vector<Bubble> newBubbles;
+	for (auto& bubble : bubbles)
+	{
+		if (bubble.branches.empty()) continue;
+
+		std::string median = medianBranch(bubble.branches);
+		if (median.empty()) continue;
+
+		//only take branches that are not significantly differ in length from the median
+		std::vector<std::string> newBranches;
+		for (auto& branch : bubble.branches)
+		{
+			double inconsRate = std::abs((double)branch.length() -
+										 (double)median.length()) / median.length();
+			if (inconsRate < 0.5 && !branch.empty())
+			{
+				newBranches.push_back(std::move(branch));
+			}
+		}
+		if (newBranches.empty()) continue;
+
+		//if bubble consensus has very different length from all the branchs, replace
+		//consensus with the median branch instead
+		if (std::abs((int)median.length() - (int)bubble.candidate.length()) >
+			(int)median.length() / 2)
+		{
+			bubble.candidate = median;
+		}
+
+		//finally, keep only maximum number of branches
+		if ((int)newBranches.size() > _params.maxBubbleBranches)
+		{
+			std::stable_sort(newBranches.begin(), newBranches.end(), lengthLess);
+			size_t left = newBranches.size() / 2 - _params.maxBubbleBranches / 2;
+			newBranches = std::vector<std::string>(newBranches.begin() + left,
+												   newBranches.begin() + left +
+												   _params.maxBubbleBranches);
+		}
+
+		Bubble newBubble;
+		newBubble.header = bubble.header;
+		newBubble.position = bubble.position;
+		newBubble.subPosition = 0;
+		newBubble.candidate = std::move(bubble.candidate);
+		newBubble.branches = std::move(newBranches);
+		newBubbles.push_back(std::move(newBubble));
+	}
+	return newBubbles;
+}
+
+std::vector<Bubble> BubbleGenerator::splitLongBubbles(std::vector<Bubble>& bubbles)
+{
+	std::vector<Bubble> newBubbles;
+	for (auto& bubble : bubbles)
+	{
+		std::string median = medianBranch(bubble.branches);
+		int numChunks = median.length() / _params.maxBubbleLength;
+		if (numChunks <= 1)
+		{
+			newBubbles.push_back(std::move(bubble));
+			continue;
+		}
+
+		for (int partNum = 0; partNum < numChunks; ++partNum)
+		{
+			Bubble newBubble;
+			newBubble.header = bubble.header;
+			newBubble.position = bubble.position;
+			newBubble.subPosition = partNum;
+			for (const auto& branch : bubble.branches)
+			{
+				size_t chunkLen = branch.length() / numChunks;
+				size_t start = partNum * chunkLen;
+				size_t end = (partNum != numChunks - 1) ?
+							 (partNum + 1) * chunkLen : branch.length();
+				newBubble.branches.push_back(branch.substr(start, end - start));
+			}
+			newBubble.candidate = newBubble.branches.front();
+			newBubbles.push_back(std::move(newBubble));
+		}
+	}
+	return newBubbles;
+}
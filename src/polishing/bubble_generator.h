@@ -0,0 +1,132 @@
+//(c) 2020 by Authors
+//This file is a part of Flye program.
+//Released under the BSD license (see LICENSE file)
+
+//Generates polishing bubbles directly from the read alignment
+//(sorted and indexed BAM file). Contigs are split into chunks, which
+//are processed independently. For each chunk, the alignment profile is
+//computed, the chunk is partitioned at solid / simple k-mers, and the read
+//segments between partition points form the bubble branches.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "bubble.h"
+
+struct BubbleGeneratorParameters
+{
+	//error-mode specific thresholds of solid k-mers
+	double solidMissmatch = 0.3;
+	double solidIndel = 0.3;
+
+	int  solidKmerLength = 10;
+	int  simpleKmerLength = 4;
+	int  maxBubbleLength = 500;
+	int  maxBubbleBranches = 50;
+	int  maxReadCoverage = 1000;
+	int  minPolishAlnLength = 500;
+	int  chunkSize = 1000000;
+};
+
+class BubbleGenerator
+{
+public:
+	BubbleGenerator(const std::string& bamPath,
+					const std::string& contigsPath,
+					const BubbleGeneratorParameters& parameters);
+	~BubbleGenerator();
+
+	//Generates bubbles in parallel. Bubbles of each contig chunk
+	//are passed to the callback, which should be thread-safe
+	void generate(int numThreads, bool showProgress,
+				  std::function<void(std::vector<Bubble>&)> bubblesCallback);
+
+	//per-contig coverage and the mean alignment error rate
+	void writeStats(const std::string& filename) const;
+
+private:
+	struct ContigRegion
+	{
+		std::string ctgId;
+		int32_t 	start;
+		int32_t 	end;
+	};
+
+	struct ReadAlignment
+	{
+		std::string readId;
+		int32_t 	qryStart;
+		int32_t 	qryEnd;
+		int32_t 	trgStart;
+		int32_t 	trgEnd;
+		//gapped alignment strings
+		std::string qrySeq;
+		std::string trgSeq;
+		double 		errRate;
+		bool 		isSecondary;
+		int 		mapQv;
+	};
+
+	struct ProfileInfo
+	{
+		char 	nucl = 'N';
+		int32_t propagatedIns = 0;
+		int32_t numDeletions = 0;
+		int32_t numMissmatch = 0;
+		int32_t coverage = 0;
+		//read index and the total length of insertions
+		std::vector<std::pair<size_t, int32_t>> insertions;
+	};
+
+	//opened BAM file with its header and index. Handles
+	//are not thread-safe, each thread takes its own from the pool
+	struct BamReader;
+	std::unique_ptr<BamReader> takeReader();
+	void returnReader(std::unique_ptr<BamReader> reader);
+
+	std::vector<Bubble> processChunk(const ContigRegion& region);
+	std::vector<ReadAlignment> getAlignments(const ContigRegion& region,
+											 std::vector<int32_t>& depth);
+	std::vector<ReadAlignment> trimAndTranspose(const std::vector<ReadAlignment>&
+													alignments,
+												const ContigRegion& region);
+	std::vector<ReadAlignment> getUniformAlignments(const std::vector<ReadAlignment>&
+														alignments,
+													int32_t seqLength,
+													double& medianCoverage);
+	std::vector<ProfileInfo> computeProfile(const std::vector<ReadAlignment>&
+												alignments,
+											const std::string& refSequence,
+											std::vector<double>& alnErrors);
+	std::vector<int32_t> getPartition(const std::vector<ProfileInfo>& profile);
+	bool isSolidKmer(const std::vector<ProfileInfo>& profile,
+					 int32_t position);
+	bool isSimpleKmer(const std::vector<ProfileInfo>& profile,
+					  int32_t position);
+	std::vector<Bubble> getBubbleSeqs(const std::vector<ReadAlignment>& alignments,
+									  const std::vector<ProfileInfo>& profile,
+									  const std::vector<int32_t>& partition,
+									  const std::string& contigId,
+									  int32_t contigLength);
+	std::vector<Bubble> postprocessBubbles(std::vector<Bubble>& bubbles);
+	std::vector<Bubble> splitLongBubbles(std::vector<Bubble>& bubbles);
+
+	const std::string 		  _bamPath;
+	BubbleGeneratorParameters _params;
+	std::unordered_map<std::string, std::string> _contigs;
+	std::vector<std::string>  _contigOrder;
+
+	std::mutex 				  _readersMutex;
+	std::vector<std::unique_ptr<BamReader>> _readers;
+
+	std::mutex 				  _statsMutex;
+	std::unordered_map<std::string, std::vector<double>> _chunkCoverage;
+	double 					  _sumAlnErrors;
+	size_t 					  _numAlnErrors;
+};
@@ -5,8 +5,14 @@
 #include <chrono>
 #include <thread>
 #include <sys/stat.h>
+#include <unordered_map>
+#include <numeric>
+#include <algorithm>
+#include <tuple>
+#include <iomanip>
 
 #include "bubble_processor.h"
+#include "../common/parallel.h"
 
 namespace
 {
@@ -16,19 +22,77 @@ namespace
 		if (stat(filename.c_str(), &st) != 0) return 0;
 		return st.st_size;
 	}
+
+	//Bubbles file is a sequence of binary records, each prefixed
+	//by its length (all integers are little-endian). A record contains
+	//the contig id, the position and the sub-position (signed), the
+	//consensus and the branches (preceded by their count). Strings
+	//are prefixed by their lengths
+	uint32_t readUint32(const std::string& buffer, size_t& pos)
+	{
+		if (pos + sizeof(uint32_t) > buffer.size())
+		{
+			throw std::runtime_error("Error parsing bubbles file");
+		}
+		uint32_t value = 0;
+		for (int i = sizeof(uint32_t) - 1; i >= 0; --i)
+		{
+			value = (value << 8) | (uint8_t)buffer[pos + i];
+		}
+		pos += sizeof(uint32_t);
+		return value;
+	}
+
+	std::string readString(const std::string& buffer, size_t& pos)
+	{
+		size_t length = readUint32(buffer, pos);
+		if (pos + length > buffer.size())
+		{
+			throw std::runtime_error("Error parsing bubbles file");
+		}
+		pos += length;
+		return buffer.substr(pos - length, length);
+	}
+
+	//FNV-1a hash of the polished sequences with their coordinates,
+	//does not depend on the number of threads
+	uint64_t bubblesChecksum(const std::vector<Bubble>& bubbles)
+	{
+		uint64_t hash = 14695981039346656037ULL;
+		auto update = [&hash](const std::string& str)
+		{
+			for (char c : str)
+			{
+				hash = (hash ^ (uint8_t)c) * 1099511628211ULL;
+			}
+			hash = (hash ^ 0xff) * 1099511628211ULL;
+		};
+		for (auto& bubble : bubbles)
+		{
+			update(bubble.header);
+			update(std::to_string(bubble.position));
+			update(std::to_string(bubble.subPosition));
+			update(bubble.candidate);
+		}
+		return hash;
+	}
 }
 
 BubbleProcessor::BubbleProcessor(const std::string& subsMatPath,
 								 const std::string& hopoMatrixPath,
 								 bool showProgress, bool hopoEnabled):
+	_verbose(false),
+	_showProgress(showProgress),
 	_hopoEnabled(hopoEnabled),
 	_subsMatrix(subsMatPath),
 	_hopoMatrix(hopoMatrixPath, _hopoEnabled),
 	_generalPolisher(_subsMatrix),
 	_homoPolisher(_subsMatrix, _hopoMatrix),
 	_dinucFixer(_subsMatrix),
-	_verbose(false),
-	_showProgress(showProgress)
+	_inputQueue(QUEUE_SIZE),
+	_outputQueue(QUEUE_SIZE),
+	_nextBubbleId(0),
+	_writtenBubbles(0)
 {
 }
 
@@ -37,15 +101,12 @@ void BubbleProcessor::polishAll(const std::string& inBubbles,
 								const std::string& outConsensus,
 			   					int numThreads)
 {
-	_cachedBubbles.clear();
-	_cachedBubbles.reserve(BUBBLES_CACHE);
-
 	size_t fileLength = fileSize(inBubbles);
 	if (!fileLength)
 	{
 		throw std::runtime_error("Empty bubbles file!");
 	}
-	_bubblesFile.open(inBubbles);
+	_bubblesFile.open(inBubbles, std::ios::binary);
 	if (!_bubblesFile.is_open())
 	{
 		throw std::runtime_error("Error opening bubbles file");
@@ -53,12 +114,53 @@ void BubbleProcessor::polishAll(const std::string& inBubbles,
 
 	_progress.setFinalCount(fileLength);
 
+	this->runPipeline([this](){this->readBubbles();}, outConsensus, numThreads);
+	if (_showProgress) _progress.setDone();
+}
+
+
+void BubbleProcessor::polishAll(BubbleGenerator& generator,
+								const std::string& outConsensus,
+			   					int numThreads)
+{
+	//thread budget is split between the generation and polishing
+	int generatorThreads = std::max(numThreads / 2, 1);
+	int polishingThreads = std::max(numThreads - generatorThreads, 1);
+	auto producer = [this, &generator, generatorThreads]()
+	{
+		generator.generate(generatorThreads, _showProgress,
+						   [this](std::vector<Bubble>& bubbles)
+						   {this->enqueueBubbles(bubbles);});
+	};
+	this->runPipeline(producer, outConsensus, polishingThreads);
+}
+
+
+//Bubbles are produced by a separate thread, polished in parallel,
+//and written in the input order by a single writer
+void BubbleProcessor::runPipeline(std::function<void()> producer,
+								  const std::string& outConsensus,
+								  int numThreads)
+{
 	_consensusFile.open(outConsensus);
 	if (!_consensusFile.is_open())
 	{
 		throw std::runtime_error("Error opening consensus file");
 	}
 
+	std::thread producerThread([this, &producer]()
+	{
+		try
+		{
+			producer();
+		}
+		catch (...)
+		{
+			_producerError = std::current_exception();
+		}
+		_inputQueue.close();
+	});
+	std::thread writer(&BubbleProcessor::writerThread, this);
 	std::vector<std::thread> threads(numThreads);
 	for (size_t i = 0; i < threads.size(); ++i)
 	{
@@ -68,46 +170,121 @@ void BubbleProcessor::polishAll(const std::string& inBubbles,
 	{
 		threads[i].join();
 	}
-	if (_showProgress) _progress.setDone();
+	producerThread.join();
+	_outputQueue.close();
+	writer.join();
+
+	if (_producerError) std::rethrow_exception(_producerError);
 }
 
 
-void BubbleProcessor::parallelWorker()
+void BubbleProcessor::readBubbles()
+{
+	std::vector<Bubble> bubbles(1);
+	while (this->readBubble(bubbles.front()))
+	{
+		this->enqueueBubbles(bubbles);
+		bubbles.front() = Bubble();
+
+		int64_t filePos = _bubblesFile.tellg();
+		if (_showProgress && filePos > 0)
+		{
+			_progress.setValue(filePos);
+		}
+	}
+}
+
+
+//bubbles get consecutive indices, so they could be written in order
+void BubbleProcessor::enqueueBubbles(std::vector<Bubble>& bubbles)
 {
-	const int MAX_BUBBLE = 5000;
+	std::lock_guard<std::mutex> lock(_enqueueMutex);
+	for (auto& bubble : bubbles)
+	{
+		_inputQueue.push(std::make_pair(_nextBubbleId++, std::move(bubble)));
+	}
+}
+
 
-	_stateMutex.lock();
-	while (true)
+void BubbleProcessor::parallelWorker()
+{
+	IndexedBubble task;
+	while (_inputQueue.pop(task))
 	{
-		if (_cachedBubbles.empty())
+		this->prepareBubble(task.second);
+		this->polishBubble(task.second, STAGE_ALL);
+
+		//wait until the writer gets close enough, so the reordering
+		//buffer stays bounded. The smallest unwritten bubble
+		//never waits, so this can't deadlock
 		{
-			this->cacheBubbles(BUBBLES_CACHE);
-			if(_cachedBubbles.empty())
-			{
-				_stateMutex.unlock();
-				return;
-			}
+			std::unique_lock<std::mutex> lock(_writtenMutex);
+			_writtenCond.wait(lock, [this, &task]()
+				{return task.first < _writtenBubbles + REORDER_SIZE;});
 		}
+		_outputQueue.push(std::move(task));
+	}
+}
+
 
-		Bubble bubble = _cachedBubbles.back();
-		_cachedBubbles.pop_back();
+void BubbleProcessor::prepareBubble(Bubble& bubble) const
+{
+	std::transform(bubble.candidate.begin(), bubble.candidate.end(), 
+				   bubble.candidate.begin(), ::toupper);
+	for (auto& branch : bubble.branches)
+	{
+		std::transform(branch.begin(), branch.end(), 
+					   branch.begin(), ::toupper);
+	}
+}
+
+
+void BubbleProcessor::polishBubble(Bubble& bubble, int stages) const
+{
+	if (bubble.candidate.size() >= MAX_BUBBLE ||
+		bubble.branches.size() < 2) return;
+
+	if (stages & STAGE_GENERAL)
+	{
+		_generalPolisher.polishBubble(bubble);
+	}
+	if ((stages & STAGE_HOMO) && _hopoEnabled)
+	{
+		_homoPolisher.polishBubble(bubble);
+	}
+	if (stages & STAGE_DINUC)
+	{
+		_dinucFixer.fixBubble(bubble);
+	}
+}
 
-		if (bubble.candidate.size() < MAX_BUBBLE &&
-			bubble.branches.size() > 1)
+
+//Polished bubbles come in arbitrary order, they are kept 
+//until all the preceding bubbles are written. At most REORDER_SIZE
+//bubbles are kept, as workers wait for the writer (see parallelWorker)
+void BubbleProcessor::writerThread()
+{
+	std::unordered_map<size_t, Bubble> pending;
+	size_t nextId = 0;
+	IndexedBubble task;
+	while (_outputQueue.pop(task))
+	{
+		pending[task.first] = std::move(task.second);
+		while (pending.count(nextId))
 		{
-			_stateMutex.unlock();
-			_generalPolisher.polishBubble(bubble);
-			if (_hopoEnabled)
-			{
-				_homoPolisher.polishBubble(bubble);
-			}
-			_dinucFixer.fixBubble(bubble);
-			_stateMutex.lock();
+			std::vector<Bubble> ready;
+			ready.push_back(std::move(pending[nextId]));
+			pending.erase(nextId++);
+			this->writeBubbles(ready);
+			if (_verbose) this->writeLog(ready);
+
+			std::lock_guard<std::mutex> lock(_writtenMutex);
+			_writtenBubbles = nextId;
+			_writtenCond.notify_all();
 		}
-		
-		this->writeBubbles({bubble});
-		if (_verbose) this->writeLog({bubble});
 	}
+	_consensusFile.flush();
+	if (_verbose) _logFile.flush();
 }
 
 
@@ -116,8 +293,8 @@ void BubbleProcessor::writeBubbles(const std::vector<Bubble>& bubbles)
 	for (auto& bubble : bubbles)
 	{
 		_consensusFile << ">" << bubble.header << " " << bubble.position
-			 		   << " " << bubble.branches.size() << " " << bubble.subPosition << std::endl
-			 		   << bubble.candidate << std::endl;
+			 		   << " " << bubble.branches.size() << " " << bubble.subPosition << "\n"
+			 		   << bubble.candidate << "\n";
 	}
 }
 
@@ -142,69 +319,152 @@ void BubbleProcessor::writeLog(const std::vector<Bubble>& bubbles)
 		{
 			 _logFile << std::fixed
 				 << std::setw(22) << std::left << "Consensus: " 
-				 << std::right << stepInfo.sequence << std::endl
+				 << std::right << stepInfo.sequence << "\n"
 				 << std::setw(22) << std::left << "Score: " << std::right 
-				 << std::setprecision(2) << stepInfo.score << std::endl;
+				 << std::setprecision(2) << stepInfo.score << "\n";
 
-			_logFile << std::endl;
+			_logFile << "\n";
 		}
 		_logFile << "-----------------\n";
 	}
 }
 
 
-void BubbleProcessor::cacheBubbles(int maxRead)
+//reads the next bubble, returns false if the end of file is reached
+bool BubbleProcessor::readBubble(Bubble& bubble)
 {
-	std::string buffer;
-	std::string candidate;
+	char lengthBytes[sizeof(uint32_t)];
+	_bubblesFile.read(lengthBytes, sizeof(uint32_t));
+	if (_bubblesFile.gcount() == 0) return false;
 
-	int readBubbles = 0;
-	while (!_bubblesFile.eof() && readBubbles < maxRead)
+	std::string buffer(lengthBytes, _bubblesFile.gcount());
+	size_t pos = 0;
+	size_t recordLength = readUint32(buffer, pos);
+	buffer.resize(recordLength);
+	_bubblesFile.read(&buffer[0], recordLength);
+	if ((size_t)_bubblesFile.gcount() != recordLength)
 	{
-		std::getline(_bubblesFile, buffer);
-		if (buffer.empty()) break;
+		throw std::runtime_error("Error parsing bubbles file");
+	}
+
+	pos = 0;
+	bubble.header = readString(buffer, pos);
+	bubble.position = (int32_t)readUint32(buffer, pos);
+	bubble.subPosition = (int32_t)readUint32(buffer, pos);
+	bubble.candidate = readString(buffer, pos);
+	size_t numBranches = readUint32(buffer, pos);
+	bubble.branches.reserve(numBranches);
+	for (size_t i = 0; i < numBranches; ++i)
+	{
+		bubble.branches.push_back(readString(buffer, pos));
+	}
+	if (pos != buffer.size())
+	{
+		throw std::runtime_error("Error parsing bubbles file");
+	}
+	return true;
+}
+
+
+void BubbleProcessor::benchmark(const std::string& inBubbles, int maxThreads,
+								std::ostream& report)
+{
+	_bubblesFile.open(inBubbles, std::ios::binary);
+	if (!_bubblesFile.is_open())
+	{
+		throw std::runtime_error("Error opening bubbles file");
+	}
+	std::vector<Bubble> bubbles;
+	Bubble bubble;
+	while (this->readBubble(bubble))
+	{
+		bubbles.push_back(std::move(bubble));
+		bubble = Bubble();
+	}
+	_bubblesFile.close();
+
+	this->runBenchmark(bubbles, maxThreads, report);
+}
 
-		std::vector<std::string> elems = splitString(buffer, ' ');
-		if (elems.size() != 4 || elems[0][0] != '>')
-		{
-			throw std::runtime_error("Error parsing bubbles file");
-		}
-		std::getline(_bubblesFile, candidate);
-		std::transform(candidate.begin(), candidate.end(), 
-				       candidate.begin(), ::toupper);
-		
-		Bubble bubble;
-		bubble.candidate = candidate;
-		bubble.header = elems[0].substr(1, std::string::npos);
-		bubble.position = std::stoi(elems[1]);
-		int numOfReads = std::stoi(elems[2]);
-		bubble.subPosition = std::stoi(elems[3]);
-
-		int count = 0;
-		while (count < numOfReads) 
-		{
-			if (buffer.empty()) break;
-
-			std::getline(_bubblesFile, buffer);
-			std::getline(_bubblesFile, buffer);
-			std::transform(buffer.begin(), buffer.end(), 
-				       	   buffer.begin(), ::toupper);
-			bubble.branches.push_back(buffer);
-			count++;
-		}
-		if (count != numOfReads)
-		{
-			//std::cerr << buffer << " " << count << " " << numOfReads << std::endl;
-			throw std::runtime_error("Error parsing bubbles file");
-		}
 
-		_cachedBubbles.push_back(std::move(bubble));
-		++readBubbles;
+void BubbleProcessor::benchmark(BubbleGenerator& generator, int maxThreads,
+								std::ostream& report)
+{
+	std::vector<Bubble> bubbles;
+	std::mutex bubblesMutex;
+	generator.generate(maxThreads, _showProgress,
+					   [&bubbles, &bubblesMutex](std::vector<Bubble>& chunk)
+					   {
+						   std::lock_guard<std::mutex> lock(bubblesMutex);
+						   for (auto& bubble : chunk)
+						   {
+							   bubbles.push_back(std::move(bubble));
+						   }
+					   });
+
+	//chunks are generated in arbitrary order
+	std::sort(bubbles.begin(), bubbles.end(),
+			  [](const Bubble& b1, const Bubble& b2)
+			  {
+				  return std::tie(b1.header, b1.position, b1.subPosition) <
+						 std::tie(b2.header, b2.position, b2.subPosition);
+			  });
+	this->runBenchmark(bubbles, maxThreads, report);
+}
+
+
+void BubbleProcessor::runBenchmark(const std::vector<Bubble>& inBubbles, 
+								   int maxThreads, std::ostream& report) const
+{
+	std::vector<Bubble> bubbles = inBubbles;
+	for (auto& bubble : bubbles) this->prepareBubble(bubble);
+	std::vector<size_t> bubbleIds(bubbles.size());
+	std::iota(bubbleIds.begin(), bubbleIds.end(), 0);
+
+	std::vector<int> threadCounts;
+	for (int threads = 1; threads < maxThreads; threads *= 2)
+	{
+		threadCounts.push_back(threads);
 	}
+	threadCounts.push_back(std::max(maxThreads, 1));
 
-	int64_t filePos = _bubblesFile.tellg();
-	if (_showProgress && filePos > 0)
+	std::vector<std::pair<std::string, int>> stages = 
+		{{"general", STAGE_GENERAL}, {"dinuc", STAGE_DINUC}};
+	if (_hopoEnabled)
 	{
-		_progress.setValue(filePos);
+		stages.insert(stages.begin() + 1, {"homo", STAGE_HOMO});
+	}
+
+	report << "Bubbles: " << bubbles.size() << "\n"
+		   << "threads\tstage\tseconds\tbubbles/sec\tchecksum\n";
+	for (int numThreads : threadCounts)
+	{
+		auto timeStages = [&](std::vector<Bubble>& polished, int stageMask,
+							  const std::string& name)
+		{
+			auto start = std::chrono::steady_clock::now();
+			processInParallel<size_t>(bubbleIds, 
+				[this, &polished, stageMask](const size_t& id)
+				{this->polishBubble(polished[id], stageMask);},
+				numThreads, false);
+			double seconds = std::chrono::duration<double>
+				(std::chrono::steady_clock::now() - start).count();
+
+			report << numThreads << "\t" << name << "\t" << std::fixed
+				   << std::setprecision(3) << seconds << "\t" 
+				   << std::setprecision(1) << bubbles.size() / seconds << "\t" 
+				   << std::hex << std::setw(16) << std::setfill('0') 
+				   << bubblesChecksum(polished) << std::dec 
+				   << std::setfill(' ') << std::endl;
+		};
+
+		//each stage takes the output of the previous one as in the pipeline
+		std::vector<Bubble> polished = bubbles;
+		for (auto& stage : stages)
+		{
+			timeStages(polished, stage.second, stage.first);
+		}
+		polished = bubbles;
+		timeStages(polished, STAGE_ALL, "all");
 	}
 }
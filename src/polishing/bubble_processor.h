@@ -7,8 +7,12 @@
 #include <string>
 #include <vector>
 #include <cmath>
-#include <mutex>
 #include <fstream>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <ostream>
 
 #include "subs_matrix.h"
 #include "bubble.h"
@@ -16,7 +20,9 @@
 #include "homo_polisher.h"
 #include "utility.h"
 #include "../common/progress_bar.h"
+#include "../common/bounded_queue.h"
 #include "dinucleotide_fixer.h"
+#include "bubble_generator.h"
 
 
 class BubbleProcessor 
@@ -27,15 +33,50 @@ public:
 					bool  showProgress, bool hopoEndabled);
 	void polishAll(const std::string& inBubbles, const std::string& outConsensus,
 				   int numThreads);
+	//generates bubbles from the read alignment and polishes them on the fly
+	void polishAll(BubbleGenerator& generator, const std::string& outConsensus,
+				   int numThreads);
 	void enableVerboseOutput(const std::string& filename);
 
+	//Measures the polishing throughput on bubbles loaded into memory.
+	//For 1, 2, 4 ... maxThreads threads, the stages are timed one after
+	//another, and then the whole pipeline at once. Reports time,
+	//bubbles per second and the checksum of the polished sequences
+	void benchmark(const std::string& inBubbles, int maxThreads,
+				   std::ostream& report);
+	void benchmark(BubbleGenerator& generator, int maxThreads,
+				   std::ostream& report);
+
 private:
+	enum PolishingStage
+	{
+		STAGE_GENERAL = 1,
+		STAGE_HOMO = 2,
+		STAGE_DINUC = 4,
+		STAGE_ALL = STAGE_GENERAL | STAGE_HOMO | STAGE_DINUC
+	};
+
+	//bubble with its index in the input
+	typedef std::pair<size_t, Bubble> IndexedBubble;
+
+	void runPipeline(std::function<void()> producer,
+					 const std::string& outConsensus, int numThreads);
+	void readBubbles();
+	void enqueueBubbles(std::vector<Bubble>& bubbles);
 	void parallelWorker();
-	void cacheBubbles(int numBubbles);
+	void prepareBubble(Bubble& bubble) const;
+	void polishBubble(Bubble& bubble, int stages) const;
+	void runBenchmark(const std::vector<Bubble>& bubbles, int maxThreads,
+					  std::ostream& report) const;
+	void writerThread();
+	bool readBubble(Bubble& bubble);
 	void writeBubbles(const std::vector<Bubble>& bubbles);
 	void writeLog(const std::vector<Bubble>& bubbles);
 
-	const int BUBBLES_CACHE = 100;
+	const size_t QUEUE_SIZE = 1000;
+	//max. number of polished bubbles waiting for the preceding ones
+	const size_t REORDER_SIZE = 1000;
+	const size_t MAX_BUBBLE = 5000;
 
 	bool					  _verbose;
 	bool 					  _showProgress;
@@ -48,8 +89,14 @@ private:
 	const DinucleotideFixer	  _dinucFixer;
 
 	ProgressPercent 		  _progress;
-	std::mutex				  _stateMutex;
-	std::vector<Bubble>		  _cachedBubbles;
+	BoundedQueue<IndexedBubble> _inputQueue;
+	BoundedQueue<IndexedBubble> _outputQueue;
+	std::mutex				  _enqueueMutex;
+	size_t					  _nextBubbleId;
+	std::mutex				  _writtenMutex;
+	std::condition_variable	  _writtenCond;
+	size_t					  _writtenBubbles;
+	std::exception_ptr		  _producerError;
 
 	std::ifstream			  _bubblesFile;
 	std::ofstream			  _consensusFile;
@@ -7,27 +7,29 @@
 
 void DinucleotideFixer::fixBubble(Bubble& bubble) const
 {
-	auto likelihood = [this](const std::string& candidate, 
-						     const std::vector<std::string>& branches)
-	{
-		Alignment align(branches.size(), _subsMatrix);
-		AlnScoreType score = align.globalAlignment(candidate, branches);
-		return score;
-	};
-
 	auto runPair = this->getDinucleotideRuns(bubble.candidate);
 	if (runPair.second < 3) return;
 	
-	//try to increase / decrease dinucleotide polimer len and see what happens
+	//try to increase / decrease dinucleotide polimer len and see what happens.
+	//The candidate is aligned once, alternative runs differ from it by
+	//a single repeat unit at the run start, and only the alignment rows
+	//of the changed segment are computed for them
+	Alignment align(bubble.branches.size(), _subsMatrix);
+	AlnScoreType normalScore = align.globalAlignment(bubble.candidate,
+													 bubble.branches);
+
+	const size_t runStart = runPair.first;
+	const std::string repeatUnit = bubble.candidate.substr(runStart, 2);
+	AlnScoreType increasedScore = align.replacementScore(runStart, runStart,
+														 repeatUnit);
+	AlnScoreType decreasedScore = align.replacementScore(runStart, runStart + 2,
+														 "");
+
 	std::string increased = bubble.candidate;
-	increased.insert(runPair.first, bubble.candidate.substr(runPair.first, 2));
+	increased.insert(runStart, repeatUnit);
 
 	std::string decreased = bubble.candidate;
-	decreased.erase(runPair.first, 2);
-
-	AlnScoreType normalScore = likelihood(bubble.candidate, bubble.branches);
-	AlnScoreType increasedScore = likelihood(increased, bubble.branches);
-	AlnScoreType decreasedScore = likelihood(decreased, bubble.branches);
+	decreased.erase(runStart, 2);
 
 	/*
 	if (increasedScore > normalScore || decreasedScore > normalScore)
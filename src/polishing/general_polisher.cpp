@@ -7,16 +7,20 @@
 
 void GeneralPolisher::polishBubble(Bubble& bubble) const
 {
+	//returns the optimized candidate, and the likelihood margin between
+	//it and the best single edit of it
 	auto optimize = [this] (const std::string& candidate,
 							const std::vector<std::string>& branches,
-							std::vector<StepInfo>& polishSteps)
+							std::vector<StepInfo>& polishSteps,
+							AlnScoreType& margin)
 	{
 		std::string prevCandidate = candidate;
 		Alignment align(branches.size(), _subsMatrix);
 		size_t iterNum = 0;
 		while(true)
 		{
-			StepInfo rec = this->makeStep(prevCandidate, branches, align);
+			StepInfo rec = this->makeStep(prevCandidate, branches, align,
+										  margin);
 			polishSteps.push_back(rec);
 			if (prevCandidate == rec.sequence) break;
 			if (rec.score > 0)
@@ -37,6 +41,7 @@ void GeneralPolisher::polishBubble(Bubble& bubble) const
 	//first, select closest X branches (by length) and polish with them
 	const int PRE_POLISH = 5;
 	std::string prePolished = bubble.candidate;
+	AlnScoreType margin = 0;
 	if (bubble.branches.size() > PRE_POLISH * 2)
 	{
 		std::sort(bubble.branches.begin(), bubble.branches.end(),
@@ -47,21 +52,52 @@ void GeneralPolisher::polishBubble(Bubble& bubble) const
 		std::vector<std::string> reducedSet(bubble.branches.begin() + left,
 											bubble.branches.begin() + right);
 		prePolished = optimize(prePolished, reducedSet, 
-							   bubble.polishSteps);
+							   bubble.polishSteps, margin);
 	}
 	
-	//then, polish with all branches
-	bubble.candidate = optimize(prePolished, bubble.branches, 
-								bubble.polishSteps);
-	
+	//then, polish with a subset of branches (evenly spaced by length).
+	//If every single edit of the result is worse by a large margin
+	//(per branch), the other branches are unlikely to change it. Otherwise,
+	//the subset is doubled, until it includes all branches
+	std::string candidate = prePolished;
+	for (size_t subsetSize = MIN_SUBSET; ; subsetSize *= 2)
+	{
+		if (subsetSize >= bubble.branches.size())
+		{
+			candidate = optimize(candidate, bubble.branches,
+								 bubble.polishSteps, margin);
+			break;
+		}
+
+		std::vector<std::string> subset;
+		for (size_t i = 0; i < subsetSize; ++i)
+		{
+			subset.push_back(bubble.branches[i * bubble.branches.size() /
+											 subsetSize]);
+		}
+		candidate = optimize(candidate, subset, bubble.polishSteps, margin);
+		if (margin > MIN_BRANCH_MARGIN * (AlnScoreType)subsetSize) break;
+	}
+	bubble.candidate = candidate;
 }
 
+namespace
+{
+	//edits that are further apart than this are considered
+	//independent and could be applied within the same step
+	const size_t MIN_EDIT_DISTANCE = 10;
+}
+
+//Returns the candidate with the best improving edits applied, or
+//the same candidate if there are none. In the latter case, also
+//computes the margin between the candidate and the best edit scores
 StepInfo GeneralPolisher::makeStep(const std::string& candidate, 
 				   				   const std::vector<std::string>& branches,
-								   Alignment& align) const
+								   Alignment& align, AlnScoreType& margin) const
 {
 	static char alphabet[] = {'A', 'C', 'G', 'T'};
 	StepInfo stepResult;
+	margin = 0;
 	
 	//Alignment
 	AlnScoreType score = align.globalAlignment(candidate, branches);
@@ -69,55 +105,120 @@ StepInfo GeneralPolisher::makeStep(const std::string& candidate,
 	stepResult.sequence = candidate;
 
 	//Deletion
-	bool improvement = false;
+	AlnScoreType bestEdit = std::numeric_limits<AlnScoreType>::lowest();
+	std::vector<CandidateEdit> edits;
 	for (size_t pos = 0; pos < candidate.size(); ++pos) 
 	{
 		AlnScoreType score = align.addDeletion(pos + 1);
-
+		bestEdit = std::max(bestEdit, score);
 		if (score > stepResult.score) 
 		{
-			stepResult.score = score;
-			stepResult.sequence = candidate;
-			stepResult.sequence.erase(pos, 1);
-			improvement = true;
+			edits.push_back({score, pos, CandidateEdit::Deletion, '-'});
 		}
 	}
-	if (improvement) return stepResult;
+	if (!edits.empty()) return this->applyEdits(candidate, branches, 
+												edits, align);
 
-	//Insertion
+	//Insertions and substitutions are scored together, but
+	//insertions are still preferred
+	std::vector<CandidateEdit> substitutions;
+	Alignment::EditScores editScores;
 	for (size_t pos = 0; pos < candidate.size() + 1; ++pos) 
 	{
-		for (char letter : alphabet)
+		align.scoreEdits(pos, editScores);
+		for (size_t i = 0; i < 4; ++i)
 		{
-			AlnScoreType score = align.addInsertion(pos + 1, letter, branches);
-			if (score > stepResult.score) 
+			bestEdit = std::max(bestEdit, editScores.insertions[i]);
+			if (pos < candidate.size() && alphabet[i] != candidate[pos])
+			{
+				bestEdit = std::max(bestEdit, editScores.substitutions[i]);
+			}
+			if (editScores.insertions[i] > stepResult.score) 
+			{
+				edits.push_back({editScores.insertions[i], pos, 
+								 CandidateEdit::Insertion, alphabet[i]});
+			}
+			if (pos < candidate.size() && alphabet[i] != candidate[pos] &&
+				editScores.substitutions[i] > stepResult.score)
 			{
-				stepResult.score = score;
-				stepResult.sequence = candidate;
-				stepResult.sequence.insert(pos, 1, letter);
-				improvement = true;
+				substitutions.push_back({editScores.substitutions[i], pos,
+										 CandidateEdit::Substitution, 
+										 alphabet[i]});
 			}
 		}
 	}	
-	if (improvement) return stepResult;
+	if (!edits.empty()) return this->applyEdits(candidate, branches, 
+												edits, align);
+	if (!substitutions.empty()) return this->applyEdits(candidate, branches, 
+														substitutions, align);
 
-	//Substitution
-	for (size_t pos = 0; pos < candidate.size(); ++pos) 
+	margin = stepResult.score - bestEdit;
+	return stepResult;
+}
+
+//Given the improving edits of the same type, applies the best one,
+//together with the other edits that are far enough from it (and
+//from each other). The combined result is accepted only if its
+//actual score is better than the score of the best single edit
+StepInfo GeneralPolisher::applyEdits(const std::string& candidate,
+									 const std::vector<std::string>& branches,
+									 std::vector<CandidateEdit>& edits,
+									 Alignment& align) const
+{
+	auto editSequence = [&candidate](std::vector<CandidateEdit> toApply)
 	{
-		for (char letter : alphabet)
+		//applying from right to left, so positions stay valid
+		std::sort(toApply.begin(), toApply.end(),
+				  [](const CandidateEdit& e1, const CandidateEdit& e2)
+				  {return e1.pos > e2.pos;});
+		std::string sequence = candidate;
+		for (auto& edit : toApply)
 		{
-			if (letter == candidate[pos]) continue;
+			switch (edit.type)
+			{
+				case CandidateEdit::Deletion:
+					sequence.erase(edit.pos, 1);
+					break;
+				case CandidateEdit::Insertion:
+					sequence.insert(edit.pos, 1, edit.letter);
+					break;
+				case CandidateEdit::Substitution:
+					sequence[edit.pos] = edit.letter;
+					break;
+			}
+		}
+		return sequence;
+	};
 
-			AlnScoreType score = align.addSubstitution(pos + 1, letter, 
-											   		   branches);
-			if (score > stepResult.score) 
+	//stable, so the first of the equally scored edits is the best
+	std::stable_sort(edits.begin(), edits.end(),
+					 [](const CandidateEdit& e1, const CandidateEdit& e2)
+					 {return e1.score > e2.score;});
+	std::vector<CandidateEdit> selected = {edits.front()};
+	for (size_t i = 1; i < edits.size(); ++i)
+	{
+		bool independent = true;
+		for (auto& other : selected)
+		{
+			size_t dist = std::max(edits[i].pos, other.pos) - 
+						  std::min(edits[i].pos, other.pos);
+			if (dist <= MIN_EDIT_DISTANCE) 
 			{
-				stepResult.score = score;
-				stepResult.sequence = candidate;
-				stepResult.sequence[pos] = letter;
+				independent = false;
+				break;
 			}
 		}
+		if (independent) selected.push_back(edits[i]);
 	}
 
-	return stepResult;
+	StepInfo bestSingle;
+	bestSingle.sequence = editSequence({edits.front()});
+	bestSingle.score = edits.front().score;
+	if (selected.size() == 1) return bestSingle;
+
+	StepInfo combined;
+	combined.sequence = editSequence(selected);
+	combined.score = align.globalAlignment(combined.sequence, branches);
+	if (combined.score > bestSingle.score) return combined;
+	return bestSingle;
 }
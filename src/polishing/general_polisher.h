@@ -17,9 +17,29 @@ public:
 	void polishBubble(Bubble& bubble) const;
 
 private:
+	struct CandidateEdit
+	{
+		enum EditType {Deletion, Insertion, Substitution};
+
+		AlnScoreType score;
+		size_t pos;
+		EditType type;
+		char letter;
+	};
+
 	StepInfo makeStep(const std::string& candidate, 
 					  const std::vector<std::string>& branches,
-					  Alignment& align) const;
+					  Alignment& align, AlnScoreType& margin) const;
+	StepInfo applyEdits(const std::string& candidate,
+						const std::vector<std::string>& branches,
+						std::vector<CandidateEdit>& edits,
+						Alignment& align) const;
+
+	//the smallest branch subset used for polishing, and the log-likelihood
+	//margin per branch (one nat), at which the subset consensus
+	//is accepted without the other branches
+	static const size_t MIN_SUBSET = 20;
+	static const AlnScoreType MIN_BRANCH_MARGIN = SubstitutionMatrix::SCORE_MULT;
 
 	const SubstitutionMatrix& _subsMatrix;
 };
@@ -4,106 +4,212 @@
 
 #include <algorithm>
 #include <unordered_set>
+#include <limits>
+#include <cassert>
 
 #include "homo_polisher.h"
-#include "../common/matrix.h"
 
 
 namespace
 {
-	//Computes global pairwise alignment with custom substitution matrix
-	void pairwiseAlignment(const std::string& seqOne, const std::string& seqTwo,
-						   const SubstitutionMatrix& subsMat,
-						   std::string& outOne, std::string& outTwo)
+	const int BAND_WIDTH = 32;
+	const char NUCLEOTIDES[] = {'A', 'C', 'G', 'T'};
+
+	int nucleotideIndex(char c)
 	{
-		Matrix<AlnScoreType> scoreMat(seqOne.length() + 1, seqTwo.length() + 1);
-		Matrix<char> backtrackMat(seqOne.length() + 1, seqTwo.length() + 1);
+		switch (c)
+		{
+			case 'A': return 0;
+			case 'C': return 1;
+			case 'G': return 2;
+			case 'T': return 3;
+			default: return -1;
+		}
+	}
 
-		scoreMat.at(0, 0) = 0;
-		backtrackMat.at(0, 0) = 0;
-		for (size_t i = 0; i < seqOne.length(); ++i) 
+	//Computes global pairwise alignment with custom substitution matrix.
+	//Sequences are nearly identical, so the alignment is restricted to
+	//a diagonal band that fits the length difference. Row i stores
+	//cells (i, j) with j - i in [diagLo, diagHi] at index j - i - diagLo.
+	//Only two score rows are kept, the moves are stored in a traceback
+	//matrix with 2 bits per cell. All buffers are reused between calls
+	//in the same thread. Returns false if the scores might overflow,
+	//then the alignment should be repeated with wider scores
+	template <class ScoreT>
+	bool bandedAlignment(const std::string& seqOne, const std::string& seqTwo,
+						 const SubstitutionMatrix& subsMat,
+						 std::string& outOne, std::string& outTwo)
+	{
+		const ScoreT NEG_INF = std::numeric_limits<ScoreT>::min() / 2;
+		const ScoreT SAFE_MIN = std::numeric_limits<ScoreT>::min() / 8;
+		const uint8_t LEFT = 0;
+		const uint8_t UP = 1;
+		const uint8_t CROSS = 2;
+
+		const int lenOne = seqOne.length();
+		const int lenTwo = seqTwo.length();
+		const int radius = BAND_WIDTH + std::abs(lenOne - lenTwo);
+		const int diagLo = -std::min(radius, lenOne);
+		const int diagHi = std::min(radius, lenTwo);
+		const int width = diagHi - diagLo + 1;
+		const int packedWidth = (width + 3) / 4;
+
+		thread_local std::vector<ScoreT> prevRow;
+		thread_local std::vector<ScoreT> curRow;
+		thread_local std::vector<ScoreT> insProfile;
+		thread_local std::vector<ScoreT> matchProfiles[5];
+		thread_local std::vector<uint8_t> moves;
+		thread_local std::vector<uint8_t> traceback;
+
+		//the last cell is a sentinel for the vertical moves from
+		//outside of the band
+		prevRow.assign(width + 1, NEG_INF);
+		curRow.assign(width + 1, NEG_INF);
+		moves.assign(packedWidth * 4, LEFT);
+		traceback.resize((size_t)(lenOne + 1) * packedWidth);
+		std::fill(traceback.begin(), traceback.begin() + packedWidth, 0);
+
+		//scores of aligning each nucleotide (and other letters) to the
+		//letters of the second sequence. Profile position j + 1 
+		//corresponds to the letter j
+		insProfile.resize(lenTwo + 1);
+		for (int j = 0; j < lenTwo; ++j)
+		{
+			insProfile[j + 1] = subsMat.getScore('-', seqTwo[j]);
+		}
+		for (int n = 0; n < 4; ++n)
 		{
-			scoreMat.at(i + 1, 0) = scoreMat.at(i, 0) + 
-									subsMat.getScore(seqOne[i], '-');
-			backtrackMat.at(i + 1, 0) = 1;
+			matchProfiles[n].resize(lenTwo + 1);
+			for (int j = 0; j < lenTwo; ++j)
+			{
+				matchProfiles[n][j + 1] = subsMat.getScore(NUCLEOTIDES[n], 
+														   seqTwo[j]);
+			}
 		}
-		for (size_t i = 0; i < seqTwo.length(); ++i) 
+		matchProfiles[4].resize(lenTwo + 1);
+
+		ScoreT* prev = prevRow.data();
+		ScoreT* cur = curRow.data();
+		uint8_t* rowMoves = moves.data();
+		const ScoreT* insertion = insProfile.data();
+
+		//first row: only horizontal moves, which are encoded with zeros
+		const int firstHi = std::min(lenTwo, diagHi);
+		prev[-diagLo] = 0;
+		for (int j = 1; j <= firstHi; ++j)
 		{
-			scoreMat.at(0, i + 1) = scoreMat.at(0, i) + 
-									subsMat.getScore('-', seqTwo[i]);
-			backtrackMat.at(0, i + 1) = 0;
+			prev[j - diagLo] = prev[j - diagLo - 1] + insertion[j];
 		}
 
-		//filling DP matrices
-		for (size_t i = 1; i < seqOne.length() + 1; ++i)
+		for (int i = 1; i <= lenOne; ++i)
 		{
-			for (size_t j = 1; j < seqTwo.length() + 1; ++j) 
+			//cell (i, j) is stored at k = j - shift
+			const int shift = i + diagLo;
+			const int kLo = std::max(0, i + diagLo) - shift;
+			const int kHi = std::min(lenTwo, i + diagHi) - shift;
+			const int kDiag = std::max(kLo, 1 - shift);
+
+			const char letter = seqOne[i - 1];
+			const ScoreT deletion = subsMat.getScore(letter, '-');
+			int profileId = nucleotideIndex(letter);
+			if (profileId < 0)
 			{
-				AlnScoreType left = scoreMat.at(i, j - 1) + 
-							 		subsMat.getScore('-', seqTwo[j - 1]);
-				AlnScoreType up = scoreMat.at(i - 1, j) + 
-								  subsMat.getScore(seqOne[i - 1], '-');
-				AlnScoreType cross = scoreMat.at(i - 1, j - 1) + 
-							  		 subsMat.getScore(seqOne[i - 1], seqTwo[j - 1]);
-
-				int prev = 2;
-				AlnScoreType score = cross;
-				if (up > score)
+				profileId = 4;
+				for (int j = 0; j < lenTwo; ++j)
 				{
-					prev = 1;
-					score = up;
+					matchProfiles[4][j + 1] = subsMat.getScore(letter, seqTwo[j]);
 				}
+			}
+			const ScoreT* match = matchProfiles[profileId].data() + shift;
+
+			//diagonal and vertical moves are independent for
+			//all cells in the row (vectorized by the compiler)
+			for (int k = kDiag; k <= kHi; ++k)
+			{
+				ScoreT cross = prev[k] + match[k];
+				ScoreT up = prev[k + 1] + deletion;
+				cur[k] = std::max(cross, up);
+				rowMoves[k] = up > cross ? UP : CROSS;
+			}
+			if (kDiag > kLo)
+			{
+				cur[kLo] = prev[kLo + 1] + deletion;
+				rowMoves[kLo] = UP;
+			}
+
+			//horizontal moves
+			ScoreT score = cur[kLo];
+			ScoreT rowMin = score;
+			for (int k = kLo + 1; k <= kHi; ++k)
+			{
+				ScoreT left = score + insertion[k + shift];
+				score = cur[k];
 				if (left > score)
 				{
-					prev = 0;
 					score = left;
+					rowMoves[k] = LEFT;
 				}
-				scoreMat.at(i, j) = score;
-				backtrackMat.at(i, j) = prev;
+				cur[k] = score;
+				rowMin = std::min(rowMin, score);
 			}
-		}
+			if (rowMin < SAFE_MIN) return false;
 
-		//backtrack
-		int i = seqOne.length();
-		int j = seqTwo.length();
-		outOne.clear();
-		outTwo.clear();
+			//moves outside of the row bounds are never backtracked,
+			//so the whole row is packed
+			uint8_t* packed = &traceback[(size_t)i * packedWidth];
+			for (int b = 0; b < packedWidth; ++b)
+			{
+				packed[b] = rowMoves[4 * b] | rowMoves[4 * b + 1] << 2 |
+							rowMoves[4 * b + 2] << 4 | rowMoves[4 * b + 3] << 6;
+			}
+			std::swap(prev, cur);
+		}
 
+		//backtrack, filling the aligned strings from the end
+		outOne.assign(lenOne + lenTwo, '-');
+		outTwo.assign(lenOne + lenTwo, '-');
+		int i = lenOne;
+		int j = lenTwo;
+		size_t outPos = lenOne + lenTwo;
 		while (i != 0 || j != 0) 
 		{
-			if(backtrackMat.at(i, j) == 1) 
+			const int k = j - i - diagLo;
+			const uint8_t move = (traceback[(size_t)i * packedWidth + k / 4] >>
+								  (2 * (k % 4))) & 3;
+			--outPos;
+			if (move == UP)
 			{
-				outOne += seqOne[i - 1];
-				outTwo += '-';
+				outOne[outPos] = seqOne[i - 1];
 				i -= 1;
 			}
-			else if (backtrackMat.at(i, j) == 0) 
+			else if (move == LEFT)
 			{
-				outOne += '-';
-				outTwo += seqTwo[j - 1];
+				outTwo[outPos] = seqTwo[j - 1];
 				j -= 1;
 			}
 			else
 			{
-				outOne += seqOne[i - 1];
-				outTwo += seqTwo[j - 1];
+				outOne[outPos] = seqOne[i - 1];
+				outTwo[outPos] = seqTwo[j - 1];
 				i -= 1;
 				j -= 1;
 			}
 		}
-		std::reverse(outOne.begin(), outOne.end());
-		std::reverse(outTwo.begin(), outTwo.end());
+		outOne.erase(0, outPos);
+		outTwo.erase(0, outPos);
 		outOne += "$";
 		outTwo += "$";
+		return true;
 	}
 
 	//Splits aligned strings into homopolymer runs (wrt to candAln)
-	std::vector<std::pair<HopoMatrix::State, HopoMatrix::Observation>>
-	splitBranchHopos(const std::string& candAln, const std::string& branchAln)
+	typedef std::vector<std::pair<HopoMatrix::State,
+								  HopoMatrix::Observation>> HopoRuns;
+	void splitBranchHopos(const std::string& candAln, const std::string& branchAln,
+						  HopoRuns& result)
 	{
 		//std::cerr << candAln << std::endl << branchAln << std::endl << std::endl;
-		std::vector<std::pair<HopoMatrix::State, 
-							  HopoMatrix::Observation>> result;
+		result.clear();
 		size_t prevPos = 0;
 		while (candAln[prevPos] == '-') ++prevPos;
 		char prevNucl = candAln[prevPos];
@@ -163,8 +269,23 @@ namespace
 				}
 			}
 		}
+	}
 
-		return result;
+	//Aligns the branch to the candidate and splits the alignment
+	//into homopolymer runs of the candidate with the corresponding
+	//branch observations
+	void alignBranchHopos(const std::string& candidate, const std::string& branch,
+						  const SubstitutionMatrix& subsMat, HopoRuns& result)
+	{
+		thread_local std::string alnCand;
+		thread_local std::string alnBranch;
+		if (!bandedAlignment<int32_t>(candidate, branch, subsMat,
+									  alnCand, alnBranch))
+		{
+			bandedAlignment<AlnScoreType>(candidate, branch, subsMat,
+										  alnCand, alnBranch);
+		}
+		splitBranchHopos(alnCand, alnBranch, result);
 	}
 }
 
@@ -179,14 +300,10 @@ void HomoPolisher::polishBubble(Bubble& bubble) const
 	std::vector<HopoMatrix::State> states;
 	std::vector<HopoMatrix::ObsVector> observations;
 
+	HopoRuns splitHopo;
 	for (auto& branch : bubble.branches)
 	{
-		std::string alnCand;
-		std::string alnBranch;
-		pairwiseAlignment(bubble.candidate, branch, _subsMatrix,
-						  alnCand, alnBranch);
-
-		auto splitHopo = splitBranchHopos(alnCand, alnBranch);
+		alignBranchHopos(bubble.candidate, branch, _subsMatrix, splitHopo);
 		if (states.empty())
 		{
 			states.assign(splitHopo.size(), HopoMatrix::State());
@@ -11,17 +11,29 @@
 
 
 bool parseArgs(int argc, char** argv, std::string& bubblesFile, 
+			   std::string& bamFile, std::string& contigsFile,
+			   std::string& statsFile, BubbleGeneratorParameters& bubbleParams,
 			   std::string& scoringMatrix, std::string& hopoMatrix,
 			   std::string& outConsensus, std::string& outVerbose,
-			   int& numThreads, bool& quiet, bool& enableHopo)
+			   int& numThreads, bool& quiet, bool& enableHopo,
+			   bool& benchmark)
 {
 	auto printUsage = [argv]()
 	{
 		std::cerr << "Usage: flye-polish "
-				  << " --bubbles path --subs-mat path --hopo-mat size --out path\n"
-				  << "\t\t[--treads num] [--enable-hopo] [--quiet] [--debug] [-h]\n\n"
+				  << " (--bubbles path | --bam path --contigs path)"
+				  << " --subs-mat path --hopo-mat size --out path\n"
+				  << "\t\t[--treads num] [--enable-hopo] [--quiet] [--debug] [-h]\n"
+				  << "\t\t[--benchmark]\n"
+				  << "\t\t[--stats path] [--solid-missmatch rate] [--solid-indel rate]\n"
+				  << "\t\t[--solid-kmer-len len] [--simple-kmer-len len]\n"
+				  << "\t\t[--max-bubble-len len] [--max-bubble-branches num]\n"
+				  << "\t\t[--max-read-coverage cov] [--min-aln-len len] [--chunk-size len]\n\n"
 				  << "Required arguments:\n"
 				  << "  --bubbles path\tpath to bubbles file\n"
+				  << "  --bam path\tpath to sorted and indexed read alignment "
+				  << "(bubbles are generated instead of being read)\n"
+				  << "  --contigs path\tpath to contigs that reads are aligned to\n"
 				  << "  --subs-mat path\tpath to substitution matrix\n"
 				  << "  --hopo-mat size\tpath to homopolymer matrix\n"
 				  << "  --out path\tpath to output file\n\n"
@@ -33,13 +45,48 @@ bool parseArgs(int argc, char** argv, std::string& bubblesFile,
 				  << "  --debug \t\textra debug output "
 				  << "[default = false] \n"
 				  << "  --threads num_threads\tnumber of parallel threads "
-				  << "[default = 1] \n";
+				  << "[default = 1] \n"
+				  << "  --stats path\tcoverage statistics output "
+				  << "(with --bam only)\n"
+				  << "  --solid-missmatch rate\tmaximum mismatch rate of solid k-mers "
+				  << "[default = 0.3] \n"
+				  << "  --solid-indel rate\tmaximum indel rate of solid k-mers "
+				  << "[default = 0.3] \n"
+				  << "  --solid-kmer-len len\tlength of solid k-mers "
+				  << "[default = 10] \n"
+				  << "  --simple-kmer-len len\tlength of simple k-mers "
+				  << "[default = 4] \n"
+				  << "  --max-bubble-len len\tmaximum bubble length "
+				  << "[default = 500] \n"
+				  << "  --max-bubble-branches num\tmaximum number of bubble branches "
+				  << "[default = 50] \n"
+				  << "  --max-read-coverage cov\tmaximum read coverage "
+				  << "[default = 1000] \n"
+				  << "  --min-aln-len len\tminimum read alignment length "
+				  << "[default = 500] \n"
+				  << "  --chunk-size len\tcontig chunk size for bubble generation "
+				  << "[default = 1000000] \n"
+				  << "  --benchmark \t\tmeasure polishing throughput with up to "
+				  << "num_threads threads\n\t\t\tand report it to stdout instead "
+				  << "of writing the consensus (--out is not required)\n";
 	};
 	
 	int optionIndex = 0;
 	static option longOptions[] =
 	{
 		{"bubbles", required_argument, 0, 0},
+		{"bam", required_argument, 0, 0},
+		{"contigs", required_argument, 0, 0},
+		{"stats", required_argument, 0, 0},
+		{"solid-missmatch", required_argument, 0, 0},
+		{"solid-indel", required_argument, 0, 0},
+		{"solid-kmer-len", required_argument, 0, 0},
+		{"simple-kmer-len", required_argument, 0, 0},
+		{"max-bubble-len", required_argument, 0, 0},
+		{"max-bubble-branches", required_argument, 0, 0},
+		{"max-read-coverage", required_argument, 0, 0},
+		{"min-aln-len", required_argument, 0, 0},
+		{"chunk-size", required_argument, 0, 0},
 		{"subs-mat", required_argument, 0, 0},
 		{"hopo-mat", required_argument, 0, 0},
 		{"out", required_argument, 0, 0},
@@ -47,6 +94,7 @@ bool parseArgs(int argc, char** argv, std::string& bubblesFile,
 		{"debug", no_argument, 0, 0},
 		{"quiet", no_argument, 0, 0},
 		{"enable-hopo", no_argument, 0, 0},
+		{"benchmark", no_argument, 0, 0},
 		{0, 0, 0, 0}
 	};
 
@@ -62,10 +110,36 @@ bool parseArgs(int argc, char** argv, std::string& bubblesFile,
 				outVerbose = true;
 			else if (!strcmp(longOptions[optionIndex].name, "enable-hopo"))
 				enableHopo = true;
+			else if (!strcmp(longOptions[optionIndex].name, "benchmark"))
+				benchmark = true;
 			else if (!strcmp(longOptions[optionIndex].name, "quiet"))
 				quiet = true;
 			else if (!strcmp(longOptions[optionIndex].name, "bubbles"))
 				bubblesFile = optarg;
+			else if (!strcmp(longOptions[optionIndex].name, "bam"))
+				bamFile = optarg;
+			else if (!strcmp(longOptions[optionIndex].name, "contigs"))
+				contigsFile = optarg;
+			else if (!strcmp(longOptions[optionIndex].name, "stats"))
+				statsFile = optarg;
+			else if (!strcmp(longOptions[optionIndex].name, "solid-missmatch"))
+				bubbleParams.solidMissmatch = atof(optarg);
+			else if (!strcmp(longOptions[optionIndex].name, "solid-indel"))
+				bubbleParams.solidIndel = atof(optarg);
+			else if (!strcmp(longOptions[optionIndex].name, "solid-kmer-len"))
+				bubbleParams.solidKmerLength = atoi(optarg);
+			else if (!strcmp(longOptions[optionIndex].name, "simple-kmer-len"))
+				bubbleParams.simpleKmerLength = atoi(optarg);
+			else if (!strcmp(longOptions[optionIndex].name, "max-bubble-len"))
+				bubbleParams.maxBubbleLength = atoi(optarg);
+			else if (!strcmp(longOptions[optionIndex].name, "max-bubble-branches"))
+				bubbleParams.maxBubbleBranches = atoi(optarg);
+			else if (!strcmp(longOptions[optionIndex].name, "max-read-coverage"))
+				bubbleParams.maxReadCoverage = atoi(optarg);
+			else if (!strcmp(longOptions[optionIndex].name, "min-aln-len"))
+				bubbleParams.minPolishAlnLength = atoi(optarg);
+			else if (!strcmp(longOptions[optionIndex].name, "chunk-size"))
+				bubbleParams.chunkSize = atoi(optarg);
 			else if (!strcmp(longOptions[optionIndex].name, "subs-mat"))
 				scoringMatrix = optarg;
 			else if (!strcmp(longOptions[optionIndex].name, "hopo-mat"))
@@ -79,8 +153,10 @@ bool parseArgs(int argc, char** argv, std::string& bubblesFile,
 			exit(0);
 		}
 	}
-	if (bubblesFile.empty() || scoringMatrix.empty() || 
-		hopoMatrix.empty() || outConsensus.empty())
+	bool bubblesInput = !bubblesFile.empty();
+	bool alignmentInput = !bamFile.empty() && !contigsFile.empty();
+	if (bubblesInput == alignmentInput || scoringMatrix.empty() || 
+		hopoMatrix.empty() || (outConsensus.empty() && !benchmark))
 	{
 		printUsage();
 		return false;
@@ -92,6 +168,10 @@ bool parseArgs(int argc, char** argv, std::string& bubblesFile,
 int polisher_main(int argc, char* argv[]) 
 {
 	std::string bubblesFile;
+	std::string bamFile;
+	std::string contigsFile;
+	std::string statsFile;
+	BubbleGeneratorParameters bubbleParams;
 	std::string scoringMatrix;
 	std::string hopoMatrix;
 	std::string outConsensus;
@@ -99,16 +179,39 @@ int polisher_main(int argc, char* argv[])
 	int  numThreads = 1;
 	bool quiet = false;
 	bool enableHopo = false;
+	bool benchmark = false;
 
-	if (!parseArgs(argc, argv, bubblesFile, scoringMatrix, 
+	if (!parseArgs(argc, argv, bubblesFile, bamFile, contigsFile,
+				   statsFile, bubbleParams, scoringMatrix, 
 				   hopoMatrix, outConsensus, outVerbose, numThreads,
-				   quiet, enableHopo))
+				   quiet, enableHopo, benchmark))
 		return 1;
 
 	BubbleProcessor bp(scoringMatrix, hopoMatrix, !quiet, enableHopo);
 	if (!outVerbose.empty())
 		bp.enableVerboseOutput(outVerbose);
-	bp.polishAll(bubblesFile, outConsensus, numThreads); 
+	if (benchmark)
+	{
+		if (!bamFile.empty())
+		{
+			BubbleGenerator generator(bamFile, contigsFile, bubbleParams);
+			bp.benchmark(generator, numThreads, std::cout);
+		}
+		else
+		{
+			bp.benchmark(bubblesFile, numThreads, std::cout);
+		}
+	}
+	else if (!bamFile.empty())
+	{
+		BubbleGenerator generator(bamFile, contigsFile, bubbleParams);
+		bp.polishAll(generator, outConsensus, numThreads);
+		if (!statsFile.empty()) generator.writeStats(statsFile);
+	}
+	else
+	{
+		bp.polishAll(bubblesFile, outConsensus, numThreads); 
+	}
 
 	return 0;
 }
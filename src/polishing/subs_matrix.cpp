@@ -7,6 +7,7 @@
 #include <cmath>
 #include <stdexcept>
 #include <cassert>
+#include <algorithm>
 
 #include "subs_matrix.h"
 #include "utility.h"
@@ -45,21 +46,32 @@ namespace
 	static const size_t MIN_HOPO = 1;
 	static const size_t MAX_HOPO = 20;
 	static const size_t NUM_HOPO_STATES = 128;
-	static const size_t NUM_HOPO_OBS = 65536;
+	static const size_t NUM_HOPO_OBS = HopoMatrix::NUM_OBSERVATIONS;
+	static_assert((MAX_HOPO << 4) + MAX_HOPO < NUM_HOPO_OBS,
+				  "Observation ids do not fit");
 	static const double MIN_HOPO_PROB = 0.001f;
 	static const double ZERO_HOPO_PROB = 0.0000000001f;
 
-	static const int32_t SCORE_MULT = 2 << 16;
 	AlnScoreType probToScore(double prob)
 	{
-		//std::cout << prob << " " << (int32_t)std::round(std::log(prob) * (double)SCORE_MULT) << "\n";
-		return std::round(std::log(prob) * (double)SCORE_MULT);
+		return std::round(std::log(prob) * 
+						  (double)SubstitutionMatrix::SCORE_MULT);
 	}
 }
 
+const int32_t SubstitutionMatrix::SCORE_MULT;
+const size_t SubstitutionMatrix::NUM_CODES;
+const size_t HopoMatrix::NUM_OBSERVATIONS;
+
 SubstitutionMatrix::SubstitutionMatrix(const std::string& path)
 {	
-	_matrix.assign(MAX_CHAR * MAX_CHAR, AlnScoreType(0));
+	std::fill(_charCodes, _charCodes + 256, NUM_CODES - 1);
+	_charCodes[(uint8_t)'A'] = 0;
+	_charCodes[(uint8_t)'C'] = 1;
+	_charCodes[(uint8_t)'G'] = 2;
+	_charCodes[(uint8_t)'T'] = 3;
+	_charCodes[(uint8_t)'-'] = 4;
+	std::fill(_matrix, _matrix + NUM_CODES * NUM_CODES, 0);
 	this->loadMatrix(path);
 }
 
@@ -221,27 +233,24 @@ HopoMatrix::HopoMatrix(const std::string& fileName, bool hopoEnabled = true)
 	{
 		return;
 	}
-	for (size_t i = 0; i < NUM_HOPO_STATES; ++i)
-	{
-		_observationProbs.emplace_back(NUM_HOPO_OBS, probToScore(MIN_HOPO_PROB));
-	}
+	_observationProbs.assign(NUM_HOPO_STATES * NUM_HOPO_OBS, 
+							 probToScore(MIN_HOPO_PROB));
 	_genomeProbs.assign(NUM_HOPO_STATES, probToScore(MIN_HOPO_PROB));
 	this->loadMatrix(fileName);
-}
-
 
-//returns all observations from the training set for a given state
-HopoMatrix::ObsVector HopoMatrix::knownObservations(State state) const
-{
-	ObsVector obsVector;
-	for (uint32_t obsId = 0; obsId < NUM_HOPO_OBS; ++obsId)
+	//all observations from the training set for each state
+	_knownObservations.assign(NUM_HOPO_STATES, ObsVector());
+	for (size_t stateId = 0; stateId < NUM_HOPO_STATES; ++stateId)
 	{
-		if (_observationProbs[state.id][obsId] > probToScore(MIN_HOPO_PROB))
+		for (uint32_t obsId = 0; obsId < NUM_HOPO_OBS; ++obsId)
 		{
-			obsVector.emplace_back(obsId);
+			if (_observationProbs[stateId * NUM_HOPO_OBS + obsId] > 
+				probToScore(MIN_HOPO_PROB))
+			{
+				_knownObservations[stateId].emplace_back(obsId);
+			}
 		}
 	}
-	return obsVector;
 }
 
 //loads homopolymer matrix from .mat file
@@ -255,11 +264,7 @@ void HopoMatrix::loadMatrix(const std::string& fileName)
 	}
 
 	std::vector<size_t> nucleotideFreq(5, 0);
-	std::vector<std::vector<size_t>> observationsFreq;
-	for (size_t i = 0; i < NUM_HOPO_STATES; ++i)
-	{
-		observationsFreq.push_back(std::vector<size_t>(NUM_HOPO_OBS, 0));
-	}
+	std::vector<size_t> observationsFreq(NUM_HOPO_STATES * NUM_HOPO_OBS, 0);
 	
 	while (std::getline(fin, buffer))
 	{
@@ -273,7 +278,8 @@ void HopoMatrix::loadMatrix(const std::string& fileName)
 		{
 			auto obsTokens = splitString(tokens[i], '=');
 			Observation obs = strToObs(state.nucl, expandHopo(obsTokens[0]));
-			observationsFreq[state.id][obs.id] += std::stoull(obsTokens[1]);
+			observationsFreq[state.id * NUM_HOPO_OBS + obs.id] += 
+				std::stoull(obsTokens[1]);
 			nucleotideFreq[dnaToId(state.nucl)] += std::stoull(obsTokens[1]);
 		}
 	}
@@ -287,7 +293,7 @@ void HopoMatrix::loadMatrix(const std::string& fileName)
 			size_t sumFreq = 0;
 			for (size_t j = 0; j < NUM_HOPO_OBS; ++j)
 			{
-				sumFreq += observationsFreq[state.id][j];
+				sumFreq += observationsFreq[state.id * NUM_HOPO_OBS + j];
 			}
 			double prob = (double)sumFreq / nucleotideFreq[dnaToId(state.nucl)];
 			_genomeProbs[state.id] = probToScore(std::max(prob, ZERO_HOPO_PROB));
@@ -298,8 +304,9 @@ void HopoMatrix::loadMatrix(const std::string& fileName)
 			if (sumFreq == 0) continue;
 			for (size_t j = 0; j < NUM_HOPO_OBS; ++j)
 			{
-				double prob = (double)observationsFreq[state.id][j] / sumFreq;
-				_observationProbs[state.id][j] = 
+				double prob = (double)observationsFreq[state.id * NUM_HOPO_OBS + j] / 
+							  sumFreq;
+				_observationProbs[state.id * NUM_HOPO_OBS + j] = 
 									probToScore(std::max(prob, MIN_HOPO_PROB));
 			}
 		}
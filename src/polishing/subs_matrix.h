@@ -14,24 +14,35 @@
 
 typedef int64_t AlnScoreType;
 
+//Letters are encoded as A, C, G, T, gap and "other" (scores 
+//of the other letters are zero), so the matrix is a small 
+//table that stays in cache
 class SubstitutionMatrix 
 {
 public:
 	SubstitutionMatrix(const std::string& path);
+
+	//scores (also in HopoMatrix) are natural logarithms of
+	//probabilities, multiplied by this factor
+	static const int32_t SCORE_MULT = 2 << 16;
+
 	AlnScoreType getScore(char v, char w) const
 	{
-		return _matrix[(size_t)v * MAX_CHAR + (size_t)w];
+		return _matrix[_charCodes[(uint8_t)v] * NUM_CODES + 
+					   _charCodes[(uint8_t)w]];
 	}
 	
 private:
 	void loadMatrix(const std::string& path);
 	void setScore(char v, char w, AlnScoreType score)
 	{
-		_matrix[(size_t)v * MAX_CHAR + (size_t)w] = score;
+		_matrix[_charCodes[(uint8_t)v] * NUM_CODES + 
+				_charCodes[(uint8_t)w]] = score;
 	}
 
-	const size_t MAX_CHAR = std::numeric_limits<char>::max();
-	std::vector<AlnScoreType> _matrix;
+	static const size_t NUM_CODES = 6;
+	uint8_t _charCodes[256];
+	int32_t _matrix[NUM_CODES * NUM_CODES];
 };
 
 class HopoMatrix
@@ -70,18 +81,24 @@ public:
 
 	HopoMatrix(const std::string& fileName, bool hopoEnabled);
 	AlnScoreType getObsProb(State state, Observation observ) const
-		{return _observationProbs[state.id][observ.id];}
+		{return _observationProbs[state.id * NUM_OBSERVATIONS + observ.id];}
 	AlnScoreType getGenomeProb(State state) const
 		{return _genomeProbs[state.id];}
-	ObsVector knownObservations(State state) const;
+	const ObsVector& knownObservations(State state) const
+		{return _knownObservations[state.id];}
 	static Observation strToObs(char mainNucl, const std::string& dnaStr, 
 								size_t start = 0, 
 								size_t end = std::string::npos);
 
 	//static std::string obsToStr(Observation obs);
+	//observation ids are below this value (see strToObs)
+	static const size_t NUM_OBSERVATIONS = (20 << 4) + 20 + 1;
+
 private:
 	void loadMatrix(const std::string& filaName);
 
-	std::vector<std::vector<AlnScoreType>> _observationProbs;
-	std::vector<AlnScoreType> 			   _genomeProbs;
+	//state-major, NUM_OBSERVATIONS per state
+	std::vector<int32_t> 	_observationProbs;
+	std::vector<int32_t> 	_genomeProbs;
+	std::vector<ObsVector> 	_knownObservations;
 };
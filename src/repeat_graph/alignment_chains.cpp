@@ -0,0 +1,69 @@
+//(c) 2020 by Authors
+//This file is a part of Flye program.
+//Released under the BSD license (see LICENSE file)
+
+#include "alignment_chains.h"
+
+EdgeAlignment AlignmentChains::Chain::operator[](size_t index) const
+{
+	const auto& aln = _chains->_alignments[this->alignmentIndex(index)];
+	OverlapRange ovlp(aln.curId, aln.extId, aln.curBegin, aln.extBegin,
+					  aln.curLen, aln.extLen);
+	ovlp.curEnd = aln.curEnd;
+	ovlp.extEnd = aln.extEnd;
+	ovlp.score = aln.score;
+	ovlp.seqDivergence = aln.seqDivergence;
+
+	if (!_range.complement) return {ovlp, aln.edge};
+	return {ovlp.complement(), aln.complEdge};
+}
+
+void AlignmentChains::addChain(const GraphAlignment& chain,
+							   const RepeatGraph& graph)
+{
+	_chains.emplace_back(_alignments.size(), chain.size(), false);
+	for (const auto& aln : chain)
+	{
+		CompactAlignment compact;
+		compact.edge = aln.edge;
+		compact.complEdge = graph.complementEdge(aln.edge);
+		compact.curId = aln.overlap.curId;
+		compact.extId = aln.overlap.extId;
+		compact.curBegin = aln.overlap.curBegin;
+		compact.curEnd = aln.overlap.curEnd;
+		compact.curLen = aln.overlap.curLen;
+		compact.extBegin = aln.overlap.extBegin;
+		compact.extEnd = aln.overlap.extEnd;
+		compact.extLen = aln.overlap.extLen;
+		compact.score = aln.overlap.score;
+		compact.seqDivergence = aln.overlap.seqDivergence;
+		_alignments.push_back(compact);
+	}
+}
+
+void AlignmentChains::addComplementChain(size_t chainIndex)
+{
+	ChainRange range = _chains[chainIndex];
+	range.complement = !range.complement;
+	_chains.push_back(range);
+}
+
+void AlignmentChains::addSubChain(size_t chainIndex, size_t start, size_t end)
+{
+	ChainRange range = _chains[chainIndex];
+	size_t newBegin = !range.complement ? range.begin + start :
+										  range.begin + range.length - end;
+	_chains.emplace_back(newBegin, end - start, range.complement);
+}
+
+void AlignmentChains::append(const AlignmentChains& other)
+{
+	size_t shift = _alignments.size();
+	_alignments.insert(_alignments.end(), other._alignments.begin(),
+					   other._alignments.end());
+	for (auto range : other._chains)
+	{
+		range.begin += shift;
+		_chains.push_back(range);
+	}
+}
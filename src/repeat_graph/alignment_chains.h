@@ -0,0 +1,187 @@
+//(c) 2020 by Authors
+//This file is a part of Flye program.
+//Released under the BSD license (see LICENSE file)
+
+//Storage of the read-to-graph alignment chains. Alignments of all
+//chains are kept in a single array in a compact form, and each chain
+//is a range of this array. Complement chains, as well as the chains
+//that are split after the graph modifications, reference the same
+//alignments. Complement alignments are computed on access.
+
+#pragma once
+
+#include <vector>
+#include <iterator>
+
+#include "repeat_graph.h"
+
+struct EdgeAlignment
+{
+	OverlapRange overlap;
+	GraphEdge* edge;
+	//EdgeSequence segment;
+};
+typedef std::vector<EdgeAlignment> GraphAlignment;
+
+class AlignmentChains
+{
+private:
+	struct CompactAlignment
+	{
+		GraphEdge* edge;
+		GraphEdge* complEdge;
+		FastaRecord::Id curId;
+		FastaRecord::Id extId;
+		int32_t curBegin;
+		int32_t curEnd;
+		int32_t curLen;
+		int32_t extBegin;
+		int32_t extEnd;
+		int32_t extLen;
+		int32_t score;
+		float   seqDivergence;
+	};
+
+	struct ChainRange
+	{
+		ChainRange(size_t begin = 0, uint32_t length = 0,
+				   bool complement = false):
+			begin(begin), length(length), complement(complement) {}
+
+		size_t 	 begin;
+		uint32_t length;
+		bool 	 complement;
+	};
+
+public:
+	//Read-only view of a single chain. Alignments are returned
+	//by value (or by a reference to the iterator's copy)
+	class Chain
+	{
+	public:
+		class Iterator
+		{
+		public:
+			typedef std::input_iterator_tag iterator_category;
+			typedef EdgeAlignment value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef const EdgeAlignment* pointer;
+			typedef const EdgeAlignment& reference;
+
+			Iterator(const AlignmentChains* chains, ChainRange range, 
+					 size_t index):
+				_chains(chains), _range(range), _index(index) {}
+
+			reference operator*() const
+			{
+				_current = Chain(_chains, _range)[_index];
+				return _current;
+			}
+			pointer operator->() const {return &**this;}
+
+			Iterator& operator++() {++_index; return *this;}
+			Iterator operator+(difference_type shift) const
+				{return Iterator(_chains, _range, _index + shift);}
+			difference_type operator-(const Iterator& other) const
+				{return _index - other._index;}
+
+			bool operator==(const Iterator& other) const
+				{return _index == other._index;}
+			bool operator!=(const Iterator& other) const
+				{return _index != other._index;}
+
+		private:
+			const AlignmentChains* _chains;
+			ChainRange _range;
+			size_t _index;
+			mutable EdgeAlignment _current;
+		};
+
+		Chain(): _chains(nullptr) {}
+
+		size_t size() const {return _range.length;}
+		bool   empty() const {return _range.length == 0;}
+
+		EdgeAlignment operator[](size_t index) const;
+		EdgeAlignment front() const {return (*this)[0];}
+		EdgeAlignment back() const {return (*this)[_range.length - 1];}
+
+		//faster than operator[], if only the edge is needed
+		GraphEdge* edgeAt(size_t index) const
+		{
+			const auto& aln = _chains->_alignments[this->alignmentIndex(index)];
+			return !_range.complement ? aln.edge : aln.complEdge;
+		}
+
+		Iterator begin() const {return Iterator(_chains, _range, 0);}
+		Iterator end() const {return Iterator(_chains, _range, _range.length);}
+
+	private:
+		friend class AlignmentChains;
+		Chain(const AlignmentChains* chains, ChainRange range):
+			_chains(chains), _range(range) {}
+
+		size_t alignmentIndex(size_t index) const
+		{
+			return !_range.complement ? _range.begin + index :
+										_range.begin + _range.length - index - 1;
+		}
+
+		const AlignmentChains* _chains;
+		ChainRange _range;
+	};
+
+	class ChainIterator
+	{
+	public:
+		typedef std::input_iterator_tag iterator_category;
+		typedef Chain value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const Chain* pointer;
+		typedef const Chain& reference;
+
+		ChainIterator(const AlignmentChains* chains, size_t index):
+			_chains(chains), _index(index) {}
+
+		reference operator*() const
+		{
+			_current = (*_chains)[_index];
+			return _current;
+		}
+		pointer operator->() const {return &**this;}
+
+		ChainIterator& operator++() {++_index; return *this;}
+		bool operator==(const ChainIterator& other) const
+			{return _index == other._index;}
+		bool operator!=(const ChainIterator& other) const
+			{return _index != other._index;}
+
+	private:
+		const AlignmentChains* _chains;
+		size_t _index;
+		mutable Chain _current;
+	};
+
+	size_t size() const {return _chains.size();}
+	Chain operator[](size_t index) const {return Chain(this, _chains[index]);}
+	ChainIterator begin() const {return ChainIterator(this, 0);}
+	ChainIterator end() const {return ChainIterator(this, _chains.size());}
+
+	//stores alignments of a new chain
+	void addChain(const GraphAlignment& chain, const RepeatGraph& graph);
+	//adds complement of the existing chain, without copying alignments
+	void addComplementChain(size_t chainIndex);
+	//adds a part [start, end) of the existing chain
+	void addSubChain(size_t chainIndex, size_t start, size_t end);
+
+	//appends all chains of the other container
+	void append(const AlignmentChains& other);
+
+	void moveChain(size_t from, size_t to) {_chains[to] = _chains[from];}
+	void resize(size_t numChains) {_chains.resize(numChains);}
+	void reserve(size_t numChains) {_chains.reserve(numChains);}
+
+private:
+	std::vector<CompactAlignment> _alignments;
+	std::vector<ChainRange> 	  _chains;
+};
@@ -0,0 +1,280 @@
+//(c) 2020 by Authors
+//This file is a part of Flye program.
+//Released under the BSD license (see LICENSE file)
+
+#include <fstream>
+#include <cstring>
+
+#include "dump_io.h"
+#include "../common/config.h"
+#include "../common/parallel.h"
+
+namespace
+{
+	const size_t MAGIC_LEN = 8;
+}
+
+BinaryDumpWriter::BinaryDumpWriter(const std::string& filename,
+								   const char* magic):
+	_filename(filename)
+{
+	_fd = gzopen(filename.c_str(), "wb1");
+	if (!_fd)
+	{
+		throw std::runtime_error("Can't open " + filename);
+	}
+	this->writeBytes(magic, MAGIC_LEN);
+	this->write<uint32_t>(DumpFormat::VERSION);
+}
+
+BinaryDumpWriter::~BinaryDumpWriter()
+{
+	if (_fd) gzclose(_fd);
+}
+
+//flushes the remaining compressed data, should be called
+//explicitly to detect write errors (destructor ignores them)
+void BinaryDumpWriter::close()
+{
+	if (!_fd) return;
+	int result = gzclose(_fd);
+	_fd = nullptr;
+	if (result != Z_OK)
+	{
+		throw std::runtime_error("Error writing " + _filename);
+	}
+}
+
+void BinaryDumpWriter::writeBytes(const void* data, size_t size)
+{
+	if (size == 0) return;
+	if (gzwrite(_fd, data, size) != (int)size)
+	{
+		throw std::runtime_error("Error writing " + _filename);
+	}
+}
+
+void BinaryDumpWriter::writeString(const std::string& str)
+{
+	this->write<uint32_t>(str.size());
+	this->writeBytes(str.data(), str.size());
+}
+
+BinaryDumpReader::BinaryDumpReader(const std::string& filename,
+								   const char* magic):
+	_filename(filename)
+{
+	_fd = gzopen(filename.c_str(), "rb");
+	if (!_fd)
+	{
+		throw std::runtime_error("Can't open " + filename);
+	}
+	gzbuffer(_fd, 1024 * 1024);
+
+	char fileMagic[MAGIC_LEN];
+	this->readBytes(fileMagic, MAGIC_LEN);
+	if (strncmp(fileMagic, magic, MAGIC_LEN) != 0)
+	{
+		gzclose(_fd);
+		throw std::runtime_error("Unexpected dump format: " + filename);
+	}
+	uint32_t version = this->read<uint32_t>();
+	if (version != DumpFormat::VERSION)
+	{
+		gzclose(_fd);
+		throw std::runtime_error("Unsupported dump version " +
+								 std::to_string(version) + ": " + filename);
+	}
+}
+
+BinaryDumpReader::~BinaryDumpReader()
+{
+	gzclose(_fd);
+}
+
+bool BinaryDumpReader::isBinaryDump(const std::string& filename,
+									const char* magic)
+{
+	auto fd = gzopen(filename.c_str(), "rb");
+	if (!fd) return false;
+
+	char fileMagic[MAGIC_LEN];
+	bool matches = gzread(fd, fileMagic, MAGIC_LEN) == (int)MAGIC_LEN &&
+				   strncmp(fileMagic, magic, MAGIC_LEN) == 0;
+	gzclose(fd);
+	return matches;
+}
+
+void BinaryDumpReader::readBytes(void* data, size_t size)
+{
+	if (size == 0) return;
+	if (gzread(_fd, data, size) != (int)size)
+	{
+		throw std::runtime_error("Error parsing: " + _filename);
+	}
+}
+
+std::string BinaryDumpReader::readString()
+{
+	uint32_t size = this->read<uint32_t>();
+	std::string str(size, '\0');
+	this->readBytes(&str[0], size);
+	return str;
+}
+
+uint32_t SeqNameTable::addId(FastaRecord::Id seqId)
+{
+	auto it = _idToIndex.find(seqId);
+	if (it != _idToIndex.end()) return it->second;
+
+	uint32_t index = _ids.size();
+	_idToIndex[seqId] = index;
+	_ids.push_back(seqId);
+	return index;
+}
+
+void SeqNameTable::write(BinaryDumpWriter& writer,
+						 const SequenceContainer& seqs) const
+{
+	writer.write<uint32_t>(_ids.size());
+	for (auto seqId : _ids) writer.writeString(seqs.seqName(seqId));
+}
+
+void SeqNameTable::readNames(BinaryDumpReader& reader)
+{
+	uint32_t numNames = reader.read<uint32_t>();
+	_names.clear();
+	_names.reserve(numNames);
+	for (uint32_t i = 0; i < numNames; ++i)
+	{
+		_names.push_back(reader.readString());
+	}
+}
+
+void SeqNameTable::read(BinaryDumpReader& reader,
+						const SequenceContainer& seqs)
+{
+	this->readNames(reader);
+
+	_ids.assign(_names.size(), FastaRecord::ID_NONE);
+	std::vector<uint32_t> allIndices(_names.size());
+	for (uint32_t i = 0; i < allIndices.size(); ++i) allIndices[i] = i;
+	std::function<void(const uint32_t&)> resolveFunc =
+	[this, &seqs] (const uint32_t& index)
+	{
+		_ids[index] = seqs.recordByName(_names[index]).id;
+	};
+	processInParallel(allIndices, resolveFunc,
+					  Parameters::get().numThreads, false);
+}
+
+void storeReadMetadata(const std::string& filename,
+					   const SequenceContainer& readSeqs,
+					   const std::vector<FastaRecord::Id>& readIds)
+{
+	BinaryDumpWriter writer(filename, DumpFormat::READ_METADATA_MAGIC);
+	writer.write<uint64_t>(readIds.size());
+	for (auto readId : readIds)
+	{
+		//names are stored without the strand prefix
+		writer.writeString(readSeqs.seqName(readId).substr(1));
+		writer.write<int32_t>(readSeqs.seqLen(readId));
+	}
+	writer.close();
+}
+
+void loadReadMetadata(const std::string& filename, SequenceContainer& readSeqs)
+{
+	BinaryDumpReader reader(filename, DumpFormat::READ_METADATA_MAGIC);
+	uint64_t numReads = reader.read<uint64_t>();
+	for (uint64_t i = 0; i < numReads; ++i)
+	{
+		std::string name = reader.readString();
+		int32_t length = reader.read<int32_t>();
+		readSeqs.addMetadata(name, length);
+	}
+}
+
+namespace
+{
+	void convertGraph(const std::string& inFile, std::ofstream& fout)
+	{
+		BinaryDumpReader reader(inFile, DumpFormat::GRAPH_MAGIC);
+		SeqNameTable edgeSeqNames;
+		edgeSeqNames.readNames(reader);
+
+		uint64_t numEdges = reader.read<uint64_t>();
+		for (uint64_t i = 0; i < numEdges; ++i)
+		{
+			auto edgeRec = reader.read<EdgeRecord>();
+			fout << "Edge\t" << edgeRec.edgeId << "\t"
+				<< edgeRec.leftNode << "\t" << edgeRec.rightNode
+				<< "\t" << (bool)edgeRec.repetitive << "\t"
+				<< (bool)edgeRec.selfComplement << "\t"
+				<< (bool)edgeRec.resolved << "\t" << edgeRec.meanCoverage
+				<< "\t" << edgeRec.altGroupId << "\n";
+
+			for (uint32_t j = 0; j < edgeRec.numSegments; ++j)
+			{
+				auto segRec = reader.read<SegmentRecord>();
+				FastaRecord::Id origId(segRec.origSeqId);
+				std::string origIdString =
+					origId != FastaRecord::ID_NONE ?
+					std::to_string(origId.signedId()) : "*";
+				fout << "\tSequence\t" << edgeSeqNames.getName(segRec.seqName)
+					<< " " << segRec.seqLen << " " << origIdString << " "
+					<< segRec.origSeqLen << " " << segRec.origSeqStart
+					<< " " << segRec.origSeqEnd << "\n";
+			}
+		}
+	}
+
+	void convertAlignments(const std::string& inFile, std::ofstream& fout)
+	{
+		BinaryDumpReader reader(inFile, DumpFormat::ALIGNMENT_MAGIC);
+		SeqNameTable readNames;
+		readNames.readNames(reader);
+		SeqNameTable edgeSeqNames;
+		edgeSeqNames.readNames(reader);
+
+		uint64_t numChains = reader.read<uint64_t>();
+		for (uint64_t i = 0; i < numChains; ++i)
+		{
+			fout << "Chain\n";
+			uint32_t chainLen = reader.read<uint32_t>();
+			for (uint32_t j = 0; j < chainLen; ++j)
+			{
+				auto alnRec = reader.read<AlignmentRecord>();
+				fout << "\tAln\t" << alnRec.edgeId << "\t"
+					<< readNames.getName(alnRec.curName) << " "
+					<< alnRec.curBegin << " " << alnRec.curEnd << " "
+					<< alnRec.curLen << " " << edgeSeqNames.getName(alnRec.extName)
+					<< " " << alnRec.extBegin << " " << alnRec.extEnd << " "
+					<< alnRec.extLen << " " << -1 << " " << -1 << " "
+					<< alnRec.score << " " << alnRec.seqDivergence << "\n";
+			}
+		}
+	}
+}
+
+void convertDumpToText(const std::string& inFile, const std::string& outFile)
+{
+	std::ofstream fout(outFile);
+	if (!fout)
+	{
+		throw std::runtime_error("Can't open " + outFile);
+	}
+
+	if (BinaryDumpReader::isBinaryDump(inFile, DumpFormat::GRAPH_MAGIC))
+	{
+		convertGraph(inFile, fout);
+	}
+	else if (BinaryDumpReader::isBinaryDump(inFile, DumpFormat::ALIGNMENT_MAGIC))
+	{
+		convertAlignments(inFile, fout);
+	}
+	else
+	{
+		throw std::runtime_error("Not a binary graph or alignment dump: " + inFile);
+	}
+}
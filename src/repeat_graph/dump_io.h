@@ -0,0 +1,149 @@
+//(c) 2020 by Authors
+//This file is a part of Flye program.
+//Released under the BSD license (see LICENSE file)
+
+//Binary format of the repeat graph and read alignment dumps.
+//A file starts with a magic string and the format version, followed
+//by the sequence name tables. Records refer to sequences by their index
+//in the name table, so each name is resolved only once on loading.
+//The stream is compressed with zlib (fast compression level).
+//Text dumps could be produced with "flye-modules dump-convert".
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <zlib.h>
+
+#include "../sequence/sequence_container.h"
+
+namespace DumpFormat
+{
+	static const char GRAPH_MAGIC[] = "FLYEGRPH";
+	static const char ALIGNMENT_MAGIC[] = "FLYEALGN";
+	static const char READ_METADATA_MAGIC[] = "FLYEREAD";
+	static const uint32_t VERSION = 1;
+}
+
+//fixed-size records, without padding
+struct EdgeRecord
+{
+	uint32_t edgeId;
+	uint32_t leftNode;
+	uint32_t rightNode;
+	uint32_t numSegments;
+	int32_t  meanCoverage;
+	int32_t  altGroupId;
+	uint8_t  repetitive;
+	uint8_t  selfComplement;
+	uint8_t  resolved;
+	uint8_t  reserved;
+};
+static_assert(sizeof(EdgeRecord) == 28, "Unexpected size of EdgeRecord");
+
+struct SegmentRecord
+{
+	uint32_t seqName;
+	int32_t  seqLen;
+	uint32_t origSeqId;
+	int32_t  origSeqLen;
+	int32_t  origSeqStart;
+	int32_t  origSeqEnd;
+};
+static_assert(sizeof(SegmentRecord) == 24, "Unexpected size of SegmentRecord");
+
+struct AlignmentRecord
+{
+	uint32_t edgeId;
+	uint32_t curName;
+	int32_t  curBegin;
+	int32_t  curEnd;
+	int32_t  curLen;
+	uint32_t extName;
+	int32_t  extBegin;
+	int32_t  extEnd;
+	int32_t  extLen;
+	int32_t  score;
+	float	 seqDivergence;
+};
+static_assert(sizeof(AlignmentRecord) == 44, "Unexpected size of AlignmentRecord");
+
+class BinaryDumpWriter
+{
+public:
+	BinaryDumpWriter(const std::string& filename, const char* magic);
+	~BinaryDumpWriter();
+
+	BinaryDumpWriter(const BinaryDumpWriter&) = delete;
+	void operator=(const BinaryDumpWriter&) = delete;
+
+	template <class T>
+	void write(const T& value) {this->writeBytes(&value, sizeof(T));}
+	void writeString(const std::string& str);
+	void writeBytes(const void* data, size_t size);
+	void close();
+
+private:
+	gzFile _fd;
+	std::string _filename;
+};
+
+class BinaryDumpReader
+{
+public:
+	BinaryDumpReader(const std::string& filename, const char* magic);
+	~BinaryDumpReader();
+
+	BinaryDumpReader(const BinaryDumpReader&) = delete;
+	void operator=(const BinaryDumpReader&) = delete;
+
+	//checks if the file starts with the given magic string
+	static bool isBinaryDump(const std::string& filename, const char* magic);
+
+	template <class T>
+	T read()
+	{
+		T value;
+		this->readBytes(&value, sizeof(T));
+		return value;
+	}
+	std::string readString();
+	void readBytes(void* data, size_t size);
+
+private:
+	gzFile _fd;
+	std::string _filename;
+};
+
+//Maps sequence ids to the indices in the name table
+//when writing, and the indices back to ids when loading
+class SeqNameTable
+{
+public:
+	uint32_t addId(FastaRecord::Id seqId);
+	uint32_t getIndex(FastaRecord::Id seqId) const {return _idToIndex.at(seqId);}
+	FastaRecord::Id getId(uint32_t index) const {return _ids.at(index);}
+	const std::string& getName(uint32_t index) const {return _names.at(index);}
+
+	void write(BinaryDumpWriter& writer, const SequenceContainer& seqs) const;
+	//reads names only, without resolving them
+	void readNames(BinaryDumpReader& reader);
+	//reads names and resolves them against the container in parallel
+	void read(BinaryDumpReader& reader, const SequenceContainer& seqs);
+
+private:
+	std::unordered_map<FastaRecord::Id, uint32_t> _idToIndex;
+	std::vector<FastaRecord::Id> _ids;
+	std::vector<std::string> _names;
+};
+
+//Read metadata sidecar: names and lengths of the given reads, so
+//the later stages could resolve read alignments without parsing reads
+void storeReadMetadata(const std::string& filename,
+					   const SequenceContainer& readSeqs,
+					   const std::vector<FastaRecord::Id>& readIds);
+void loadReadMetadata(const std::string& filename, SequenceContainer& readSeqs);
+
+//converts a binary graph or alignment dump into the text format
+void convertDumpToText(const std::string& inFile, const std::string& outFile);
@@ -0,0 +1,33 @@
+//(c) 2020 by Authors
+//This file is a part of Flye program.
+//Released under the BSD license (see LICENSE file)
+
+//Converts the binary repeat graph / read alignment dumps
+//into the human-readable text format
+
+#include <iostream>
+
+#include "../common/logger.h"
+#include "../repeat_graph/dump_io.h"
+
+int dump_convert_main(int argc, char** argv)
+{
+	if (argc != 3)
+	{
+		std::cerr << "Usage: flye-modules dump-convert in_dump out_text\n\n"
+				  << "Converts binary repeat_graph_dump or read_alignment_dump "
+				  << "into the text format\n";
+		return 1;
+	}
+
+	try
+	{
+		convertDumpToText(argv[1], argv[2]);
+	}
+	catch (std::runtime_error& e)
+	{
+		Logger::get().error() << e.what();
+		return 1;
+	}
+	return 0;
+}
@@ -303,6 +303,7 @@ int repeat_main(int argc, char** argv)
 	outGen.outputDot(proc.getEdgesPaths(), outFolder + "/graph_after_rr.gv");
 	rg.storeGraph(outFolder + "/repeat_graph_dump");
 	aligner.storeAlignments(outFolder + "/read_alignment_dump");
+	aligner.storeReadMetadata(outFolder + "/read_metadata");
 	SequenceContainer::writeFasta(edgeSequences.iterSeqs(), 
 								  outFolder + "/repeat_graph_edges.fasta",
 								  /*only pos strand*/ true);
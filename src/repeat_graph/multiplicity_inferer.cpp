@@ -28,7 +28,7 @@ void MultiplicityInferer::estimateCoverage()
 	{
 		for (size_t pathId = 0; pathId < path.size(); ++pathId)
 		{
-			auto& edgeCov = wndCoverage[path[pathId].edge];
+			auto& edgeCov = wndCoverage[path.edgeAt(pathId)];
 			int covFrom = std::max(0, path[pathId].overlap.extBegin / WINDOW + 1);
 			int covTo = std::min((int)edgeCov.size(), path[pathId].overlap.extEnd / WINDOW);
 
@@ -280,12 +280,12 @@ int MultiplicityInferer::splitNodes()
 		
 		for (size_t i = 0; i < readPath.size() - 1; ++i)
 		{
-			//if (readPath[i].edge == readPath[i + 1].edge &&
-			//	readPath[i].edge->isLooped()) continue;
-			if (readPath[i].edge->edgeId == 
-				readPath[i + 1].edge->edgeId.rc()) continue;
+			//if (readPath.edgeAt(i) == readPath.edgeAt(i + 1) &&
+			//	readPath.edgeAt(i)->isLooped()) continue;
+			if (readPath.edgeAt(i)->edgeId == 
+				readPath.edgeAt(i + 1)->edgeId.rc()) continue;
 
-			++readSupport[readPath[i].edge][readPath[i + 1].edge];
+			++readSupport[readPath.edgeAt(i)][readPath.edgeAt(i + 1)];
 		}
 	}
 
@@ -306,20 +306,20 @@ int MultiplicityInferer::splitNodes()
 			GraphEdge* edge;
 			bool isInput;
 		};
-		typedef SetNode<EdgeDir> SetElement;
-		SetVec<EdgeDir> allElements;
-		std::unordered_map<GraphEdge*, SetElement*> inputElements;
-		std::unordered_map<GraphEdge*, SetElement*> outputElements;
+		std::vector<EdgeDir> allElements;
+		std::unordered_map<GraphEdge*, size_t> inputElements;
+		std::unordered_map<GraphEdge*, size_t> outputElements;
 		for (GraphEdge* edge : nodeToSplit->inEdges) 
 		{
-			allElements.push_back(new SetElement({edge, true}));
-			inputElements[edge] = allElements.back();
+			inputElements[edge] = allElements.size();
+			allElements.push_back({edge, true});
 		}
 		for (GraphEdge* edge : nodeToSplit->outEdges) 
 		{
-			allElements.push_back(new SetElement({edge, false}));
-			outputElements[edge] = allElements.back();
+			outputElements[edge] = allElements.size();
+			allElements.push_back({edge, false});
 		}
+		DisjointSet elementSets(allElements.size());
 
 		//grouping edges if they are connected by reads
 		for (GraphEdge* inEdge : nodeToSplit->inEdges)
@@ -328,13 +328,13 @@ int MultiplicityInferer::splitNodes()
 			{
 				if (outEdge.second >= MIN_JCT_SUPPORT)
 				{
-					unionSet(inputElements[inEdge], 
-							 outputElements[outEdge.first]);
+					elementSets.unionSet(inputElements[inEdge], 
+										 outputElements[outEdge.first]);
 				}
 			}
 		}
 
-		auto clusters = groupBySet(allElements);
+		auto clusters = groupBySet(elementSets);
 		if (clusters.size() > 1)	//need to split the node!
 		{
 			numSplit += 1;
@@ -353,7 +353,7 @@ int MultiplicityInferer::splitNodes()
 				//}
 			//}
 
-			for (auto& cl : clusters)
+			for (size_t cl = 0; cl < clusters.size(); ++cl)
 			{
 				auto switchNode = [](GraphEdge* edge, 
 									 GraphNode* newNode,
@@ -376,8 +376,9 @@ int MultiplicityInferer::splitNodes()
 
 				GraphNode* newNode = _graph.addNode();
 				GraphNode* newComplNode = _graph.addNode();
-				for (auto edgeDir : cl.second)
+				for (size_t elem : clusters[cl])
 				{
+					const EdgeDir& edgeDir = allElements[elem];
 					GraphEdge* complEdge = _graph.complementEdge(edgeDir.edge);
 					//GraphNode* complSplit = _graph.complementNode(nodeToSplit);
 					switchNode(edgeDir.edge, newNode, edgeDir.isInput);
@@ -415,15 +416,15 @@ int MultiplicityInferer::removeUnsupportedConnections()
 
 		for (size_t i = 0; i < readPath.size() - 1; ++i)
 		{
-			//if (readPath[i].edge == readPath[i + 1].edge &&
-			//	readPath[i].edge->isLooped()) continue;
-			if (readPath[i].edge->edgeId == 
-				readPath[i + 1].edge->edgeId.rc()) continue;
-
-			++rightConnections[readPath[i].edge];
-			++leftConnections[readPath[i + 1].edge];
-			GraphEdge* complLeft = _graph.complementEdge(readPath[i].edge);
-			GraphEdge* complRight = _graph.complementEdge(readPath[i + 1].edge);
+			//if (readPath.edgeAt(i) == readPath.edgeAt(i + 1) &&
+			//	readPath.edgeAt(i)->isLooped()) continue;
+			if (readPath.edgeAt(i)->edgeId == 
+				readPath.edgeAt(i + 1)->edgeId.rc()) continue;
+
+			++rightConnections[readPath.edgeAt(i)];
+			++leftConnections[readPath.edgeAt(i + 1)];
+			GraphEdge* complLeft = _graph.complementEdge(readPath.edgeAt(i));
+			GraphEdge* complRight = _graph.complementEdge(readPath.edgeAt(i + 1));
 			++rightConnections[complRight];
 			++leftConnections[complLeft];
 		}
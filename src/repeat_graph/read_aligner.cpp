@@ -3,11 +3,13 @@
 //Released under the BSD license (see LICENSE file)
 
 #include "read_aligner.h"
+#include "dump_io.h"
 #include "../sequence/alignment.h"
 #include "../common/parallel.h"
 #include <cmath>
 #include <iomanip>
 #include <queue>
+#include <limits>
 
 namespace
 {
@@ -161,16 +163,26 @@ void ReadAligner::alignReads()
 
 	static const float MAX_DIVERGENCE = Config::get("read_align_ovlp_divergence");
 
-	//create database
-	std::unordered_map<FastaRecord::Id, 
-					   std::pair<GraphEdge*, EdgeSequence>> idToSegment;
+	this->resetEdgeIndex();
+
+	//create database: edge sequence id -> edge. Ids of the edge
+	//sequences form a contiguous range, so it is a dense array
+	uint32_t minSeqId = std::numeric_limits<uint32_t>::max();
+	uint32_t maxSeqId = 0;
+	for (auto& seq : _graph.edgeSequences().iterSeqs())
+	{
+		minSeqId = std::min(minSeqId, seq.id.rawId());
+		maxSeqId = std::max(maxSeqId, seq.id.rawId());
+	}
+	std::vector<GraphEdge*> idToEdge;
+	if (minSeqId <= maxSeqId) idToEdge.assign(maxSeqId - minSeqId + 1, nullptr);
 	for (auto& edge : _graph.iterEdges())
 	{
 		for (auto& segment : edge->seqSegments)
 		{
-			idToSegment[segment.edgeSeqId] = {edge, segment};
-			idToSegment[segment.edgeSeqId.rc()] = {_graph.complementEdge(edge), 
-										   		   segment.complement()};
+			idToEdge[segment.edgeSeqId.rawId() - minSeqId] = edge;
+			idToEdge[segment.edgeSeqId.rc().rawId() - minSeqId] = 
+				_graph.complementEdge(edge);
 		}
 	}
 
@@ -202,18 +214,24 @@ void ReadAligner::alignReads()
 			allQueries.push_back(read.id);
 		}
 	}
-	std::mutex indexMutex;
-	int numAligned = 0;
-	int alignedInFull = 0;
-	int64_t alignedLength = 0;
+	//each batch is aligned into its own buffer, buffers are
+	//merged in the batch order afterwards (no locking, and
+	//the order of the alignments does not depend on scheduling)
+	struct BatchAlignments
+	{
+		AlignmentChains chains;
+		int numAligned = 0;
+		int alignedInFull = 0;
+		int64_t alignedLength = 0;
+	};
+	auto readBatches = readsOverlaps.makeBatches(allQueries);
+	std::vector<BatchAlignments> batchAlignments(readBatches.size());
 	OvlpDivStats divergenceStats;
 
-	std::function<void(const FastaRecord::Id&)> alignRead = 
-	[this, &indexMutex, &numAligned, &readsOverlaps,
-		&idToSegment, &alignedLength, &alignedInFull, &divergenceStats] 
-	(const FastaRecord::Id& seqId)
+	auto alignRead = 
+	[this, &idToEdge, minSeqId, &divergenceStats] 
+	(const std::vector<OverlapRange>& overlaps, BatchAlignments& output)
 	{
-		auto overlaps = readsOverlaps.quickSeqOverlaps(seqId);
 		std::vector<EdgeAlignment> alignments;
 		for (auto& ovlp : overlaps)
 		{
@@ -225,7 +243,7 @@ void ReadAligner::alignReads()
 			{
 				//alignments.push_back({ovlp, idToSegment[ovlp.extId].first,
 				//					  idToSegment[ovlp.extId].second});
-				alignments.push_back({ovlp, idToSegment[ovlp.extId].first});
+				alignments.push_back({ovlp, idToEdge[ovlp.extId.rawId() - minSeqId]});
 			}
 
 		}
@@ -247,43 +265,56 @@ void ReadAligner::alignReads()
 			}
 		}
 
-		std::vector<GraphAlignment> complChains(goodChains);
-		for (auto& chain : complChains)
-		{
-			for (auto& aln : chain)
-			{
-				aln.edge = _graph.complementEdge(aln.edge);
-				//aln.segment = aln.segment.complement();
-				aln.overlap = aln.overlap.complement();
-			}
-			std::reverse(chain.begin(), chain.end());
-		}
-
 		if (goodChains.empty()) return;
 
-		/////synchronized part
-		indexMutex.lock();
-		++numAligned;
-		if (goodChains.size() == 1) ++alignedInFull;
+		++output.numAligned;
+		if (goodChains.size() == 1) ++output.alignedInFull;
+		size_t firstChain = output.chains.size();
 		for (auto& chain : goodChains) 
 		{
-			chain.shrink_to_fit();
-			_readAlignments.push_back(chain);
-			alignedLength += chain.back().overlap.curEnd - 
-							 chain.front().overlap.curBegin;
+			output.chains.addChain(chain, _graph);
+			output.alignedLength += chain.back().overlap.curEnd - 
+									chain.front().overlap.curBegin;
 		}
-		for (auto& chain : complChains)
+		//complement chains share the alignments with the forward ones
+		for (size_t i = 0; i < goodChains.size(); ++i)
 		{
-			chain.shrink_to_fit();
-			_readAlignments.push_back(chain);
+			output.chains.addComplementChain(firstChain + i);
 		}
-		indexMutex.unlock();
-		/////
 	};
 
-	processInParallel(allQueries, alignRead, 
+	//reads are processed in batches to share the index queries
+	std::vector<size_t> batchIds(readBatches.size());
+	for (size_t i = 0; i < batchIds.size(); ++i) batchIds[i] = i;
+	std::function<void(const size_t&)> alignBatch = 
+	[&readsOverlaps, &alignRead, &readBatches, &batchAlignments] 
+	(const size_t& batchId)
+	{
+		auto& output = batchAlignments[batchId];
+		for (auto& overlaps : 
+			 readsOverlaps.quickSeqOverlapsBatch(readBatches[batchId]))
+		{
+			alignRead(overlaps, output);
+		}
+	};
+	processInParallel(batchIds, alignBatch, 
 					  Parameters::get().numThreads, true);
 
+	int numAligned = 0;
+	int alignedInFull = 0;
+	int64_t alignedLength = 0;
+	size_t totalChains = _readAlignments.size();
+	for (auto& batch : batchAlignments) totalChains += batch.chains.size();
+	_readAlignments.reserve(totalChains);
+	for (auto& batch : batchAlignments)
+	{
+		_readAlignments.append(batch.chains);
+		batch.chains = AlignmentChains();
+		numAligned += batch.numAligned;
+		alignedInFull += batch.alignedInFull;
+		alignedLength += batch.alignedLength;
+	}
+
 	Logger::get().debug() << "Total reads : " << allQueries.size();
 	Logger::get().debug() << "Read with aligned parts : " << numAligned;
 	Logger::get().debug() << "Aligned in one piece : " << alignedInFull;
@@ -295,84 +326,306 @@ void ReadAligner::alignReads()
 //updates alignments with respect to the new graph
 void ReadAligner::updateAlignments()
 {
-	auto isValidAlignment = [this](const GraphAlignment& aln)
+	auto isValidAlignment = [this](const AlignmentChains::Chain& aln)
 	{
 		for (size_t i = 0; i < aln.size() - 1; ++i)
 		{
-			if (!_graph.getEdge(aln[i].edge->edgeId) ||
-				!_graph.getEdge(aln[i + 1].edge->edgeId)) return false;
+			GraphEdge* curEdge = aln.edgeAt(i);
+			GraphEdge* nextEdge = aln.edgeAt(i + 1);
+			if (!_graph.getEdge(curEdge->edgeId) ||
+				!_graph.getEdge(nextEdge->edgeId)) return false;
 
-			if (aln[i].edge->nodeRight != aln[i + 1].edge->nodeLeft) return false;
+			if (curEdge->nodeRight != nextEdge->nodeLeft) return false;
 		}
 		return true;
 	};
 
-	std::vector<GraphAlignment> newlyAdded;
-	auto splitAlignment = [&newlyAdded, this](const GraphAlignment& aln)
+	//invalid alignment is split into the valid parts, which
+	//reference the alignments of the original chain
+	std::vector<std::pair<size_t, std::pair<size_t, size_t>>> newlyAdded;
+	auto splitAlignment = [&newlyAdded, this](size_t chainPos)
 	{
-		GraphAlignment curAlignment;
+		auto aln = _readAlignments[chainPos];
+		size_t partStart = 0;
+		bool partEmpty = true;
 		for (size_t i = 0; i < aln.size() - 1; ++i)
 		{
-			if (!_graph.getEdge(aln[i].edge->edgeId)) continue;
+			if (!_graph.getEdge(aln.edgeAt(i)->edgeId)) continue;
 
-			curAlignment.push_back(aln[i]);
-			if (!_graph.getEdge(aln[i + 1].edge->edgeId) ||
-				aln[i].edge->nodeRight != aln[i + 1].edge->nodeLeft)
+			if (partEmpty) partStart = i;
+			partEmpty = false;
+			if (!_graph.getEdge(aln.edgeAt(i + 1)->edgeId) ||
+				aln.edgeAt(i)->nodeRight != aln.edgeAt(i + 1)->nodeLeft)
 			{
-				newlyAdded.push_back(curAlignment);
-				curAlignment.clear();
+				newlyAdded.push_back({chainPos, {partStart, i + 1}});
+				partEmpty = true;
 			}
 		}
 
-		if (_graph.getEdge(aln.back().edge->edgeId)) curAlignment.push_back(aln.back());
-		if (!curAlignment.empty()) newlyAdded.push_back(curAlignment);
+		size_t lastPos = aln.size() - 1;
+		if (_graph.getEdge(aln.edgeAt(lastPos)->edgeId))
+		{
+			if (partEmpty) partStart = lastPos;
+			partEmpty = false;
+		}
+		if (!partEmpty) newlyAdded.push_back({chainPos, {partStart, lastPos + 1}});
 	};
 
-	size_t insertIdx = 0;
-	for (size_t i = 0; i < _readAlignments.size(); ++i)
+	//alignments that were not indexed yet (after alignment or loading)
+	//are all checked. Otherwise, only the alignments that go through
+	//the removed or reconnected edges could become invalid
+	bool fullUpdate = _chainIds.size() != _readAlignments.size();
+	std::vector<size_t> toCheck;
+	if (fullUpdate)
 	{
-		if (isValidAlignment(_readAlignments[i]))
+		this->resetEdgeIndex();
+		for (size_t i = 0; i < _readAlignments.size(); ++i)
 		{
-			if (i != insertIdx)
+			toCheck.push_back(i);
+			_chainIds.push_back(i);
+			_chainPositions.push_back(i);
+		}
+	}
+	else
+	{
+		for (size_t rawId = 0; rawId < _edgeChains.size(); ++rawId)
+		{
+			if (_edgeChains[rawId].empty() || 
+				!this->edgeModified(rawId)) continue;
+
+			for (size_t chainId : _edgeChains[rawId])
 			{
-				_readAlignments[insertIdx] = std::move(_readAlignments[i]);
+				if (_chainPositions[chainId] != NO_POSITION)
+				{
+					toCheck.push_back(_chainPositions[chainId]);
+				}
 			}
-			++insertIdx;
 		}
-		else
+		std::sort(toCheck.begin(), toCheck.end());
+		toCheck.erase(std::unique(toCheck.begin(), toCheck.end()), 
+					  toCheck.end());
+	}
+
+	std::vector<size_t> invalidPositions;
+	for (size_t pos : toCheck)
+	{
+		if (!isValidAlignment(_readAlignments[pos]))
 		{
-			splitAlignment(_readAlignments[i]);
+			splitAlignment(pos);
+			invalidPositions.push_back(pos);
 		}
 	}
-	_readAlignments.erase(_readAlignments.begin() + insertIdx, _readAlignments.end());
+
+	//new parts are added before the invalid chains are removed
+	size_t firstNew = _readAlignments.size() - invalidPositions.size();
 	_readAlignments.reserve(_readAlignments.size() + newlyAdded.size());
-	for (auto& aln : newlyAdded)
+	for (auto& part : newlyAdded)
+	{
+		_readAlignments.addSubChain(part.first, part.second.first, 
+									part.second.second);
+		_chainIds.push_back(_chainPositions.size());
+		_chainPositions.push_back(_readAlignments.size() - 1);
+	}
+
+	//removing invalid alignments, keeping the order of the rest
+	if (!invalidPositions.empty())
 	{
-		_readAlignments.push_back(std::move(aln));
+		size_t insertIdx = invalidPositions.front();
+		size_t nextInvalid = 0;
+		for (size_t i = invalidPositions.front(); i < _readAlignments.size(); ++i)
+		{
+			if (nextInvalid < invalidPositions.size() &&
+				invalidPositions[nextInvalid] == i)
+			{
+				_chainPositions[_chainIds[i]] = NO_POSITION;
+				++nextInvalid;
+				continue;
+			}
+			_readAlignments.moveChain(i, insertIdx);
+			_chainIds[insertIdx] = _chainIds[i];
+			_chainPositions[_chainIds[insertIdx]] = insertIdx;
+			++insertIdx;
+		}
+		_readAlignments.resize(insertIdx);
+		_chainIds.erase(_chainIds.begin() + insertIdx, _chainIds.end());
 	}
+
+	//update the edge index with the new alignments
+	size_t indexFrom = fullUpdate ? 0 : firstNew;
+	for (size_t i = indexFrom; i < _readAlignments.size(); ++i)
+	{
+		auto chain = _readAlignments[i];
+		for (size_t j = 0; j < chain.size(); ++j)
+		{
+			GraphEdge* edge = chain.edgeAt(j);
+			size_t rawId = edge->edgeId.rawId();
+			if (rawId >= _edgeChains.size())
+			{
+				_edgeChains.resize(rawId + 1);
+				_edgeStates.resize(rawId + 1);
+			}
+			if (_edgeChains[rawId].empty() || 
+				_edgeChains[rawId].back() != _chainIds[i])
+			{
+				_edgeChains[rawId].push_back(_chainIds[i]);
+			}
+			_edgeStates[rawId].edge = edge;
+		}
+	}
+
+	//removed edges are not referenced by the alignments anymore,
+	//and the lists of the modified edges are cleaned up
+	for (size_t rawId = 0; rawId < _edgeChains.size(); ++rawId)
+	{
+		if (_edgeChains[rawId].empty() || 
+			!this->edgeModified(rawId)) continue;
+
+		auto& edgeState = _edgeStates[rawId];
+		if (_graph.getEdge(edgeState.edge->edgeId) != edgeState.edge)
+		{
+			_edgeChains[rawId].clear();
+			_edgeChains[rawId].shrink_to_fit();
+			continue;
+		}
+
+		auto& chains = _edgeChains[rawId];
+		chains.erase(std::remove_if(chains.begin(), chains.end(),
+									[this](size_t chainId)
+									{return _chainPositions[chainId] == NO_POSITION;}),
+					 chains.end());
+		edgeState.nodeLeft = edgeState.edge->nodeLeft;
+		edgeState.nodeRight = edgeState.edge->nodeRight;
+	}
+}
+
+//should be called whenever the alignments are replaced, so
+//the next update re-indexes all of them
+void ReadAligner::resetEdgeIndex()
+{
+	_edgeChains.clear();
+	_edgeStates.clear();
+	_chainIds.clear();
+	_chainPositions.clear();
+}
+
+bool ReadAligner::edgeModified(size_t rawId) const
+{
+	const auto& edgeState = _edgeStates[rawId];
+	return _graph.getEdge(edgeState.edge->edgeId) != edgeState.edge ||
+		   edgeState.edge->nodeLeft != edgeState.nodeLeft ||
+		   edgeState.edge->nodeRight != edgeState.nodeRight;
 }
 
 void ReadAligner::storeAlignments(const std::string& filename)
 {
-	std::ofstream fout(filename);
-	if (!fout)
+	SeqNameTable readNames;
+	SeqNameTable edgeSeqNames;
+	for (auto& chain : _readAlignments)
 	{
-		throw std::runtime_error("Can't open "  + filename);
+		for (auto& aln : chain)
+		{
+			readNames.addId(aln.overlap.curId);
+			edgeSeqNames.addId(aln.overlap.extId);
+		}
+	}
+
+	BinaryDumpWriter writer(filename, DumpFormat::ALIGNMENT_MAGIC);
+	readNames.write(writer, _readSeqs);
+	edgeSeqNames.write(writer, _graph.edgeSequences());
+	writer.write<uint64_t>(_readAlignments.size());
+	for (auto& chain : _readAlignments)
+	{
+		writer.write<uint32_t>(chain.size());
+		for (auto& aln : chain)
+		{
+			AlignmentRecord alnRec = {};
+			alnRec.edgeId = aln.edge->edgeId.rawId();
+			alnRec.curName = readNames.getIndex(aln.overlap.curId);
+			alnRec.curBegin = aln.overlap.curBegin;
+			alnRec.curEnd = aln.overlap.curEnd;
+			alnRec.curLen = aln.overlap.curLen;
+			alnRec.extName = edgeSeqNames.getIndex(aln.overlap.extId);
+			alnRec.extBegin = aln.overlap.extBegin;
+			alnRec.extEnd = aln.overlap.extEnd;
+			alnRec.extLen = aln.overlap.extLen;
+			alnRec.score = aln.overlap.score;
+			alnRec.seqDivergence = aln.overlap.seqDivergence;
+			writer.write(alnRec);
+		}
 	}
+	writer.close();
+}
 
+void ReadAligner::storeReadMetadata(const std::string& filename)
+{
+	std::unordered_set<FastaRecord::Id> alignedReads;
 	for (auto& chain : _readAlignments)
 	{
-		fout << "Chain\n";
 		for (auto& aln : chain)
 		{
-			fout << "\tAln\t" << aln.edge->edgeId << "\t";
-			aln.overlap.dump(fout, _readSeqs, _graph.edgeSequences());
-			fout << "\n";
+			FastaRecord::Id readId = aln.overlap.curId;
+			alignedReads.insert(readId.strand() ? readId : readId.rc());
 		}
 	}
+	std::vector<FastaRecord::Id> readIds(alignedReads.begin(), 
+										 alignedReads.end());
+	std::sort(readIds.begin(), readIds.end());
+	::storeReadMetadata(filename, _readSeqs, readIds);
 }
 
 void ReadAligner::loadAlignments(const std::string& filename)
+{
+	this->resetEdgeIndex();
+	if (!BinaryDumpReader::isBinaryDump(filename, DumpFormat::ALIGNMENT_MAGIC))
+	{
+		this->loadAlignmentsText(filename);
+		return;
+	}
+
+	BinaryDumpReader reader(filename, DumpFormat::ALIGNMENT_MAGIC);
+	SeqNameTable readNames;
+	readNames.read(reader, _readSeqs);
+	SeqNameTable edgeSeqNames;
+	edgeSeqNames.read(reader, _graph.edgeSequences());
+
+	uint64_t numChains = reader.read<uint64_t>();
+	_readAlignments.reserve(_readAlignments.size() + numChains);
+	GraphAlignment curAlignment;
+	for (uint64_t i = 0; i < numChains; ++i)
+	{
+		curAlignment.clear();
+		uint32_t chainLen = reader.read<uint32_t>();
+		for (uint32_t j = 0; j < chainLen; ++j)
+		{
+			auto alnRec = reader.read<AlignmentRecord>();
+			//alignment might contain edges that were removed from the graph
+			GraphEdge* edge = _graph.getEdge(FastaRecord::Id(alnRec.edgeId));
+			if (!edge) continue;
+
+			OverlapRange ovlp;
+			ovlp.curId = readNames.getId(alnRec.curName);
+			ovlp.curBegin = alnRec.curBegin;
+			ovlp.curEnd = alnRec.curEnd;
+			ovlp.curLen = alnRec.curLen;
+			ovlp.extId = edgeSeqNames.getId(alnRec.extName);
+			ovlp.extBegin = alnRec.extBegin;
+			ovlp.extEnd = alnRec.extEnd;
+			ovlp.extLen = alnRec.extLen;
+			ovlp.score = alnRec.score;
+			ovlp.seqDivergence = alnRec.seqDivergence;
+			curAlignment.push_back({ovlp, edge});
+		}
+		if (!curAlignment.empty())
+		{
+			_readAlignments.addChain(curAlignment, _graph);
+		}
+	}
+
+	this->updateAlignments();
+}
+
+//loads the alignment dump in the text format, produced by the older versions
+void ReadAligner::loadAlignmentsText(const std::string& filename)
 {
 	std::ifstream fin(filename);
 	if (!fin)
@@ -392,8 +645,7 @@ void ReadAligner::loadAlignments(const std::string& filename)
 		{
 			if (!curAlignment.empty())
 			{
-				curAlignment.shrink_to_fit();
-				_readAlignments.push_back(curAlignment);
+				_readAlignments.addChain(curAlignment, _graph);
 				curAlignment.clear();
 			}
 		}
@@ -416,9 +668,7 @@ void ReadAligner::loadAlignments(const std::string& filename)
 	}
 	if (!curAlignment.empty())
 	{
-		curAlignment.shrink_to_fit();
-		_readAlignments.push_back(curAlignment);
-		curAlignment.clear();
+		_readAlignments.addChain(curAlignment, _graph);
 	}
 
 	this->updateAlignments();
@@ -436,7 +686,10 @@ ReadAligner::AlnIndex ReadAligner::makeAlignmentIndex()
 			{
 				uniqueEdges.insert(edgeAln.edge);
 			}
-			for (GraphEdge* edge : uniqueEdges) alnIndex[edge].push_back(aln);
+			for (GraphEdge* edge : uniqueEdges) 
+			{
+				alnIndex[edge].emplace_back(aln.begin(), aln.end());
+			}
 		}
 	}
 	return alnIndex;
@@ -476,7 +729,7 @@ ReadAligner::ConnIndex ReadAligner::getEdgeConnectivity() const
 	{
 		for (size_t i = 0; i < aln.size() - 1; ++i)
 		{
-			++connections[aln[i].edge][aln[i + 1].edge];
+			++connections[aln.edgeAt(i)][aln.edgeAt(i + 1)];
 		}
 	}
 	return connections;
@@ -9,14 +9,7 @@
 #pragma once
 
 #include "repeat_graph.h"
-
-struct EdgeAlignment
-{
-	OverlapRange overlap;
-	GraphEdge* edge;
-	//EdgeSequence segment;
-};
-typedef std::vector<EdgeAlignment> GraphAlignment;
+#include "alignment_chains.h"
 
 class ReadAligner
 {
@@ -26,11 +19,13 @@ public:
 
 	void alignReads();
 	void updateAlignments();
-	const std::vector<GraphAlignment>& getAlignments() const
+	const AlignmentChains& getAlignments() const
 		{return _readAlignments;}
 
 	void storeAlignments(const std::string& filename);
 	void loadAlignments(const std::string& filename);
+	//stores names and lengths of the aligned reads
+	void storeReadMetadata(const std::string& filename);
 
 	typedef std::unordered_map<GraphEdge*, 
 					   		   std::vector<GraphAlignment>> AlnIndex;
@@ -41,12 +36,33 @@ public:
 	ConnIndex getEdgeConnectivity() const;
 
 private:
+	void loadAlignmentsText(const std::string& filename);
+
 	std::vector<GraphAlignment> 
 		chainReadAlignments(const std::vector<EdgeAlignment>& ovlps) const;
 
 	float getChainBaseDivergence(const GraphAlignment& aln, bool realign);
+	bool  edgeModified(size_t rawEdgeId) const;
+	void  resetEdgeIndex();
+
+	AlignmentChains _readAlignments;
 
-	std::vector<GraphAlignment> _readAlignments;
+	//Index of the alignments by the edges they go through, so
+	//updateAlignments() only checks the alignments that touch
+	//edges that were removed or reconnected since the last update.
+	//Each alignment has a permanent id, mapped to its current position
+	struct EdgeState
+	{
+		EdgeState(): edge(nullptr), nodeLeft(nullptr), nodeRight(nullptr) {}
+		GraphEdge* edge;
+		GraphNode* nodeLeft;
+		GraphNode* nodeRight;
+	};
+	static const size_t NO_POSITION = (size_t)-1;
+	std::vector<std::vector<size_t>> _edgeChains;
+	std::vector<EdgeState> 			 _edgeStates;
+	std::vector<size_t> 			 _chainIds;
+	std::vector<size_t> 			 _chainPositions;
 
 	RepeatGraph& _graph;
 	//const SequenceContainer&   _asmSeqs;
@@ -10,8 +10,10 @@
 #include "../sequence/vertex_index.h"
 #include "../common/config.h"
 #include "../common/disjoint_set.h"
+#include "../common/parallel.h"
 #include "repeat_graph.h"
 #include "graph_processing.h"
+#include "dump_io.h"
 
 
 namespace
@@ -100,6 +102,8 @@ void RepeatGraph::build(bool keepHaplotypes)
 
 	OverlapContainer asmOverlaps(asmOverlapper, _asmSeqs);
 	asmOverlaps.findAllOverlaps();
+	//all overlaps are computed and stored, the index is no longer needed
+	asmIndex.clear();
 	asmOverlaps.buildIntervalTree();
 	asmOverlaps.overlapDivergenceStats();
 
@@ -129,76 +133,93 @@ void RepeatGraph::getGluepoints(OverlapContainer& asmOverlaps)
 	//(this means they will be glued during repeat graph cosntruction)
 	
 	Logger::get().debug() << "Computing gluepoints";
-	typedef SetNode<Point2d> SetPoint2d;
-	std::unordered_map<FastaRecord::Id, SetVec<Point2d>> endpoints;
 
 	//first, extract endpoints from all overlaps.
-	//each point has X and Y coordinates (curSeq and extSeq)
+	//each point has X and Y coordinates (curSeq and extSeq).
+	//Then, for each contig, cluster gluepoints that are close to 
+	//each other (only cosider X coordinates for now). After sorting,
+	//clusters are the runs of consecutive points. Contigs are processed
+	//in parallel, and only forward strands are clustered.
+	std::vector<FastaRecord::Id> fwdSeqs;
 	for (auto& seq : _asmSeqs.iterSeqs())
 	{
-		for (auto& ovlp : asmOverlaps.lazySeqOverlaps(seq.id))
-		{
-			endpoints[ovlp.curId]
-				.push_back(new SetPoint2d(Point2d(ovlp.curId, ovlp.curBegin,
-										  ovlp.extId, ovlp.extBegin)));
-			endpoints[ovlp.curId]
-				.push_back(new SetPoint2d(Point2d(ovlp.curId, ovlp.curEnd,
-										  ovlp.extId, ovlp.extEnd)));
-		}
+		if (seq.id.strand()) fwdSeqs.push_back(seq.id);
 	}
-
-	//for each contig, cluster gluepoints that are close to each other
-	//only cosider X coordinates for now
-	for (auto& seqPoints : endpoints)
+	std::vector<size_t> seqIndices(fwdSeqs.size());
+	for (size_t i = 0; i < seqIndices.size(); ++i) seqIndices[i] = i;
+
+	std::vector<std::vector<Point2d>> seqEndpoints(fwdSeqs.size());
+	std::vector<std::vector<size_t>> seqClusterStarts(fwdSeqs.size());
+	std::function<void(const size_t&)> clusterEndpoints =
+	[this, &asmOverlaps, &fwdSeqs, &seqEndpoints, &seqClusterStarts]
+		(const size_t& seqIdx)
 	{
-		sortByKey(seqPoints.second, [](SetPoint2d* const &p){return p->data.curPos;});
+		auto& endpoints = seqEndpoints[seqIdx];
+		for (auto& ovlp : asmOverlaps.lazySeqOverlaps(fwdSeqs[seqIdx]))
+		{
+			endpoints.emplace_back(ovlp.curId, ovlp.curBegin,
+								   ovlp.extId, ovlp.extBegin);
+			endpoints.emplace_back(ovlp.curId, ovlp.curEnd,
+								   ovlp.extId, ovlp.extEnd);
+		}
+		sortByKey(endpoints, [](const Point2d& p){return p.curPos;});
 
-		for (size_t i = 0; i < seqPoints.second.size() - 1; ++i)
+		for (size_t i = 0; i < endpoints.size(); ++i)
 		{
-			auto* p1 = seqPoints.second[i];
-			auto* p2 = seqPoints.second[i + 1];
-			if (abs(p1->data.curPos - p2->data.curPos) < _maxSeparation)
+			if (i == 0 || 
+				abs(endpoints[i].curPos - endpoints[i - 1].curPos) >= _maxSeparation)
 			{
-				unionSet(p1, p2);
+				seqClusterStarts[seqIdx].push_back(i);
 			}
-
 		}
-	}
-	std::vector<SetPoint2d*> flatEndpoints;
-	for (auto& seqPoints : endpoints)
+		seqClusterStarts[seqIdx].push_back(endpoints.size());
+	};
+	processInParallel(seqIndices, clusterEndpoints, 
+					  Parameters::get().numThreads, false);
+
+	struct ClusterRange
 	{
-		flatEndpoints.insert(flatEndpoints.end(), seqPoints.second.begin(), 
-							 seqPoints.second.end());
+		size_t seqIdx;
+		size_t begin;
+		size_t end;
+	};
+	std::vector<ClusterRange> clusters;
+	for (size_t seqIdx = 0; seqIdx < fwdSeqs.size(); ++seqIdx)
+	{
+		auto& starts = seqClusterStarts[seqIdx];
+		for (size_t i = 0; i + 1 < starts.size(); ++i)
+		{
+			clusters.push_back({seqIdx, starts[i], starts[i + 1]});
+		}
 	}
-	auto clusters = groupBySet(flatEndpoints);
-
-	typedef SetNode<Point1d> SetPoint1d;
-	std::unordered_map<FastaRecord::Id, SetVec<Point1d>> tempGluepoints;
-	std::unordered_map<SetPoint1d*, SetPoint1d*> complements;
+	std::vector<size_t> clusterIndices(clusters.size());
+	for (size_t i = 0; i < clusterIndices.size(); ++i) clusterIndices[i] = i;
 
 	//we will now split each cluster based on it's Y coordinates
-	//and project these subgroups to the corresponding sequences
-	for (auto& clustEndpoints : clusters)
+	//and project these subgroups to the corresponding sequences.
+	//Clusters are independent and processed in parallel
+	std::vector<std::vector<Point1d>> clusterPoints(clusters.size());
+	std::function<void(const size_t&)> splitCluster =
+	[this, &asmOverlaps, &fwdSeqs, &seqEndpoints, &clusters, &clusterPoints]
+		(const size_t& clustIdx)
 	{
-		//first, simply add projections for each point from the cluster
-		FastaRecord::Id clustSeq = clustEndpoints.second.front().curId;
-		if (!clustSeq.strand()) continue;	//only for forward strands
+		const ClusterRange& clust = clusters[clustIdx];
+		const auto& endpoints = seqEndpoints[clust.seqIdx];
+		FastaRecord::Id clustSeq = fwdSeqs[clust.seqIdx];
 
+		//first, simply add projections for each point from the cluster
 		std::vector<int32_t> positions;
-		for (auto& ep : clustEndpoints.second) 
+		for (size_t i = clust.begin; i < clust.end; ++i) 
 		{
-			positions.push_back(ep.curPos);
+			positions.push_back(endpoints[i].curPos);
 		}
 		int32_t clusterXpos = median(positions);
 
-		std::vector<Point1d> clusterPoints;
-		clusterPoints.emplace_back(clustSeq, clusterXpos);
+		auto& points = clusterPoints[clustIdx];
+		points.emplace_back(clustSeq, clusterXpos);
 
-		SetVec<Point2d> extCoords;
-		for (auto& ep : clustEndpoints.second)
-		{
-			extCoords.push_back(new SetPoint2d(ep));
-		}
+		std::vector<Point2d> extCoords(endpoints.begin() + clust.begin,
+									   endpoints.begin() + clust.end);
 		
 		//Important part: extending set of gluing points
 		//We need also add extra projections
@@ -213,46 +234,53 @@ void RepeatGraph::getGluepoints(OverlapContainer& asmOverlaps)
 				clusterXpos - ovlp.curBegin > _maxSeparation)
 			{
 				int32_t projectedPos = ovlp.project(clusterXpos);
-				extCoords.push_back(new SetPoint2d(Point2d(clustSeq, clusterXpos,
-											   	   ovlp.extId, 
-											   	   projectedPos)));
+				extCoords.emplace_back(clustSeq, clusterXpos,
+									   ovlp.extId, projectedPos);
 			}
 		}
 
 		//Finally, cluster the projected points based on Y coordinates
-		sortByKey(extCoords, [](SetPoint2d* const &p)
-				  {return std::make_pair(p->data.extId, p->data.extPos);});
-		for (size_t i = 0; i < extCoords.size() - 1; ++i)
+		//and get coordinates for each subcluster
+		sortByKey(extCoords, [](const Point2d& p)
+				  {return std::make_pair(p.extId, p.extPos);});
+		size_t runStart = 0;
+		for (size_t i = 1; i <= extCoords.size(); ++i)
 		{
-			auto* p1 = extCoords[i];
-			auto* p2 = extCoords[i + 1];
-			if (p1->data.extId == p2->data.extId &&
-				abs(p1->data.extPos - p2->data.extPos) < _maxSeparation)
+			if (i < extCoords.size() &&
+				extCoords[i].extId == extCoords[i - 1].extId &&
+				abs(extCoords[i].extPos - extCoords[i - 1].extPos) < _maxSeparation)
 			{
-				unionSet(p1, p2);
+				continue;
 			}
 
-		}
-		auto extClusters = groupBySet(extCoords);
-		//now, get coordinates for each cluster
-		for (auto& extClust : extClusters)
-		{
-			std::vector<int32_t> positions;
-			for (auto& ep : extClust.second) 
+			std::vector<int32_t> extPositions;
+			for (size_t j = runStart; j < i; ++j) 
 			{
-				positions.push_back(ep.extPos);
+				extPositions.push_back(extCoords[j].extPos);
 			}
-			int32_t clusterYpos = median(positions);
-
-			FastaRecord::Id extSeq = extClust.second.front().extId;
-			clusterPoints.emplace_back(extSeq, clusterYpos);
+			points.emplace_back(extCoords[runStart].extId, median(extPositions));
+			runStart = i;
 		}
-
-		//We should now consider how newly generaetd clusters
-		//are integrated with the existing ones, we might need to
-		//merge some of them together
-		std::vector<SetPoint1d*> toMerge;
-		for (auto& clustPt : clusterPoints)
+	};
+	processInParallel(clusterIndices, splitCluster, 
+					  Parameters::get().numThreads, false);
+
+	//We should now consider how newly generaetd clusters
+	//are integrated with the existing ones, we might need to
+	//merge some of them together. Each point is stored along with
+	//its complement, point sets are tracked by their indices
+	size_t totalPoints = 0;
+	for (auto& points : clusterPoints) totalPoints += 2 * points.size();
+	std::vector<Point1d> gluepoints;
+	gluepoints.reserve(totalPoints);
+	std::vector<size_t> complements(totalPoints);
+	ConcurrentDisjointSet gluepointSets(totalPoints);
+	std::unordered_map<FastaRecord::Id, std::vector<size_t>> tempGluepoints;
+
+	for (auto& points : clusterPoints)
+	{
+		std::vector<size_t> toMerge;
+		for (auto& clustPt : points)
 		{
 			int32_t seqLen = _asmSeqs.seqLen(clustPt.seqId);
 			Point1d complPt(clustPt.seqId.rc(), seqLen - clustPt.pos - 1);
@@ -261,124 +289,133 @@ void RepeatGraph::getGluepoints(OverlapContainer& asmOverlaps)
 			auto& complGluepoints = tempGluepoints[clustPt.seqId.rc()];
 
 			//inserting into sorted vector
-			auto cmp = [] (const SetPoint1d* gp, int32_t pos)
-								{return gp->data.pos < pos;};
+			auto cmp = [&gluepoints] (size_t gp, int32_t pos)
+								{return gluepoints[gp].pos < pos;};
 			size_t i = std::lower_bound(seqGluepoints.begin(), 
 										seqGluepoints.end(),
 										clustPt.pos, cmp) - seqGluepoints.begin();
-			auto cmp2 = [] (int32_t pos, const SetPoint1d* gp)
-								{return pos < gp->data.pos;};
+			auto cmp2 = [&gluepoints] (int32_t pos, size_t gp)
+								{return pos < gluepoints[gp].pos;};
 			size_t ci = std::upper_bound(complGluepoints.begin(), 
 										 complGluepoints.end(),
 										 complPt.pos, cmp2) - complGluepoints.begin();
-			if (!seqGluepoints.empty())
+			if (i > 0 && 
+				clustPt.pos - gluepoints[seqGluepoints[i - 1]].pos < _maxSeparation)
 			{
-				if (i > 0 && 
-					clustPt.pos - seqGluepoints[i - 1]->data.pos < _maxSeparation)
-				{
-					toMerge.push_back(seqGluepoints[i - 1]);
-				}
-				if (i < seqGluepoints.size() && 
-					seqGluepoints[i]->data.pos - clustPt.pos < _maxSeparation)
-				{
-					toMerge.push_back(seqGluepoints[i]);
-				}
+				toMerge.push_back(seqGluepoints[i - 1]);
+			}
+			if (i < seqGluepoints.size() && 
+				gluepoints[seqGluepoints[i]].pos - clustPt.pos < _maxSeparation)
+			{
+				toMerge.push_back(seqGluepoints[i]);
 			}
 
-			seqGluepoints.insert(seqGluepoints.begin() + i, 
-								 new SetPoint1d(clustPt));
-			auto fwdPtr = seqGluepoints[i];
-			complGluepoints.insert(complGluepoints.begin() + ci,
-								   new SetPoint1d(complPt));
-			auto revPtr = complGluepoints[ci];
+			size_t fwdIdx = gluepoints.size();
+			gluepoints.push_back(clustPt);
+			size_t revIdx = gluepoints.size();
+			gluepoints.push_back(complPt);
+			seqGluepoints.insert(seqGluepoints.begin() + i, fwdIdx);
+			complGluepoints.insert(complGluepoints.begin() + ci, revIdx);
 
-			complements[fwdPtr] = revPtr;
-			complements[revPtr] = fwdPtr;
-			toMerge.push_back(fwdPtr);
+			complements[fwdIdx] = revIdx;
+			complements[revIdx] = fwdIdx;
+			toMerge.push_back(fwdIdx);
 		}
 		for (size_t i = 0; i < toMerge.size() - 1; ++i)
 		{
-			unionSet(toMerge[i], toMerge[i + 1]);
-			unionSet(complements[toMerge[i]], 
-					 complements[toMerge[i + 1]]);
+			gluepointSets.unionSet(toMerge[i], toMerge[i + 1]);
+			gluepointSets.unionSet(complements[toMerge[i]], 
+								   complements[toMerge[i + 1]]);
 		}
 	}
 
 	//Generating final gluepoints, we might need to additionally
-	//split long clusters into parts (tandem repeats)
-	size_t pointId = 0;
-	std::unordered_map<SetPoint1d*, size_t> setToId;
-	auto addConsensusPoint = [&setToId, this, &pointId]
-		(const std::vector<SetPoint1d*>& group)
+	//split long clusters into parts (tandem repeats). Groups
+	//of close points are extracted for each sequence in parallel,
+	//then point ids are assigned to the groups
+	std::vector<FastaRecord::Id> gluepointSeqs;
+	for (auto& seqGluepoints : tempGluepoints) 
 	{
-		SetPoint1d* reprPoint = group.front();
-		if (!setToId.count(findSet(reprPoint)))
-		{
-			setToId[findSet(reprPoint)] = pointId++;
-		}
-		int32_t clusterSize = group.back()->data.pos - 
-							  group.front()->data.pos;
+		gluepointSeqs.push_back(seqGluepoints.first);
+	}
+	std::sort(gluepointSeqs.begin(), gluepointSeqs.end());
+	std::vector<size_t> gpSeqIndices(gluepointSeqs.size());
+	for (size_t i = 0; i < gpSeqIndices.size(); ++i) gpSeqIndices[i] = i;
 
-		//big cluster corresponding to a tandem repeat - 
-		//split it into multiple short edges
-		if (clusterSize > _maxSeparation)
+	struct ConsensusGroup
+	{
+		size_t setId;
+		std::vector<int32_t> positions;
+	};
+	std::vector<std::vector<ConsensusGroup>> seqGroups(gluepointSeqs.size());
+	std::function<void(const size_t&)> extractGroups =
+	[this, &tempGluepoints, &gluepointSeqs, &gluepoints, 
+	 &gluepointSets, &seqGroups] (const size_t& seqIdx)
+	{
+		const auto& seqPoints = tempGluepoints.at(gluepointSeqs[seqIdx]);
+		size_t groupStart = 0;
+		for (size_t i = 1; i <= seqPoints.size(); ++i)
 		{
-			_gluePoints[reprPoint->data.seqId]
-				.emplace_back(setToId[findSet(reprPoint)],
-							  reprPoint->data.seqId, group.front()->data.pos);
-
-			int32_t repeats = std::floor(clusterSize / _maxSeparation);
-			int32_t mode = clusterSize / repeats;
-			for (int32_t i = 1; i < repeats; ++i)
+			if (i < seqPoints.size() &&
+				gluepoints[seqPoints[i]].pos - 
+				gluepoints[seqPoints[i - 1]].pos < _maxSeparation)
 			{
-				int32_t pos = group.front()->data.pos + mode * i;
-				_gluePoints[reprPoint->data.seqId]
-					.emplace_back(setToId[findSet(reprPoint)],
-								  reprPoint->data.seqId, pos);
-
+				continue;
 			}
 
-			_gluePoints[reprPoint->data.seqId]
-				.emplace_back(setToId[findSet(reprPoint)],
-							  reprPoint->data.seqId, group.back()->data.pos);
-		}
-		//"normal" endpoint - just take a consensus
-		else
-		{
-			std::vector<int32_t> positions;
-			for (auto& ep : group) 
+			ConsensusGroup group;
+			group.setId = gluepointSets.findSet(seqPoints[groupStart]);
+			int32_t firstPos = gluepoints[seqPoints[groupStart]].pos;
+			int32_t lastPos = gluepoints[seqPoints[i - 1]].pos;
+			int32_t clusterSize = lastPos - firstPos;
+
+			//big cluster corresponding to a tandem repeat - 
+			//split it into multiple short edges
+			if (clusterSize > _maxSeparation)
 			{
-				positions.push_back(ep->data.pos);
+				group.positions.push_back(firstPos);
+				int32_t repeats = std::floor(clusterSize / _maxSeparation);
+				int32_t mode = clusterSize / repeats;
+				for (int32_t j = 1; j < repeats; ++j)
+				{
+					group.positions.push_back(firstPos + mode * j);
+				}
+				group.positions.push_back(lastPos);
+			}
+			//"normal" endpoint - just take a consensus
+			else
+			{
+				std::vector<int32_t> positions;
+				for (size_t j = groupStart; j < i; ++j) 
+				{
+					positions.push_back(gluepoints[seqPoints[j]].pos);
+				}
+				group.positions.push_back(median(positions));
 			}
-			int32_t clusterXpos = median(positions);
 
-			_gluePoints[reprPoint->data.seqId]
-				.emplace_back(setToId[findSet(reprPoint)],
-							  reprPoint->data.seqId, clusterXpos);
+			seqGroups[seqIdx].push_back(std::move(group));
+			groupStart = i;
 		}
-
 	};
-	for (auto& seqGluepoints : tempGluepoints)
+	processInParallel(gpSeqIndices, extractGroups, 
+					  Parameters::get().numThreads, false);
+
+	size_t pointId = 0;
+	std::unordered_map<size_t, size_t> setToId;
+	for (size_t seqIdx = 0; seqIdx < gluepointSeqs.size(); ++seqIdx)
 	{
-		std::vector<SetPoint1d*> currentGroup;
-		for (auto& gp : seqGluepoints.second)
+		FastaRecord::Id seqId = gluepointSeqs[seqIdx];
+		for (auto& group : seqGroups[seqIdx])
 		{
-			if (currentGroup.empty() || 
-				gp->data.pos - currentGroup.back()->data.pos < _maxSeparation)
+			if (!setToId.count(group.setId))
 			{
-				currentGroup.push_back(gp);
+				setToId[group.setId] = pointId++;
 			}
-			else
+			for (int32_t pos : group.positions)
 			{
-				addConsensusPoint(currentGroup);
-				currentGroup.clear();
-				currentGroup.push_back(gp);
+				_gluePoints[seqId].emplace_back(setToId[group.setId], seqId, pos);
 			}
 		}
-		if (!currentGroup.empty())
-		{
-			addConsensusPoint(currentGroup);
-		}
 	}
 
 	//ensure that coordinates on forward and reverse contig copies are symmetric
@@ -443,19 +480,24 @@ void RepeatGraph::checkGluepointProjections(const OverlapContainer& asmOverlaps)
 	{
 		std::unordered_map<FastaRecord::Id, 
 						   std::vector<GluePoint>> addedGluepoints;
-		std::unordered_map<size_t, SetNode<size_t>*> mergedGluepoints;
-		auto combinePts = [&mergedGluepoints](size_t idOne, size_t idTwo)
+		DisjointSet mergedGluepoints;
+		std::unordered_map<size_t, size_t> pointToElement;
+		std::vector<size_t> elementToPoint;
+		auto getElement = [&mergedGluepoints, &pointToElement, 
+						   &elementToPoint](size_t pointId)
 		{
-			if (!mergedGluepoints.count(idOne))
-			{
-				mergedGluepoints[idOne] = new SetNode<size_t>(idOne);
-			}
-			if (!mergedGluepoints.count(idTwo))
-			{
-				mergedGluepoints[idTwo] = new SetNode<size_t>(idTwo);
-			}
-			unionSet(mergedGluepoints[idOne],
-					 mergedGluepoints[idTwo]);
+			auto it = pointToElement.find(pointId);
+			if (it != pointToElement.end()) return it->second;
+
+			size_t elem = mergedGluepoints.addElement();
+			pointToElement[pointId] = elem;
+			elementToPoint.push_back(pointId);
+			return elem;
+		};
+		auto combinePts = [&mergedGluepoints, &getElement]
+			(size_t idOne, size_t idTwo)
+		{
+			mergedGluepoints.unionSet(getElement(idOne), getElement(idTwo));
 		};
 
 		//for (auto& gp : _gluePoints)
@@ -559,19 +601,14 @@ void RepeatGraph::checkGluepointProjections(const OverlapContainer& asmOverlaps)
 			if (!_gluePoints.count(seq.id)) continue;
 			for (auto& point : _gluePoints[seq.id])
 			{
-				if (mergedGluepoints.count(point.pointId))
+				auto it = pointToElement.find(point.pointId);
+				if (it != pointToElement.end())
 				{
 					point.pointId = 
-						findSet(mergedGluepoints[point.pointId])->data;
+						elementToPoint[mergedGluepoints.findSet(it->second)];
 				}
 			}
 		}
-		/*for (auto& point : mergedGluepoints)
-		{
-			Logger::get().debug() << "Merging " << point.first << " -> "
-				<< findSet(point.second)->data;
-		}*/
-		for (auto& point : mergedGluepoints) delete point.second;
 
 		if (!totalAdded) break;
 	}
@@ -792,38 +829,38 @@ void RepeatGraph::initializeEdges(const OverlapContainer& asmOverlaps)
 		usedPairs.insert(complEdges[nodePair]);
 
 		//creating set and building index
-		typedef SetNode<EdgeSequence*> SetSegment;
-		SetVec<EdgeSequence*> segmentSets;
+		DisjointSet segmentSets(nodePairSeqs.size());
 		std::unordered_map<FastaRecord::Id, 
-						   std::vector<SetSegment*>> segmentIndex;
-		for (auto& seg : nodePairSeqs) 
+						   std::vector<size_t>> segmentIndex;
+		for (size_t i = 0; i < nodePairSeqs.size(); ++i) 
 		{
-			segmentSets.push_back(new SetSegment(&seg));
-			segmentIndex[seg.origSeqId].push_back(segmentSets.back());
+			segmentIndex[nodePairSeqs[i].origSeqId].push_back(i);
 		}
 		for (auto& seqSegments : segmentIndex)
 		{
-			sortByKey(seqSegments.second, [](SetSegment* const &s){return s->data->origSeqStart;});
+			sortByKey(seqSegments.second, [&nodePairSeqs](const size_t& s)
+					  {return nodePairSeqs[s].origSeqStart;});
 		}
 
 		//cluster segments based on their overlaps
-		for (auto& setOne : segmentSets)
+		for (size_t setOne = 0; setOne < nodePairSeqs.size(); ++setOne)
 		{
+			const EdgeSequence& segOne = nodePairSeqs[setOne];
 			for (auto& interval : asmOverlaps
-					.getCoveringOverlaps(setOne->data->origSeqId, 
-										 setOne->data->origSeqStart,
-										 setOne->data->origSeqEnd))
+					.getCoveringOverlaps(segOne.origSeqId, 
+										 segOne.origSeqStart,
+										 segOne.origSeqEnd))
 			{
 				auto& ovlp = *interval.value;
 				int32_t intersectOne = 
-					segIntersect(*setOne->data, ovlp.curBegin, ovlp.curEnd);
+					segIntersect(segOne, ovlp.curBegin, ovlp.curEnd);
 				if (intersectOne <= 0) continue;
 
 				auto& ss = segmentIndex[ovlp.extId];
-				auto cmpBegin = [] (const SetSegment* s, int32_t pos)
-								    {return s->data->origSeqStart < pos;};
-				auto cmpEnd = [] (const SetSegment* s, int32_t pos)
-								    {return s->data->origSeqEnd < pos;};
+				auto cmpBegin = [&nodePairSeqs] (size_t s, int32_t pos)
+								    {return nodePairSeqs[s].origSeqStart < pos;};
+				auto cmpEnd = [&nodePairSeqs] (size_t s, int32_t pos)
+								    {return nodePairSeqs[s].origSeqEnd < pos;};
 				auto startRange = std::lower_bound(ss.begin(), ss.end(),
 												   ovlp.extBegin, cmpEnd);
 				auto endRange = std::lower_bound(ss.begin(), ss.end(),
@@ -831,18 +868,19 @@ void RepeatGraph::initializeEdges(const OverlapContainer& asmOverlaps)
 				if (endRange != ss.end()) ++endRange;
 				for (;startRange != endRange; ++startRange)
 				{
-					auto* setTwo = *startRange;
-					if (findSet(setOne) == findSet(setTwo)) continue;
+					size_t setTwo = *startRange;
+					if (segmentSets.sameSet(setOne, setTwo)) continue;
 
-					int32_t projStart = ovlp.project(setOne->data->origSeqStart);
-					int32_t projEnd = ovlp.project(setOne->data->origSeqEnd);
+					const EdgeSequence& segTwo = nodePairSeqs[setTwo];
+					int32_t projStart = ovlp.project(segOne.origSeqStart);
+					int32_t projEnd = ovlp.project(segOne.origSeqEnd);
 					int32_t projIntersect =
-						segIntersect(*setTwo->data, projStart, projEnd);
+						segIntersect(segTwo, projStart, projEnd);
 
-					if (projIntersect > setOne->data->seqLen / 2 && 
-						projIntersect > setTwo->data->seqLen / 2)
+					if (projIntersect > segOne.seqLen / 2 && 
+						projIntersect > segTwo.seqLen / 2)
 					{
-						unionSet(setOne, setTwo);
+						segmentSets.unionSet(setOne, setTwo);
 					}
 				}
 			}
@@ -926,26 +964,32 @@ void RepeatGraph::initializeEdges(const OverlapContainer& asmOverlaps)
 		}*/
 
 		//sort clusters for determinism
-		std::unordered_map<SetSegment*, 
-						   std::pair<FastaRecord::Id, int32_t>> sortOrder;
-		for (auto& cl : edgeClusters)
+		std::vector<std::pair<FastaRecord::Id, int32_t>> sortOrder;
+		for (size_t cl = 0; cl < edgeClusters.size(); ++cl)
 		{
-			EdgeSequence* minEdge = 
-				*std::min_element(cl.second.begin(), cl.second.end(),
-						  [](EdgeSequence* const e1, EdgeSequence* const e2)
-						     {return std::make_pair(e1->origSeqId, e1->origSeqStart) <
-								     std::make_pair(e2->origSeqId, e2->origSeqStart);});
-			sortOrder[cl.first] = std::make_pair(minEdge->origSeqId, minEdge->origSeqStart);
+			auto minSeg = *std::min_element(edgeClusters[cl].begin(), 
+											edgeClusters[cl].end(),
+						  [&nodePairSeqs](size_t s1, size_t s2)
+						     {return std::make_pair(nodePairSeqs[s1].origSeqId, 
+													nodePairSeqs[s1].origSeqStart) <
+								     std::make_pair(nodePairSeqs[s2].origSeqId, 
+													nodePairSeqs[s2].origSeqStart);});
+			sortOrder.emplace_back(nodePairSeqs[minSeg].origSeqId, 
+								   nodePairSeqs[minSeg].origSeqStart);
 		}
-		std::vector<SetSegment*> sortedKeysCl;
-		for (auto& it : edgeClusters) sortedKeysCl.push_back(it.first);
-		sortByKey(sortedKeysCl, [&sortOrder](SetSegment* const n){return sortOrder[n];});
+		std::vector<size_t> sortedKeysCl;
+		for (size_t cl = 0; cl < edgeClusters.size(); ++cl) sortedKeysCl.push_back(cl);
+		sortByKey(sortedKeysCl, [&sortOrder](const size_t& cl){return sortOrder[cl];});
 
 		//add edge for each cluster
 		std::vector<EdgeSequence> usedSegments;
 		for (auto& clustId : sortedKeysCl)
 		{
-			auto& matchEdges = edgeClusters[clustId];
+			std::vector<EdgeSequence*> matchEdges;
+			for (size_t seg : edgeClusters[clustId]) 
+			{
+				matchEdges.push_back(&nodePairSeqs[seg]);
+			}
 			//filtering segments that were not glued, but covered by overlaps
 			if (edgeClusters.size() > 1 && matchEdges.size() == 1)
 			{
@@ -1067,7 +1111,7 @@ GraphPath RepeatGraph::complementPath(const GraphPath& path) const
 	GraphPath complEdges;
 	for (auto itEdge = path.rbegin(); itEdge != path.rend(); ++itEdge)
 	{
-		complEdges.push_back(_idToEdge.at((*itEdge)->edgeId.rc()));
+		complEdges.push_back(this->complementEdge(*itEdge));
 	}
 
 	assert(!complEdges.empty());
@@ -1076,7 +1120,9 @@ GraphPath RepeatGraph::complementPath(const GraphPath& path) const
 
 GraphEdge* RepeatGraph::complementEdge(GraphEdge* edge) const
 {
-	return _idToEdge.at(edge->edgeId.rc());
+	GraphEdge* complEdge = this->getEdge(edge->edgeId.rc());
+	if (!complEdge) throw std::out_of_range("Complementary edge not found");
+	return complEdge;
 }
 
 GraphNode* RepeatGraph::complementNode(GraphNode* node) const
@@ -1101,27 +1147,44 @@ void RepeatGraph::storeGraph(const std::string& filename)
 		nodeIds[node] = nextNodeId++;
 	}
 
-	std::ofstream fout(filename);
-	if (!fout)
+	SeqNameTable edgeSeqNames;
+	size_t numEdges = 0;
+	for (auto& edge : this->iterEdges())
 	{
-		throw std::runtime_error("Can't open "  + filename);
+		++numEdges;
+		for (auto& seg : edge->seqSegments) edgeSeqNames.addId(seg.edgeSeqId);
 	}
 
+	BinaryDumpWriter writer(filename, DumpFormat::GRAPH_MAGIC);
+	edgeSeqNames.write(writer, *_edgeSeqsContainer);
+	writer.write<uint64_t>(numEdges);
 	for (auto& edge : this->iterEdges())
 	{
-		fout << "Edge\t" << edge->edgeId << "\t" 
-			<< nodeIds[edge->nodeLeft] << "\t" << nodeIds[edge->nodeRight]
-			<< "\t" << edge->repetitive << "\t" << edge->selfComplement 
-			<< "\t" << edge->resolved << "\t" << edge->meanCoverage 
-			<< "\t" << edge->altGroupId << "\n";
+		EdgeRecord edgeRec = {};
+		edgeRec.edgeId = edge->edgeId.rawId();
+		edgeRec.leftNode = nodeIds[edge->nodeLeft];
+		edgeRec.rightNode = nodeIds[edge->nodeRight];
+		edgeRec.numSegments = edge->seqSegments.size();
+		edgeRec.meanCoverage = edge->meanCoverage;
+		edgeRec.altGroupId = edge->altGroupId;
+		edgeRec.repetitive = edge->repetitive;
+		edgeRec.selfComplement = edge->selfComplement;
+		edgeRec.resolved = edge->resolved;
+		writer.write(edgeRec);
 
 		for (auto& seg : edge->seqSegments)
 		{
-			fout << "\tSequence\t";
-			seg.dump(fout, *_edgeSeqsContainer);
-			fout << "\n";
+			SegmentRecord segRec = {};
+			segRec.seqName = edgeSeqNames.getIndex(seg.edgeSeqId);
+			segRec.seqLen = seg.seqLen;
+			segRec.origSeqId = seg.origSeqId.rawId();
+			segRec.origSeqLen = seg.origSeqLen;
+			segRec.origSeqStart = seg.origSeqStart;
+			segRec.origSeqEnd = seg.origSeqEnd;
+			writer.write(segRec);
 		}
 	}
+	writer.close();
 }
 
 void RepeatGraph::validateGraph()
@@ -1167,7 +1230,7 @@ void RepeatGraph::validateGraph()
 	{
 		for (GraphEdge* edge : node->outEdges)
 		{
-			if (!_idToEdge.count(edge->edgeId.rc())) 
+			if (!this->getEdge(edge->edgeId.rc())) 
 			{
 				Logger::get().warning() << "Edge " + std::to_string(edge->edgeId.signedId()) 
 										 + " not paired";
@@ -1175,7 +1238,7 @@ void RepeatGraph::validateGraph()
 		}
 		for (GraphEdge* edge : node->inEdges)
 		{
-			if (!_idToEdge.count(edge->edgeId.rc())) 
+			if (!this->getEdge(edge->edgeId.rc())) 
 			{
 				Logger::get().warning() << "Edge " + std::to_string(edge->edgeId.signedId()) 
 										 + " not paired";
@@ -1248,6 +1311,59 @@ void RepeatGraph::validateGraph()
 }
 
 void RepeatGraph::loadGraph(const std::string& filename)
+{
+	if (!BinaryDumpReader::isBinaryDump(filename, DumpFormat::GRAPH_MAGIC))
+	{
+		this->loadGraphText(filename);
+		return;
+	}
+
+	BinaryDumpReader reader(filename, DumpFormat::GRAPH_MAGIC);
+	SeqNameTable edgeSeqNames;
+	edgeSeqNames.read(reader, *_edgeSeqsContainer);
+
+	std::unordered_map<size_t, GraphNode*> idToNode;
+	auto getNode = [this, &idToNode](size_t nodeId)
+	{
+		auto it = idToNode.find(nodeId);
+		if (it != idToNode.end()) return it->second;
+		GraphNode* node = this->addNode();
+		idToNode[nodeId] = node;
+		return node;
+	};
+
+	uint64_t numEdges = reader.read<uint64_t>();
+	for (uint64_t i = 0; i < numEdges; ++i)
+	{
+		auto edgeRec = reader.read<EdgeRecord>();
+		GraphNode* leftNode = getNode(edgeRec.leftNode);
+		GraphNode* rightNode = getNode(edgeRec.rightNode);
+
+		GraphEdge edge(leftNode, rightNode, FastaRecord::Id(edgeRec.edgeId));
+		edge.repetitive = edgeRec.repetitive;
+		edge.selfComplement = edgeRec.selfComplement;
+		edge.resolved = edgeRec.resolved;
+		edge.meanCoverage = edgeRec.meanCoverage;
+		edge.altGroupId = edgeRec.altGroupId;
+		if (edge.altGroupId != -1) edge.altHaplotype = true;
+
+		edge.seqSegments.reserve(edgeRec.numSegments);
+		for (uint32_t j = 0; j < edgeRec.numSegments; ++j)
+		{
+			auto segRec = reader.read<SegmentRecord>();
+			EdgeSequence seg(edgeSeqNames.getId(segRec.seqName), segRec.seqLen);
+			seg.origSeqId = FastaRecord::Id(segRec.origSeqId);
+			seg.origSeqLen = segRec.origSeqLen;
+			seg.origSeqStart = segRec.origSeqStart;
+			seg.origSeqEnd = segRec.origSeqEnd;
+			edge.seqSegments.push_back(seg);
+		}
+		this->addEdge(std::move(edge));
+	}
+}
+
+//loads the graph dump in the text format, produced by the older versions
+void RepeatGraph::loadGraphText(const std::string& filename)
 {
 	std::ifstream fin(filename);
 	if (!fin)
@@ -1358,13 +1474,44 @@ void RepeatGraph::updateEdgeSequences()
 	_edgeSeqsContainer->buildPositionIndex();
 }
 
-RepeatGraph::~RepeatGraph()
+const size_t RepeatGraph::NO_SLOT;
+
+void RepeatGraph::compactLists()
 {
-	std::unordered_set<GraphEdge*> toRemove;
-	for (auto& edge : this->iterEdges()) toRemove.insert(edge);
-	for (auto& edge : _deletedEdges) toRemove.insert(edge);
-	for (auto edge : toRemove) delete edge;
+	//compact once tombstones take more than a half of the list
+	const size_t MIN_COMPACT = 1024;
+	if (_deletedListEdges > MIN_COMPACT && 
+		_deletedListEdges * 2 > _edgeList.size())
+	{
+		_edgeList.erase(std::remove(_edgeList.begin(), _edgeList.end(), nullptr),
+						_edgeList.end());
+		_deletedListEdges = 0;
+		_edgeListSorted = false;	//re-sorting also updates the slots
+	}
+	if (!_edgeListSorted)
+	{
+		_edgeList.erase(std::remove(_edgeList.begin(), _edgeList.end(), nullptr),
+						_edgeList.end());
+		std::sort(_edgeList.begin(), _edgeList.end(),
+				  [](GraphEdge* e1, GraphEdge* e2)
+				  {return e1->edgeId.rawId() < e2->edgeId.rawId();});
+		for (size_t i = 0; i < _edgeList.size(); ++i)
+		{
+			_edgeSlots[_edgeList[i]->edgeId.rawId()] = i;
+		}
+		_deletedListEdges = 0;
+		_edgeListSorted = true;
+	}
 
-	for (auto node : _graphNodes) delete node;
-	for (auto node : _deletedNodes) delete node;
+	if (_deletedListNodes > MIN_COMPACT && 
+		_deletedListNodes * 2 > _nodeList.size())
+	{
+		_nodeList.erase(std::remove(_nodeList.begin(), _nodeList.end(), nullptr),
+						_nodeList.end());
+		for (size_t i = 0; i < _nodeList.size(); ++i)
+		{
+			_nodeSlots[_nodeList[i]->nodeId] = i;
+		}
+		_deletedListNodes = 0;
+	}
 }
@@ -6,6 +6,8 @@
 
 #include <list>
 #include <set>
+#include <deque>
+#include <limits>
 
 #include "../sequence/sequence_container.h"
 #include "../sequence/overlap.h"
@@ -246,9 +248,12 @@ class RepeatGraph
 public:
 	RepeatGraph(const SequenceContainer& asmSeqs, SequenceContainer* graphSeqs):
 		 _nextEdgeId(0), _nextNodeId(0), _asmSeqs(asmSeqs), 
-		 _edgeSeqsContainer(graphSeqs)
+		 _edgeSeqsContainer(graphSeqs), _activeIterators(0),
+		 _deletedListEdges(0), _deletedListNodes(0), _edgeListSorted(true)
 	{}
-	~RepeatGraph();
+
+	RepeatGraph(const RepeatGraph&) = delete;
+	void operator=(const RepeatGraph&) = delete;
 
 	void build(bool keepHaplotypes);
 	void updateEdgeSequences();
@@ -261,29 +266,100 @@ public:
 	GraphEdge* complementEdge(GraphEdge* edge) const;
 	GraphNode* complementNode(GraphNode* node) const;
 
-	//nodes
-	GraphNode* addNode()
+	//Iterates over the list of nodes / edges, skipping the removed ones.
+	//Iterator is index-based and returns the current element by value,
+	//so the graph could be modified during the iteration. Elements 
+	//that are added during the iteration are visited as well.
+	template <class T>
+	class ListIterator
 	{
-		GraphNode* node = new GraphNode(_nextNodeId);
-		_graphNodes.insert(node);
-		++_nextNodeId;
-		return node;
-	}
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef T* value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef T* const* pointer;
+		typedef T* const& reference;
+
+		ListIterator(const std::vector<T*>& list, size_t index):
+			_list(&list), _index(index), _current(nullptr)
+		{
+			this->skipRemoved();
+		}
+
+		reference operator*() const {return _current;}
+
+		ListIterator& operator++()
+		{
+			++_index;
+			this->skipRemoved();
+			return *this;
+		}
+
+		bool operator==(const ListIterator& other) const
+		{
+			bool atEnd = _index >= _list->size();
+			bool otherAtEnd = other._index >= other._list->size();
+			return (atEnd && otherAtEnd) || _index == other._index;
+		}
+		bool operator!=(const ListIterator& other) const
+		{
+			return !(*this == other);
+		}
+
+	private:
+		void skipRemoved()
+		{
+			while (_index < _list->size() && !(*_list)[_index]) ++_index;
+			_current = _index < _list->size() ? (*_list)[_index] : nullptr;
+		}
 
-	class IterNodes
+		const std::vector<T*>* _list;
+		size_t _index;
+		T* _current;
+	};
+
+	//Removed nodes / edges leave tombstones in the lists, which are
+	//compacted once there are too many of them. Compaction only happens
+	//when a new iteration starts and no other iteration is in progress
+	template <class T>
+	class IterList
 	{
 	public:
-		IterNodes(RepeatGraph& graph): _graph(graph) {}
+		IterList(RepeatGraph& graph, const std::vector<T*>& list): 
+			_graph(graph), _list(list)
+		{
+			if (_graph._activeIterators == 0) _graph.compactLists();
+			++_graph._activeIterators;
+		}
+		IterList(const IterList& other): 
+			_graph(other._graph), _list(other._list)
+		{
+			++_graph._activeIterators;
+		}
+		~IterList() {--_graph._activeIterators;}
+
+		ListIterator<T> begin() {return ListIterator<T>(_list, 0);}
+		ListIterator<T> end() 
+			{return ListIterator<T>(_list, std::numeric_limits<size_t>::max());}
 
-		std::unordered_set<GraphNode*>::iterator begin() 
-			{return _graph._graphNodes.begin();}
-		std::unordered_set<GraphNode*>::iterator end() 
-			{return _graph._graphNodes.end();}
-	
 	private:
 		RepeatGraph& _graph;
+		const std::vector<T*>& _list;
 	};
-	IterNodes iterNodes() {return IterNodes(*this);}
+
+	//nodes
+	GraphNode* addNode()
+	{
+		_nodeArena.emplace_back(_nextNodeId);
+		GraphNode* node = &_nodeArena.back();
+		_nodeSlots.push_back(_nodeList.size());
+		_nodeList.push_back(node);
+		++_nextNodeId;
+		return node;
+	}
+
+	typedef IterList<GraphNode> IterNodes;
+	IterNodes iterNodes() {return IterNodes(*this, _nodeList);}
 	//
 	
 	//edges
@@ -294,14 +370,30 @@ public:
 			throw std::runtime_error("Adding edge with duplicated id");
 		}
 
-		GraphEdge* newEdge = new GraphEdge(edge);
+		_edgeArena.push_back(edge);
+		GraphEdge* newEdge = &_edgeArena.back();
 		newEdge->nodeLeft->outEdges.push_back(newEdge);
 		newEdge->nodeRight->inEdges.push_back(newEdge);
-		_sortedEdges.insert(newEdge);
-		_idToEdge[newEdge->edgeId] = newEdge;
+
+		size_t maxId = std::max(newEdge->edgeId.rawId(), 
+								newEdge->edgeId.rc().rawId());
+		if (_idToEdge.size() <= maxId)
+		{
+			_idToEdge.resize(maxId + 1, nullptr);
+			_edgeSlots.resize(maxId + 1, NO_SLOT);
+		}
+		if (!_edgeList.empty() && _edgeList.back() &&
+			_edgeList.back()->edgeId.rawId() > newEdge->edgeId.rawId())
+		{
+			_edgeListSorted = false;
+		}
+		_edgeSlots[newEdge->edgeId.rawId()] = _edgeList.size();
+		_edgeList.push_back(newEdge);
+
+		_idToEdge[newEdge->edgeId.rawId()] = newEdge;
 		if (newEdge->selfComplement)
 		{
-			_idToEdge[newEdge->edgeId.rc()] = newEdge;
+			_idToEdge[newEdge->edgeId.rc().rawId()] = newEdge;
 		}
 		return newEdge;
 	}
@@ -310,35 +402,20 @@ public:
 		return _idToEdge.count(edge->edgeId);
 		//return _sortedEdges.count(edge);
 	}*/
-	GraphEdge* getEdge(FastaRecord::Id edgeId)
+	GraphEdge* getEdge(FastaRecord::Id edgeId) const
 	{
-		if (_idToEdge.count(edgeId)) return _idToEdge[edgeId];
+		if (edgeId.rawId() < _idToEdge.size()) return _idToEdge[edgeId.rawId()];
 		return nullptr;
 	}
-	class IterEdges
-	{
-	public:
-		IterEdges(RepeatGraph& graph): _graph(graph) {}
 
-		std::set<GraphEdge*>::iterator begin() 
-			{return _graph._sortedEdges.begin();}
-		std::set<GraphEdge*>::iterator end() 
-			{return _graph._sortedEdges.end();}
-	
-	private:
-		RepeatGraph& _graph;
-	};
-
-	IterEdges iterEdges() {return IterEdges(*this);}
+	typedef IterList<GraphEdge> IterEdges;
+	IterEdges iterEdges() {return IterEdges(*this, _edgeList);}
 
 	void removeEdge(GraphEdge* edge)
 	{
 		vecRemove(edge->nodeRight->inEdges, edge);
 		vecRemove(edge->nodeLeft->outEdges, edge);
-		_sortedEdges.erase(edge);
-		_idToEdge.erase(edge->edgeId);
-		_deletedEdges.insert(edge);
-		//delete edge;
+		this->unlistEdge(edge);
 	}
 
 	void removeNode(GraphNode* node)
@@ -356,14 +433,16 @@ public:
 		}
 		for (auto& edge : toRemove)
 		{
-			_sortedEdges.erase(edge);
-			_idToEdge.erase(edge->edgeId);
-			_deletedEdges.insert(edge);
-			//delete edge;
+			this->unlistEdge(edge);
+		}
+
+		size_t& slot = _nodeSlots[node->nodeId];
+		if (slot != NO_SLOT)
+		{
+			_nodeList[slot] = nullptr;
+			slot = NO_SLOT;
+			++_deletedListNodes;
 		}
-		_graphNodes.erase(node);
-		_deletedNodes.insert(node);
-		//delete node;
 	}
 
 	//
@@ -411,6 +490,8 @@ public:
 	}
 
 private:
+	void loadGraphText(const std::string& filename);
+
 	size_t _nextEdgeId;
 	size_t _nextNodeId;
 
@@ -451,15 +532,40 @@ private:
 	std::unordered_map<FastaRecord::Id, 
 					   std::vector<GluePoint>> _gluePoints;
 
-	std::unordered_map<FastaRecord::Id, GraphEdge*> _idToEdge;
-	std::unordered_set<GraphEdge*> _deletedEdges;
-	std::unordered_set<GraphNode*> _graphNodes;
-	std::unordered_set<GraphNode*> _deletedNodes;
-
-	struct CmpId 
+	//removes the edge from the id index and the edge list
+	void unlistEdge(GraphEdge* edge)
 	{
-		bool operator() (GraphEdge* const &e1, GraphEdge* const &e2) const
-		{return e1->edgeId < e2->edgeId;}
-	};
-	std::set<GraphEdge*, CmpId> _sortedEdges;
+		size_t rawId = edge->edgeId.rawId();
+		if (this->getEdge(edge->edgeId) != edge) return;	//already removed
+
+		_idToEdge[rawId] = nullptr;
+		_edgeList[_edgeSlots[rawId]] = nullptr;
+		_edgeSlots[rawId] = NO_SLOT;
+		++_deletedListEdges;
+	}
+	void compactLists();
+
+	//Nodes and edges are allocated in arenas and are never freed
+	//until the graph is destroyed, since removed edges might still be
+	//referenced (for example, from the read alignments).
+	std::deque<GraphEdge> _edgeArena;
+	std::deque<GraphNode> _nodeArena;
+
+	static const size_t NO_SLOT = std::numeric_limits<size_t>::max();
+
+	//edges indexed by the raw id (both strands for self-complements)
+	std::vector<GraphEdge*> _idToEdge;
+
+	//lists used for iteration, removed elements are set to nullptr.
+	//Edges are sorted by id, nodes are in the order of addition.
+	//Slots give the position in the list by edge raw id / node id
+	std::vector<GraphEdge*> _edgeList;
+	std::vector<size_t>		_edgeSlots;
+	std::vector<GraphNode*> _nodeList;
+	std::vector<size_t>		_nodeSlots;
+
+	int    _activeIterators;
+	size_t _deletedListEdges;
+	size_t _deletedListNodes;
+	bool   _edgeListSorted;
 };
@@ -943,20 +943,20 @@ int RepeatResolver::resolveSimpleRepeats()
 			GraphEdge* edge;
 			bool isEntrance;
 		};
-		typedef SetNode<EdgeDir> SetElement;
-		SetVec<EdgeDir> allElements;
-		std::unordered_map<GraphEdge*, SetElement*> inputElements;
-		std::unordered_map<GraphEdge*, SetElement*> outputElements;
+		std::vector<EdgeDir> allElements;
+		std::unordered_map<GraphEdge*, size_t> inputElements;
+		std::unordered_map<GraphEdge*, size_t> outputElements;
 		for (GraphEdge* edge : inputs) 
 		{
-			allElements.push_back(new SetElement({edge, true}));
-			inputElements[edge] = allElements.back();
+			inputElements[edge] = allElements.size();
+			allElements.push_back({edge, true});
 		}
 		for (GraphEdge* edge : outputs) 
 		{
-			allElements.push_back(new SetElement({edge, false}));
-			outputElements[edge] = allElements.back();
+			outputElements[edge] = allElements.size();
+			allElements.push_back({edge, false});
 		}
+		DisjointSet elementSets(allElements.size());
 
 		//grouping edges if they are connected by reads
 		for (GraphEdge* inEdge : inputs)
@@ -965,13 +965,13 @@ int RepeatResolver::resolveSimpleRepeats()
 			{
 				if (outEdge.second >= MIN_JCT_SUPPORT)
 				{
-					unionSet(inputElements[inEdge], 
-							 outputElements[outEdge.first]);
+					elementSets.unionSet(inputElements[inEdge], 
+										 outputElements[outEdge.first]);
 				}
 			}
 		}
 
-		auto clusters = groupBySet(allElements);
+		auto clusters = groupBySet(elementSets);
 		/*if (clusters.size() > 1)
 		{
 			Logger::get().debug() << "Split edge mult:" 
@@ -989,13 +989,15 @@ int RepeatResolver::resolveSimpleRepeats()
 				}
 			}
 		}*/
-		for (auto& cl : clusters)
+		for (size_t cl = 0; cl < clusters.size(); ++cl)
 		{
-			if (cl.second.size() == 2)
+			if (clusters[cl].size() == 2)
 			{
-				GraphEdge* inputConn = cl.second[0].edge;
-				GraphEdge* outputConn = cl.second[1].edge;
-				if (!cl.second[0].isEntrance)
+				const EdgeDir& firstElem = allElements[clusters[cl][0]];
+				const EdgeDir& secondElem = allElements[clusters[cl][1]];
+				GraphEdge* inputConn = firstElem.edge;
+				GraphEdge* outputConn = secondElem.edge;
+				if (!firstElem.isEntrance)
 				{
 					std::swap(inputConn, outputConn);
 				}
@@ -7,12 +7,10 @@
 #include <fstream>
 
 #include "consensus_generator.h"
-#include "../sequence/alignment.h"
 
 #include "../common/config.h"
 #include "../common/logger.h"
 #include "../common/parallel.h"
-#include "../common/matrix.h"
 
 
 std::vector<FastaRecord> 
@@ -20,187 +18,243 @@ std::vector<FastaRecord>
 											bool verbose)
 {
 	if (verbose) Logger::get().info() << "Generating sequence";
-	std::vector<std::vector<AlignmentInfo>> allAlignments;
-	std::vector<FastaRecord> consensuses;
 
-	auto alnMap = this->generateAlignments(contigs, verbose);
-	//then, generate contig sequences
-	for (size_t i = 0; i < contigs.size(); ++i)
+	//number of overlaps that are aligned (and kept) at once
+	const size_t WINDOW_SIZE = std::max((size_t)256, 
+										16 * Parameters::get().numThreads);
+
+	size_t totalOverlaps = 0;
+	for (auto& path : contigs)
 	{
-		if (contigs[i].sequences.empty()) continue;
-		if (contigs[i].sequences.size() == 1)
+		if (path.sequences.size() > 1) totalOverlaps += path.sequences.size() - 1;
+	}
+	ProgressPercent progress(totalOverlaps);
+
+	std::vector<FastaRecord> contigSeqs(contigs.size());
+	std::vector<AlignmentJob> window;
+	window.reserve(WINDOW_SIZE);
+	ContigStitcher stitcher;
+	for (size_t contigId = 0; contigId < contigs.size(); ++contigId)
+	{
+		const ContigPath& path = contigs[contigId];
+		if (path.sequences.size() == 1)
 		{
-			FastaRecord rec(contigs[i].sequences.front(), contigs[i].name, 
-							FastaRecord::ID_NONE);
-			consensuses.push_back(rec);
+			contigSeqs[contigId] = FastaRecord(path.sequences.front(), path.name, 
+											   FastaRecord::ID_NONE);
+			continue;
 		}
-		else
+
+		//adjusted overlaps only depend on the previous adjusted
+		//overlap, and not on the alignments
+		int32_t prevOverlapStart = 0;
+		for (size_t i = 0; i + 1 < path.sequences.size(); ++i)
 		{
-			consensuses.push_back(this->generateLinear(contigs[i], alnMap));
+			OverlapRange curOverlap = this->adjustOverlap(path.overlaps[i],
+														  prevOverlapStart);
+			prevOverlapStart = curOverlap.extBegin;
+			window.push_back({contigId, i, curOverlap, {}});
+			if (window.size() == WINDOW_SIZE)
+			{
+				if (verbose) progress.advance(window.size());
+				this->alignWindow(window, contigs, stitcher, contigSeqs);
+			}
 		}
 	}
+	if (!window.empty())
+	{
+		if (verbose) progress.advance(window.size());
+		this->alignWindow(window, contigs, stitcher, contigSeqs);
+	}
+
+	std::vector<FastaRecord> consensuses;
+	for (size_t i = 0; i < contigs.size(); ++i)
+	{
+		if (contigs[i].sequences.empty()) continue;
+		consensuses.push_back(std::move(contigSeqs[i]));
+	}
 	return consensuses;
 }
 
 
-FastaRecord ConsensusGenerator::generateLinear(const ContigPath& path, 
-											   const AlignmentsMap& alnMap)
+//aligns the window of overlaps in parallel, then advances the
+//stitching of the corresponding contigs in the path order
+void ConsensusGenerator::alignWindow(std::vector<AlignmentJob>& window,
+									 const std::vector<ContigPath>& contigs,
+									 ContigStitcher& stitcher,
+									 std::vector<FastaRecord>& contigSeqs)
 {
-	std::vector<FastaRecord> contigParts;
-
-	//Logger::get().debug() << "Stitching " << path.name;
+	std::vector<size_t> jobIds(window.size());
+	for (size_t i = 0; i < jobIds.size(); ++i) jobIds[i] = i;
+	std::function<void(const size_t&)> alignFunc =
+	[&window, &contigs] (const size_t& jobId)
+	{
+		AlignmentJob& job = window[jobId];
+		const ContigPath& path = contigs[job.contigId];
+		const float maxErr = 0.3;
+		getAlignmentCigarKsw(path.sequences[job.seqId], job.overlap.curBegin, 
+							 job.overlap.curRange(),
+							 path.sequences[job.seqId + 1], job.overlap.extBegin, 
+							 job.overlap.extRange(), maxErr, job.cigar);
+	};
+	processInParallel(jobIds, alignFunc, Parameters::get().numThreads, false);
 
-	auto prevSwitch = std::make_pair(0, 0);
-	std::string contigSequence;
-	for (size_t i = 0; i < path.sequences.size(); ++i)
+	for (auto& job : window)
 	{
-		auto& sequence = path.sequences[i];
-		int32_t leftCut = prevSwitch.second;
-		int32_t rightCut = sequence.length();
-		if (i != path.sequences.size() - 1)
+		const ContigPath& path = contigs[job.contigId];
+		if (stitcher.path != &path)
 		{
-			auto curSwitch = 
-				this->getSwitchPositions(alnMap.at(&path.overlaps[i]),
-										 prevSwitch.second);
-			rightCut = curSwitch.first;
-			prevSwitch = curSwitch;
+			stitcher = ContigStitcher();
+			stitcher.path = &path;
+			stitcher.contigId = job.contigId;
 		}
 
-		if (rightCut - leftCut > 0)	//shoudn't happen, but just in case
+		auto curSwitch = 
+			this->getSwitchPositions(job.cigar, job.overlap.curBegin,
+									 job.overlap.extBegin, 
+									 stitcher.prevSwitch.second);
+		this->addPiece(stitcher, curSwitch.first);
+		stitcher.prevSwitch = curSwitch;
+
+		//last overlap of the contig
+		if (job.seqId + 2 == path.sequences.size())
 		{
-			contigSequence += sequence.substr(leftCut, rightCut - leftCut).str();
-			//Logger::get().debug() << "\tPiece " << sequence.length() << " " 
-			//	<< leftCut << " " << rightCut << " " << rightCut - path.overlaps[i].curBegin;
+			this->addPiece(stitcher, path.sequences.back().length());
+			contigSeqs[stitcher.contigId] = this->stitchContig(stitcher);
+			stitcher = ContigStitcher();
 		}
 	}
-	int32_t cutLen = contigSequence.length() - (path.trimLeft + path.trimRight);
-	if (cutLen > 0)
+	window.clear();
+}
+
+
+void ConsensusGenerator::addPiece(ContigStitcher& stitcher, int32_t rightCut)
+{
+	const DnaSequence& sequence = stitcher.path->sequences[stitcher.nextSeq++];
+	int32_t leftCut = stitcher.prevSwitch.second;
+	if (rightCut - leftCut > 0)	//shoudn't happen, but just in case
 	{
-		contigSequence = contigSequence.substr(path.trimLeft, cutLen);
+		stitcher.pieces.push_back({&sequence, leftCut, rightCut});
+		stitcher.contigLength += rightCut - leftCut;
+		//Logger::get().debug() << "\tPiece " << sequence.length() << " " 
+		//	<< leftCut << " " << rightCut;
 	}
-	return FastaRecord(DnaSequence(contigSequence), path.name, 
-					   FastaRecord::ID_NONE);
 }
 
 
-ConsensusGenerator::AlignmentsMap 
-	ConsensusGenerator::generateAlignments(const std::vector<ContigPath>& contigs,
-										   bool verbose)
+FastaRecord ConsensusGenerator::stitchContig(ContigStitcher& stitcher)
 {
-	//typedef std::pair<const ContigPath*, size_t> AlnTask;
-	struct AlnTask
-	{
-		const ContigPath* path;
-		size_t contigId;
-		OverlapRange adjustedOverlap;
-	};
+	const ContigPath& path = *stitcher.path;
 
-	AlignmentsMap alnMap;
-	std::mutex mapMutex;
-	std::function<void(const AlnTask&)> alnFunc =
-	[&alnMap, &mapMutex](const AlnTask& task)
+	//trimming is applied while copying the pieces, so the
+	//contig sequence is only built once
+	int64_t outBegin = 0;
+	int64_t outEnd = stitcher.contigLength;
+	int64_t cutLen = stitcher.contigLength - (path.trimLeft + path.trimRight);
+	if (cutLen > 0)
 	{
-		const ContigPath* path = task.path;
-		size_t i = task.contigId;
-		auto curOverlap = task.adjustedOverlap;
-
-		std::vector<CigOp> cigar;
-		const float maxErr = 0.3;
-		std::string alignedLeft;
-		std::string alignedRight;
-		getAlignmentCigarKsw(path->sequences[i], curOverlap.curBegin, curOverlap.curRange(),
-			   			     path->sequences[i + 1], curOverlap.extBegin, curOverlap.extRange(),
-			   			   	 maxErr, cigar);
-		decodeCigar(cigar, path->sequences[i], curOverlap.curBegin,
-				 	path->sequences[i + 1], curOverlap.extBegin,
-				 	alignedLeft, alignedRight);
+		outBegin = path.trimLeft;
+		outEnd = path.trimLeft + cutLen;
+	}
 
+	std::string contigSequence;
+	contigSequence.reserve(outEnd - outBegin);
+	int64_t piecePos = 0;
+	for (auto& piece : stitcher.pieces)
+	{
+		int64_t pieceLen = piece.rightCut - piece.leftCut;
+		int64_t copyBegin = std::max(piecePos, outBegin);
+		int64_t copyEnd = std::min(piecePos + pieceLen, outEnd);
+		if (copyEnd > copyBegin)
 		{
-			std::lock_guard<std::mutex> lock(mapMutex);
-			alnMap[&path->overlaps[i]] = {alignedLeft, alignedRight, 
-						 				  curOverlap.curBegin, 
-										  curOverlap.extBegin};
+			contigSequence += piece.sequence->substr(piece.leftCut + copyBegin - 
+													 piecePos, 
+													 copyEnd - copyBegin).str();
 		}
-	};
+		piecePos += pieceLen;
+	}
 
-	std::vector<AlnTask> tasks;
-	for (auto& path : contigs)
-	{
-		int32_t prevSwitch = 0;
-		for (size_t i = 0; i < path.sequences.size() - 1; ++i)
-		{
-			OverlapRange curOverlap = path.overlaps[i];
+	return FastaRecord(DnaSequence(contigSequence), path.name, 
+					   FastaRecord::ID_NONE);
+}
 
-			//don't compute alignment for regions we know will
-			//not be used for stitching
-			int32_t beginShift = prevSwitch - curOverlap.curBegin;
-			if (beginShift > 0 && 
-				beginShift < std::min(curOverlap.curRange(), curOverlap.extRange()))
-			{
-				curOverlap.curBegin += beginShift;
-				curOverlap.extBegin += beginShift;
-			}
-			prevSwitch = curOverlap.extBegin;
-
-			//in case of long reads, only consider last 20k of the overlap to
-			//save memory during pairwise alignmemnt
-			const int32_t MAX_ALIGNMENT = 20000;
-			int32_t endShift = std::min(curOverlap.curRange(), 
-										curOverlap.extRange()) - MAX_ALIGNMENT;
-			if (endShift > 0)
-			{
-				curOverlap.curEnd -= endShift;
-				curOverlap.extEnd -= endShift;
-			}
 
-			tasks.push_back({&path, i, curOverlap});
-		}
+OverlapRange ConsensusGenerator::adjustOverlap(const OverlapRange& overlap,
+											   int32_t prevSwitch)
+{
+	OverlapRange curOverlap = overlap;
+
+	//don't compute alignment for regions we know will
+	//not be used for stitching
+	int32_t beginShift = prevSwitch - curOverlap.curBegin;
+	if (beginShift > 0 && 
+		beginShift < std::min(curOverlap.curRange(), curOverlap.extRange()))
+	{
+		curOverlap.curBegin += beginShift;
+		curOverlap.extBegin += beginShift;
 	}
-	processInParallel(tasks, alnFunc, Parameters::get().numThreads, verbose);
 
-	return alnMap;
+	//in case of long reads, only consider last 20k of the overlap to
+	//save memory during pairwise alignmemnt
+	const int32_t MAX_ALIGNMENT = 20000;
+	int32_t endShift = std::min(curOverlap.curRange(), 
+								curOverlap.extRange()) - MAX_ALIGNMENT;
+	if (endShift > 0)
+	{
+		curOverlap.curEnd -= endShift;
+		curOverlap.extEnd -= endShift;
+	}
+	return curOverlap;
 }
 
 
 std::pair<int32_t, int32_t> 
-ConsensusGenerator::getSwitchPositions(const AlignmentInfo& aln,
+ConsensusGenerator::getSwitchPositions(const std::vector<CigOp>& cigar,
+									   int32_t startOne, int32_t startTwo,
 									   int32_t prevSwitch)
 {
 	const int MIN_SEGMENT = 500;
 	const int MIN_MATCH = 15;
 
-	int leftPos = aln.startOne;
-	int rightPos = aln.startTwo;
+	//walking the CIGAR is equivalent to walking the gapped
+	//alignment strings column by column
+	int leftPos = startOne;
+	int rightPos = startTwo;
 	int matchRun = 0;
-	for (size_t i = 0; i < aln.alnOne.length(); ++i)
+	for (auto& op : cigar)
 	{
-		if (aln.alnOne[i] != '-') ++leftPos;
-		if (aln.alnTwo[i] != '-') ++rightPos;
-
-		if (aln.alnOne[i] != '-' && aln.alnTwo[i] != '-' &&
-			leftPos > prevSwitch + MIN_SEGMENT)
+		if (op.op == '=' || op.op == 'X')
 		{
-			++matchRun;
+			for (int i = 0; i < op.len; ++i)
+			{
+				++leftPos;
+				++rightPos;
+				if (leftPos > prevSwitch + MIN_SEGMENT)
+				{
+					++matchRun;
+				}
+				else
+				{
+					matchRun = 0;
+				}
+				if (matchRun == MIN_MATCH)
+				{
+					return {leftPos, rightPos};
+				}
+			}
 		}
-		else
+		else if (op.op == 'I')
 		{
+			rightPos += op.len;
 			matchRun = 0;
 		}
-		if (matchRun == MIN_MATCH)
+		else
 		{
-			return {leftPos, rightPos};
+			leftPos += op.len;
+			matchRun = 0;
 		}
 	}
 
-	//Logger::get().debug() << "Prev: " << prevSwitch;
-	//for (size_t i = 0; i < aln.alnOne.size() / 100; ++i)
-	//{
-	//	Logger::get().debug() << aln.alnOne.substr(i * 100, 100);
-	//	Logger::get().debug() << aln.alnTwo.substr(i * 100, 100);
-	//	Logger::get().debug() << "";
-	//}
-
 	//Logger::get().info() << "No jump found!";
-	prevSwitch = std::max(prevSwitch + 1, aln.startOne);
-	return {prevSwitch, aln.startTwo};
+	prevSwitch = std::max(prevSwitch + 1, startOne);
+	return {prevSwitch, startTwo};
 }
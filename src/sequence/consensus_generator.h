@@ -10,6 +10,7 @@
 #include <vector>
 
 #include "../sequence/overlap.h"
+#include "../sequence/alignment.h"
 
 
 struct ContigPath
@@ -31,21 +32,50 @@ public:
 							bool verbose = true);
 	
 private:
-	struct AlignmentInfo
+	//Overlaps of all contigs are aligned in windows of bounded size,
+	//in parallel (also within a single long contig). Overlap adjustment
+	//does not depend on the alignments, so it is done beforehand.
+	//Switch points are then taken directly from the CIGARs, in the path
+	//order, and the alignments of the window are discarded. Thus, peak
+	//memory is proportional to a single window
+	struct AlignmentJob
 	{
-		std::string alnOne;
-		std::string alnTwo;
+		size_t contigId;
+		size_t seqId;
+		OverlapRange overlap;
+		std::vector<CigOp> cigar;
+	};
 
-		int32_t startOne;
-		int32_t startTwo;
+	struct SeqPiece
+	{
+		const DnaSequence* sequence;
+		int32_t leftCut;
+		int32_t rightCut;
 	};
-	typedef std::unordered_map<const OverlapRange*, 
-							   AlignmentInfo> AlignmentsMap;
-
-	FastaRecord generateLinear(const ContigPath& path, 
-							   const AlignmentsMap& alnMap);
-	AlignmentsMap generateAlignments(const std::vector<ContigPath>& contigs, 
-									 bool verbose);
-	std::pair<int32_t, int32_t> getSwitchPositions(const AlignmentInfo& aln,
+
+	//stitching state of the contig that is currently processed
+	struct ContigStitcher
+	{
+		ContigStitcher(): path(nullptr), contigId(0), nextSeq(0),
+			contigLength(0), prevSwitch(0, 0) {}
+
+		const ContigPath* path;
+		size_t contigId;
+		size_t nextSeq;
+		int64_t contigLength;
+		std::pair<int32_t, int32_t> prevSwitch;
+		std::vector<SeqPiece> pieces;
+	};
+
+	void alignWindow(std::vector<AlignmentJob>& window, 
+					 const std::vector<ContigPath>& contigs,
+					 ContigStitcher& stitcher,
+					 std::vector<FastaRecord>& contigSeqs);
+	void addPiece(ContigStitcher& stitcher, int32_t rightCut);
+	FastaRecord stitchContig(ContigStitcher& stitcher);
+	OverlapRange adjustOverlap(const OverlapRange& overlap, 
+							   int32_t prevSwitch);
+	std::pair<int32_t, int32_t> getSwitchPositions(const std::vector<CigOp>& cigar,
+												   int32_t startOne, int32_t startTwo,
 												   int32_t prevSwitch);
 };
@@ -102,7 +102,7 @@ public:
 		return _representation < other._representation;
 	}
 
-	size_t numRepr() {return _representation;}
+	size_t numRepr() const {return _representation;}
 
 private:
 	KmerRepr _representation;
@@ -24,6 +24,31 @@
 #include "../common/disjoint_set.h"
 #include "../common/bfcontainer.h"
 
+namespace
+{
+	//Removes k-mer matches that are not needed for the overlap
+	//projection. Inside a run of matches on the same diagonal
+	//the projection is the same shift, so only the ends of each
+	//run are kept. Long repeats are mostly exact, so this keeps
+	//a small fraction of the matches.
+	void compactKmerMatches(std::vector<std::pair<int32_t, int32_t>>& matches)
+	{
+		auto diagonal = [&matches](size_t i)
+			{return matches[i].second - matches[i].first;};
+
+		size_t newSize = 0;
+		for (size_t i = 0; i < matches.size(); ++i)
+		{
+			if (i == 0 || i == matches.size() - 1 ||
+				diagonal(i - 1) != diagonal(i) || 
+				diagonal(i + 1) != diagonal(i))
+			{
+				matches[newSize++] = matches[i];
+			}
+		}
+		matches.resize(newSize);
+	}
+}
 
 //Check if it is a proper overlap
 bool OverlapDetector::overlapTest(const OverlapRange& ovlp,
@@ -92,15 +117,35 @@ namespace
 		vec = std::vector<T>();
 		vec.reserve(newCapacity);
 	}
+
+	struct KmerOccurrence
+	{
+		uint32_t lookupId;
+		int32_t  position;
+		bool	 revComp;
+	};
 }
 
-//This implementation was inspired by Heng Li's minimap2 paper
 //might be used in parallel
 std::vector<OverlapRange> 
 OverlapDetector::getSeqOverlaps(const FastaRecord& fastaRec, 
 								bool forceLocal,
 								OvlpDivStats& divStats,
 								int maxOverlaps) const
+{
+	return std::move(this->getSeqOverlapsBatch({&fastaRec}, forceLocal, 
+											   divStats, maxOverlaps).front());
+}
+
+//This implementation was inspired by Heng Li's minimap2 paper.
+//Overlaps are computed for a batch of sequences: k-mers of the whole batch are
+//deduplicated and the index is queried only once for each distinct k-mer,
+//then the matches are scattered back to the individual sequences
+std::vector<std::vector<OverlapRange>> 
+OverlapDetector::getSeqOverlapsBatch(const std::vector<const FastaRecord*>& records, 
+									 bool forceLocal,
+									 OvlpDivStats& divStats,
+									 int maxOverlaps) const
 {
 	//static std::ofstream fout("../kmers.txt");
 	
@@ -114,19 +159,18 @@ OverlapDetector::getSeqOverlaps(const FastaRecord& fastaRec,
 	static const int GAP_JUMP_THLD = (int)Config::get("chain_gap_jump_threshold");
 	static const int MAX_GAP = (int)Config::get("max_jump_gap");
 
-	//outSuggestChimeric = false;
-	int32_t curLen = fastaRec.sequence.length();
-	std::vector<int32_t> curFilteredPos;
-
 	//cache memory-intensive containers as
 	//many parallel memory allocations slow us down significantly
 	//thread_local std::vector<KmerMatch> vecMatches;
 	thread_local std::vector<KmerMatch> matchesList;
 	thread_local std::vector<int32_t> scoreTable;
 	thread_local std::vector<int32_t> backtrackTable;
+	thread_local std::vector<Kmer> batchKmers;
+	thread_local std::vector<Kmer> distinctKmers;
+	thread_local std::vector<KmerOccurrence> occurrences;
+	thread_local std::vector<VertexIndex::KmerLookup> kmerLookups;
 
 	static ChunkPool<KmerMatch> sharedChunkPool;	//shared accoress threads
-	BFContainer<KmerMatch> vecMatches(sharedChunkPool);
 
 	//speed benchmarks
 	thread_local float timeMemory = 0;
@@ -171,344 +215,402 @@ OverlapDetector::getSeqOverlaps(const FastaRecord& fastaRec,
 		shrinkAndClear(matchesList, 2);
 		shrinkAndClear(scoreTable, 2);
 		shrinkAndClear(backtrackTable, 2);
+		shrinkAndClear(batchKmers, 2);
+		shrinkAndClear(distinctKmers, 2);
+		shrinkAndClear(occurrences, 2);
+		shrinkAndClear(kmerLookups, 2);
 	}
 	timeMemory += std::chrono::duration_cast<std::chrono::duration<float>>
 						(std::chrono::system_clock::now() - timeStart).count();
 	timeStart = std::chrono::system_clock::now();
 
-	for (const auto& curKmerPos : IterKmers(fastaRec.sequence))
+	//collect k-mers of all sequences in the batch
+	std::vector<size_t> readOffsets;
+	batchKmers.clear();
+	occurrences.clear();
+	for (const FastaRecord* record : records)
 	{
-		if (_vertexIndex.isRepetitive(curKmerPos.kmer))
+		readOffsets.push_back(occurrences.size());
+		for (const auto& curKmerPos : IterKmers(record->sequence))
 		{
-			curFilteredPos.push_back(curKmerPos.position);
-			continue;
+			Kmer stdKmer = curKmerPos.kmer;
+			bool revComp = stdKmer.standardForm();
+			batchKmers.push_back(stdKmer);
+			occurrences.push_back({0, curKmerPos.position, revComp});
 		}
-		if (!_vertexIndex.kmerFreq(curKmerPos.kmer)) continue;
+	}
+	readOffsets.push_back(occurrences.size());
+
+	auto kmerLess = [](const Kmer& k1, const Kmer& k2)
+						{return k1.numRepr() < k2.numRepr();};
+	distinctKmers = batchKmers;
+	std::sort(distinctKmers.begin(), distinctKmers.end(), kmerLess);
+	distinctKmers.erase(std::unique(distinctKmers.begin(), distinctKmers.end()),
+						distinctKmers.end());
+	for (size_t i = 0; i < occurrences.size(); ++i)
+	{
+		occurrences[i].lookupId = 
+			std::lower_bound(distinctKmers.begin(), distinctKmers.end(),
+							 batchKmers[i], kmerLess) - distinctKmers.begin();
+	}
+	_vertexIndex.lookupKmers(distinctKmers, kmerLookups);
 
-		//FastaRecord::Id prevSeqId = FastaRecord::ID_NONE;
-		for (const auto& extReadPos : _vertexIndex.iterKmerPos(curKmerPos.kmer))
+	std::vector<std::vector<OverlapRange>> batchOverlaps;
+	batchOverlaps.reserve(records.size());
+	for (size_t recIdx = 0; recIdx < records.size(); ++recIdx)
+	{
+		const FastaRecord& fastaRec = *records[recIdx];
+		//outSuggestChimeric = false;
+		int32_t curLen = fastaRec.sequence.length();
+		std::vector<int32_t> curFilteredPos;
+		BFContainer<KmerMatch> vecMatches(sharedChunkPool);
+
+		//position arrays are prefetched a few k-mers ahead
+		const size_t PREFETCH_DIST = 8;
+		for (size_t occId = readOffsets[recIdx]; 
+			 occId < readOffsets[recIdx + 1]; ++occId)
 		{
-			//no trivial matches
-			if ((extReadPos.readId == fastaRec.id &&
-				extReadPos.position == curKmerPos.position)) continue;
-
-			vecMatches.emplace_back(curKmerPos.position, 
-									extReadPos.position,
-									extReadPos.readId);
-		}
-	}
-	timeKmerIndexFirst += std::chrono::duration_cast<std::chrono::duration<float>>
-							(std::chrono::system_clock::now() - timeStart).count();
-	timeStart = std::chrono::system_clock::now();
+			if (occId + PREFETCH_DIST < readOffsets[recIdx + 1])
+			{
+				_vertexIndex.prefetchKmerPos(kmerLookups[occurrences[occId + 
+											 PREFETCH_DIST].lookupId]);
+			}
+			const auto& occurrence = occurrences[occId];
+			const auto& lookup = kmerLookups[occurrence.lookupId];
+			if (lookup.repetitive)
+			{
+				curFilteredPos.push_back(occurrence.position);
+				continue;
+			}
 
-	std::sort(vecMatches.begin(), vecMatches.end(),
-			  [](const KmerMatch& k1, const KmerMatch& k2)
-			  {return k1.extId != k2.extId ? k1.extId < k2.extId : 
-			  								 k1.curPos < k2.curPos;});
+			//FastaRecord::Id prevSeqId = FastaRecord::ID_NONE;
+			for (const auto& extReadPos : 
+				 _vertexIndex.iterKmerPos(lookup, occurrence.revComp))
+			{
+				//no trivial matches
+				if ((extReadPos.readId == fastaRec.id &&
+					extReadPos.position == occurrence.position)) continue;
 
-	timeKmerIndexSecond += std::chrono::duration_cast<std::chrono::duration<float>>
+				vecMatches.emplace_back(occurrence.position, 
+										extReadPos.position,
+										extReadPos.readId);
+			}
+		}
+		timeKmerIndexFirst += std::chrono::duration_cast<std::chrono::duration<float>>
 								(std::chrono::system_clock::now() - timeStart).count();
-	timeStart = std::chrono::system_clock::now();
+		timeStart = std::chrono::system_clock::now();
 
-	const int STAT_WND = 10000;
-	std::vector<OverlapRange> divStatWindows(curLen / STAT_WND + 1);
+		std::sort(vecMatches.begin(), vecMatches.end(),
+				  [](const KmerMatch& k1, const KmerMatch& k2)
+				  {return k1.extId != k2.extId ? k1.extId < k2.extId : 
+				  								 k1.curPos < k2.curPos;});
 
-	std::vector<OverlapRange> detectedOverlaps;
-	size_t extRangeBegin = 0;
-	size_t extRangeEnd = 0;
-	while(extRangeEnd < vecMatches.size())
-	{
-		if (maxOverlaps != 0 &&
-			detectedOverlaps.size() >= (size_t)maxOverlaps) break;
+		timeKmerIndexSecond += std::chrono::duration_cast<std::chrono::duration<float>>
+									(std::chrono::system_clock::now() - timeStart).count();
+		timeStart = std::chrono::system_clock::now();
 
-		extRangeBegin = extRangeEnd;
-		size_t uniqueMatches = 0;
-		int32_t prevPos = 0;
-		while (extRangeEnd < vecMatches.size() &&
-			   vecMatches[extRangeBegin].extId == 
-			   vecMatches[extRangeEnd].extId)
+		const int STAT_WND = 10000;
+		std::vector<OverlapRange> divStatWindows(curLen / STAT_WND + 1);
+
+		std::vector<OverlapRange> detectedOverlaps;
+		size_t extRangeBegin = 0;
+		size_t extRangeEnd = 0;
+		while(extRangeEnd < vecMatches.size())
 		{
-			if (vecMatches[extRangeEnd].curPos != prevPos)
+			if (maxOverlaps != 0 &&
+				detectedOverlaps.size() >= (size_t)maxOverlaps) break;
+
+			extRangeBegin = extRangeEnd;
+			size_t uniqueMatches = 0;
+			int32_t prevPos = 0;
+			while (extRangeEnd < vecMatches.size() &&
+				   vecMatches[extRangeBegin].extId == 
+				   vecMatches[extRangeEnd].extId)
 			{
-				++uniqueMatches;
-				prevPos = vecMatches[extRangeEnd].curPos;
+				if (vecMatches[extRangeEnd].curPos != prevPos)
+				{
+					++uniqueMatches;
+					prevPos = vecMatches[extRangeEnd].curPos;
+				}
+				++extRangeEnd;
 			}
-			++extRangeEnd;
-		}
-		if (uniqueMatches < minKmerSruvivalRate * _minOverlap) continue;
-
-		matchesList.assign(vecMatches.begin() + extRangeBegin,
-						   vecMatches.begin() + extRangeEnd);
-		assert(matchesList.size() > 0 && 
-			   matchesList.size() < (size_t)std::numeric_limits<int32_t>::max());
-
-		FastaRecord::Id extId = matchesList.front().extId;
-		int32_t extLen = _seqContainer.seqLen(extId);
-
-		//pre-filtering
-		int32_t minCur = matchesList.front().curPos;
-		int32_t maxCur = matchesList.back().curPos;
-		int32_t minExt = std::numeric_limits<int32_t>::max();
-		int32_t maxExt = std::numeric_limits<int32_t>::min();
-		for (const auto& match : matchesList)
-		{
-			minExt = std::min(minExt, match.extPos);
-			maxExt = std::max(maxExt, match.extPos);
-		}
-		if (maxCur - minCur < _minOverlap || 
-			maxExt - minExt < _minOverlap) continue;
-		if (_checkOverhang && !forceLocal)
-		{
-			if (std::min(minCur, minExt) > _maxOverhang) continue;
-			if (std::min(curLen - maxCur, 
-						 extLen - maxExt) > _maxOverhang) continue;
-		}
-		//++uniqueCandidates;
-
-		//chain matiching positions with DP
-		scoreTable.assign(matchesList.size(), 0);
-		backtrackTable.assign(matchesList.size(), -1);
+			if (uniqueMatches < minKmerSruvivalRate * _minOverlap) continue;
+
+			matchesList.assign(vecMatches.begin() + extRangeBegin,
+							   vecMatches.begin() + extRangeEnd);
+			assert(matchesList.size() > 0 && 
+				   matchesList.size() < (size_t)std::numeric_limits<int32_t>::max());
+
+			FastaRecord::Id extId = matchesList.front().extId;
+			int32_t extLen = _seqContainer.seqLen(extId);
+
+			//pre-filtering
+			int32_t minCur = matchesList.front().curPos;
+			int32_t maxCur = matchesList.back().curPos;
+			int32_t minExt = std::numeric_limits<int32_t>::max();
+			int32_t maxExt = std::numeric_limits<int32_t>::min();
+			for (const auto& match : matchesList)
+			{
+				minExt = std::min(minExt, match.extPos);
+				maxExt = std::max(maxExt, match.extPos);
+			}
+			if (maxCur - minCur < _minOverlap || 
+				maxExt - minExt < _minOverlap) continue;
+			if (_checkOverhang && !forceLocal)
+			{
+				if (std::min(minCur, minExt) > _maxOverhang) continue;
+				if (std::min(curLen - maxCur, 
+							 extLen - maxExt) > _maxOverhang) continue;
+			}
+			//++uniqueCandidates;
 
-		bool extSorted = extLen > curLen;
-		if (extSorted)
-		{
-			std::sort(matchesList.begin(), matchesList.end(),
-					  [](const KmerMatch& k1, const KmerMatch& k2)
-					  {return k1.extPos < k2.extPos;});
-		}
+			//chain matiching positions with DP
+			scoreTable.assign(matchesList.size(), 0);
+			backtrackTable.assign(matchesList.size(), -1);
 
-		for (int32_t i = 1; i < (int32_t)scoreTable.size(); ++i)
-		{
-			int32_t maxScore = 0;
-			int32_t maxId = 0;
-			int32_t curNext = matchesList[i].curPos;
-			int32_t extNext = matchesList[i].extPos;
-			//int32_t noImprovement = 0;
+			bool extSorted = extLen > curLen;
+			if (extSorted)
+			{
+				std::sort(matchesList.begin(), matchesList.end(),
+						  [](const KmerMatch& k1, const KmerMatch& k2)
+						  {return k1.extPos < k2.extPos;});
+			}
 
-			for (int32_t j = i - 1; j >= 0; --j)
+			for (int32_t i = 1; i < (int32_t)scoreTable.size(); ++i)
 			{
-				int32_t curPrev = matchesList[j].curPos;
-				int32_t extPrev = matchesList[j].extPos;
-				int32_t jumpDiv = abs((curNext - curPrev) - 
-									  (extNext - extPrev));
-				if (0 < curNext - curPrev && curNext - curPrev < _maxJump &&
-					0 < extNext - extPrev && extNext - extPrev < _maxJump &&
-					jumpDiv <= MAX_GAP)
+				int32_t maxScore = 0;
+				int32_t maxId = 0;
+				int32_t curNext = matchesList[i].curPos;
+				int32_t extNext = matchesList[i].extPos;
+				//int32_t noImprovement = 0;
+
+				for (int32_t j = i - 1; j >= 0; --j)
 				{
-					int32_t matchScore = 
-						std::min(std::min(curNext - curPrev, extNext - extPrev),
-										  kmerSize);
-					//int32_t gapCost = jumpDiv ? 
-					//		kmerSize * jumpDiv + ilog2_32(jumpDiv) : 0;
-					int32_t gapCost = (jumpDiv > GAP_JUMP_THLD ? LG_GAP : SM_GAP) * jumpDiv;
-					int32_t nextScore = scoreTable[j] + matchScore - gapCost;
-					if (nextScore > maxScore)
+					int32_t curPrev = matchesList[j].curPos;
+					int32_t extPrev = matchesList[j].extPos;
+					int32_t jumpDiv = abs((curNext - curPrev) - 
+										  (extNext - extPrev));
+					if (0 < curNext - curPrev && curNext - curPrev < _maxJump &&
+						0 < extNext - extPrev && extNext - extPrev < _maxJump &&
+						jumpDiv <= MAX_GAP)
 					{
-						maxScore = nextScore;
-						maxId = j;
-						//noImprovement = 0;
+						int32_t matchScore = 
+							std::min(std::min(curNext - curPrev, extNext - extPrev),
+											  kmerSize);
+						//int32_t gapCost = jumpDiv ? 
+						//		kmerSize * jumpDiv + ilog2_32(jumpDiv) : 0;
+						int32_t gapCost = (jumpDiv > GAP_JUMP_THLD ? LG_GAP : SM_GAP) * jumpDiv;
+						int32_t nextScore = scoreTable[j] + matchScore - gapCost;
+						if (nextScore > maxScore)
+						{
+							maxScore = nextScore;
+							maxId = j;
+							//noImprovement = 0;
 
-						if (jumpDiv == 0 && curNext - curPrev < kmerSize) break;
+							if (jumpDiv == 0 && curNext - curPrev < kmerSize) break;
+						}
+						/*else
+						{
+							if (++noImprovement > MAX_LOOK_BACK) break;
+						}*/
 					}
-					/*else
-					{
-						if (++noImprovement > MAX_LOOK_BACK) break;
-					}*/
+					if (extSorted && extNext - extPrev > _maxJump) break;
+					if (!extSorted && curNext - curPrev > _maxJump) break;
 				}
-				if (extSorted && extNext - extPrev > _maxJump) break;
-				if (!extSorted && curNext - curPrev > _maxJump) break;
-			}
 
-			scoreTable[i] = std::max(maxScore, kmerSize);
-			if (maxScore > kmerSize)
-			{
-				backtrackTable[i] = maxId;
+				scoreTable[i] = std::max(maxScore, kmerSize);
+				if (maxScore > kmerSize)
+				{
+					backtrackTable[i] = maxId;
+				}
 			}
-		}
 
-		//backtracking
-		std::vector<OverlapRange> extOverlaps;
-		//std::vector<int32_t> shifts;
-		std::vector<std::pair<int32_t, int32_t>> kmerMatches;
+			//backtracking
+			std::vector<OverlapRange> extOverlaps;
+			//std::vector<int32_t> shifts;
+			std::vector<std::pair<int32_t, int32_t>> kmerMatches;
 		
-		//initiate chains from the highest scores in the table (e.g. local maximums)
-		std::vector<size_t> orderedScores(backtrackTable.size());
-		std::iota(orderedScores.begin(), orderedScores.end(), 0);
-		std::sort(orderedScores.begin(), orderedScores.end(),
-				  [](size_t a, size_t b) {return scoreTable[a] > scoreTable[b];});
-
-		//for (int32_t chainStart = backtrackTable.size() - 1; 
-		//	 chainStart > 0; --chainStart)
-		for (int32_t chainStart : orderedScores)
-		{
-			if (backtrackTable[chainStart] == -1) continue;
+			//initiate chains from the highest scores in the table (e.g. local maximums)
+			std::vector<size_t> orderedScores(backtrackTable.size());
+			std::iota(orderedScores.begin(), orderedScores.end(), 0);
+			std::sort(orderedScores.begin(), orderedScores.end(),
+					  [](size_t a, size_t b) {return scoreTable[a] > scoreTable[b];});
+
+			//for (int32_t chainStart = backtrackTable.size() - 1; 
+			//	 chainStart > 0; --chainStart)
+			for (int32_t chainStart : orderedScores)
+			{
+				if (backtrackTable[chainStart] == -1) continue;
 
-			//int32_t chainMaxScore = scoreTable[chainStart];
-			int32_t lastMatch = chainStart;
-			int32_t firstMatch = 0;
+				//int32_t chainMaxScore = scoreTable[chainStart];
+				int32_t lastMatch = chainStart;
+				int32_t firstMatch = 0;
 
-			int32_t chainLength = 0;
-			//shifts.clear();
-			kmerMatches.clear();
+				int32_t chainLength = 0;
+				//shifts.clear();
+				kmerMatches.clear();
 			
-			int32_t pos = chainStart;
-			while (pos != -1)
-			{
-				//found a new maximum, shorten the chain end
-				/*if (scoreTable[pos] > chainMaxScore)
-				{
-					chainMaxScore = scoreTable[pos];
-					lastMatch = pos;
-					chainLength = 0;
-					shifts.clear();
-					kmerMatches.clear();
-				}*/
-
-				firstMatch = pos;
-				//shifts.push_back(matchesList[pos].curPos - 
-				//				 matchesList[pos].extPos);
-				++chainLength;
-
-				if (_keepAlignment)
+				int32_t pos = chainStart;
+				while (pos != -1)
 				{
-					if (kmerMatches.empty() || 
-						kmerMatches.back().first - matchesList[pos].curPos >
-						kmerSize)
+					//found a new maximum, shorten the chain end
+					/*if (scoreTable[pos] > chainMaxScore)
 					{
-						kmerMatches.emplace_back(matchesList[pos].curPos,
-								 				 matchesList[pos].extPos);
+						chainMaxScore = scoreTable[pos];
+						lastMatch = pos;
+						chainLength = 0;
+						shifts.clear();
+						kmerMatches.clear();
+					}*/
+
+					firstMatch = pos;
+					//shifts.push_back(matchesList[pos].curPos - 
+					//				 matchesList[pos].extPos);
+					++chainLength;
+
+					if (_keepAlignment)
+					{
+						if (kmerMatches.empty() || 
+							kmerMatches.back().first - matchesList[pos].curPos >
+							kmerSize)
+						{
+							kmerMatches.emplace_back(matchesList[pos].curPos,
+									 				 matchesList[pos].extPos);
+						}
 					}
-				}
 
-				assert(pos >= 0 && pos < (int32_t)backtrackTable.size());
-				int32_t newPos = backtrackTable[pos];
-				backtrackTable[pos] = -1;
-				pos = newPos;
-			}
+					assert(pos >= 0 && pos < (int32_t)backtrackTable.size());
+					int32_t newPos = backtrackTable[pos];
+					backtrackTable[pos] = -1;
+					pos = newPos;
+				}
 
-			//Logger::get().debug() << chainStart - firstMatch << " " << lastMatch - firstMatch;
+				//Logger::get().debug() << chainStart - firstMatch << " " << lastMatch - firstMatch;
 
-			OverlapRange ovlp(fastaRec.id, matchesList.front().extId,
-							  matchesList[firstMatch].curPos, 
-							  matchesList[firstMatch].extPos,
-							  curLen, extLen);
-			ovlp.curEnd = matchesList[lastMatch].curPos + kmerSize - 1;
-			ovlp.extEnd = matchesList[lastMatch].extPos + kmerSize - 1;
-			ovlp.score = scoreTable[lastMatch] - scoreTable[firstMatch] + 
-						 kmerSize - 1;
+				OverlapRange ovlp(fastaRec.id, matchesList.front().extId,
+								  matchesList[firstMatch].curPos, 
+								  matchesList[firstMatch].extPos,
+								  curLen, extLen);
+				ovlp.curEnd = matchesList[lastMatch].curPos + kmerSize - 1;
+				ovlp.extEnd = matchesList[lastMatch].extPos + kmerSize - 1;
+				ovlp.score = scoreTable[lastMatch] - scoreTable[firstMatch] + 
+							 kmerSize - 1;
 
-			if (this->overlapTest(ovlp, forceLocal))
-			{
-				if (_keepAlignment)
+				if (this->overlapTest(ovlp, forceLocal))
 				{
-					kmerMatches.emplace_back(ovlp.curBegin, ovlp.extBegin);
-					std::reverse(kmerMatches.begin(), kmerMatches.end());
-					kmerMatches.emplace_back(ovlp.curEnd, ovlp.extEnd);
-					ovlp.kmerMatches = new std::vector<std::pair<int32_t, int32_t>>();
-					ovlp.kmerMatches->swap(kmerMatches);
-				}
-				//ovlp.leftShift = median(shifts);
-				//ovlp.rightShift = extLen - curLen + ovlp.leftShift;
+					if (_keepAlignment)
+					{
+						kmerMatches.emplace_back(ovlp.curBegin, ovlp.extBegin);
+						std::reverse(kmerMatches.begin(), kmerMatches.end());
+						kmerMatches.emplace_back(ovlp.curEnd, ovlp.extEnd);
+						compactKmerMatches(kmerMatches);
+						ovlp.kmerMatches = new std::vector<std::pair<int32_t, int32_t>>
+							(kmerMatches.begin(), kmerMatches.end());
+					}
+					//ovlp.leftShift = median(shifts);
+					//ovlp.rightShift = extLen - curLen + ovlp.leftShift;
 
-				//estimating identity using k-mers
-				int32_t filteredPositions = 0;
-				for (auto pos : curFilteredPos)
-				{
-					if (pos < ovlp.curBegin) continue;
-					if (pos > ovlp.curEnd) break;
-					++filteredPositions;
+					//estimating identity using k-mers
+					int32_t filteredPositions = 0;
+					for (auto pos : curFilteredPos)
+					{
+						if (pos < ovlp.curBegin) continue;
+						if (pos > ovlp.curEnd) break;
+						++filteredPositions;
+					}
+					float normLen = std::max(ovlp.curRange(), 
+											 ovlp.extRange()) - filteredPositions;
+					float matchRate = (float)chainLength * 
+									  _vertexIndex.getSampleRate() / normLen;
+					matchRate = std::min(matchRate, 1.0f);
+					//float repeatRate = (float)filteredPositions / ovlp.curRange();
+					ovlp.seqDivergence = std::log(1 / matchRate) / kmerSize;
+					//ovlp.seqDivergence += _estimatorBias;
+					extOverlaps.push_back(ovlp);
 				}
-				float normLen = std::max(ovlp.curRange(), 
-										 ovlp.extRange()) - filteredPositions;
-				float matchRate = (float)chainLength * 
-								  _vertexIndex.getSampleRate() / normLen;
-				matchRate = std::min(matchRate, 1.0f);
-				//float repeatRate = (float)filteredPositions / ovlp.curRange();
-				ovlp.seqDivergence = std::log(1 / matchRate) / kmerSize;
-				//ovlp.seqDivergence += _estimatorBias;
-				extOverlaps.push_back(ovlp);
 			}
-		}
 
-		//now we have a lits of (possibly multiple) putative overlaps
-		//agains a singe ext sequence. Now, select the list of primary overlaps
-		std::vector<OverlapRange> primaryOverlaps;
-		std::sort(extOverlaps.begin(), extOverlaps.end(),
-				  [](const OverlapRange& r1, const OverlapRange& r2)
-				  {return r1.score > r2.score;});
+			//now we have a lits of (possibly multiple) putative overlaps
+			//agains a singe ext sequence. Now, select the list of primary overlaps
+			std::vector<OverlapRange> primaryOverlaps;
+			std::sort(extOverlaps.begin(), extOverlaps.end(),
+					  [](const OverlapRange& r1, const OverlapRange& r2)
+					  {return r1.score > r2.score;});
 
-		if (_onlyMaxExt)	//select single best overlap
-		{
-			if (!extOverlaps.empty()) primaryOverlaps.push_back(extOverlaps.front());
-		}
-		else
-		{
-			for (const auto& ovlp : extOverlaps)
+			if (_onlyMaxExt)	//select single best overlap
 			{
-				bool isContained = false;
-				for (const auto& prim : primaryOverlaps)
+				if (!extOverlaps.empty()) primaryOverlaps.push_back(extOverlaps.front());
+			}
+			else
+			{
+				for (const auto& ovlp : extOverlaps)
 				{
-					if (ovlp.containedBy(prim) && prim.score > ovlp.score)
+					bool isContained = false;
+					for (const auto& prim : primaryOverlaps)
 					{
-						isContained = true;
-						break;
+						if (ovlp.containedBy(prim) && prim.score > ovlp.score)
+						{
+							isContained = true;
+							break;
+						}
+					}
+					if (!isContained)
+					{
+						primaryOverlaps.push_back(ovlp);
 					}
-				}
-				if (!isContained)
-				{
-					primaryOverlaps.push_back(ovlp);
 				}
 			}
-		}
 
-		//divergence check for the selected primary overlaps
-		for (auto& ovlp : primaryOverlaps)
-		{
-			if(_nuclAlignment)	//identity using base-level alignment
+			//divergence check for the selected primary overlaps
+			for (auto& ovlp : primaryOverlaps)
 			{
-				ovlp.seqDivergence = getAlignmentErrEdlib(ovlp, fastaRec.sequence, 
-														   _seqContainer.getSeq(extId),
-														   _maxDivergence, _useHpc);
-			}
+				if(_nuclAlignment)	//identity using base-level alignment
+				{
+					ovlp.seqDivergence = getAlignmentErrEdlib(ovlp, fastaRec.sequence, 
+															   _seqContainer.getSeq(extId),
+															   _maxDivergence, _useHpc);
+				}
 
-			if (ovlp.seqDivergence < _maxDivergence)
-			{
-				detectedOverlaps.push_back(ovlp);
-			}
-			//if alignment not passing thrshold, check if its parts do
-			else if (_partitionBadMappings)
-			{
-				auto trimmedOverlaps = 
-					checkIdyAndTrim(ovlp, fastaRec.sequence, 
-								    _seqContainer.getSeq(extId),
-								    _maxDivergence, _minOverlap, _useHpc);
-				for (auto& trimOvlp : trimmedOverlaps)
+				if (ovlp.seqDivergence < _maxDivergence)
 				{
-					detectedOverlaps.push_back(trimOvlp);
+					detectedOverlaps.push_back(ovlp);
+				}
+				//if alignment not passing thrshold, check if its parts do
+				else if (_partitionBadMappings)
+				{
+					auto trimmedOverlaps = 
+						checkIdyAndTrim(ovlp, fastaRec.sequence, 
+									    _seqContainer.getSeq(extId),
+									    _maxDivergence, _minOverlap, _useHpc);
+					for (auto& trimOvlp : trimmedOverlaps)
+					{
+						detectedOverlaps.push_back(trimOvlp);
+					}
 				}
-			}
 
-			//statistics
-			size_t wnd = ovlp.curBegin / STAT_WND;
-			if (ovlp.curRange() > divStatWindows[wnd].curRange())
-			{
-				divStatWindows[wnd] = ovlp;
+				//statistics
+				size_t wnd = ovlp.curBegin / STAT_WND;
+				if (ovlp.curRange() > divStatWindows[wnd].curRange())
+				{
+					divStatWindows[wnd] = ovlp;
+				}
 			}
 		}
-	}
 
-	timeDp += std::chrono::duration_cast<std::chrono::duration<float>>
-				(std::chrono::system_clock::now() - timeStart).count();
-	timeStart = std::chrono::system_clock::now();
+		timeDp += std::chrono::duration_cast<std::chrono::duration<float>>
+					(std::chrono::system_clock::now() - timeStart).count();
+		timeStart = std::chrono::system_clock::now();
 
-	for (const auto& ovlp : divStatWindows)
-	{
-		if (ovlp.curRange() > 0)
+		for (const auto& ovlp : divStatWindows)
 		{
-			divStats.add(ovlp.seqDivergence);
+			if (ovlp.curRange() > 0)
+			{
+				divStats.add(ovlp.seqDivergence);
+			}
 		}
+		batchOverlaps.push_back(std::move(detectedOverlaps));
 	}
-	return detectedOverlaps;
+	return batchOverlaps;
 }
 
 bool OverlapContainer::hasSelfOverlaps(FastaRecord::Id readId)
@@ -536,36 +638,49 @@ std::vector<OverlapRange>
 									  _divergenceStats, maxOverlaps);
 }
 
-const std::vector<OverlapRange>&
-	OverlapContainer::lazySeqOverlaps(FastaRecord::Id readId)
+std::vector<std::vector<OverlapRange>> 
+	OverlapContainer::quickSeqOverlapsBatch(const std::vector<FastaRecord::Id>& readIds,
+											int maxOverlaps, bool forceLocal)
 {
-	bool flipped = !readId.strand();
-	if (flipped) readId = readId.rc();
-	IndexVecWrapper wrapper;
+	std::vector<const FastaRecord*> records;
+	for (auto readId : readIds) records.push_back(&_queryContainer.getRecord(readId));
+	return _ovlpDetect.getSeqOverlapsBatch(records, forceLocal, 
+										   _divergenceStats, maxOverlaps);
+}
 
-	//upsert creates default value if it does not exist
-	_overlapIndex.upsert(readId, 	
-		[&wrapper](IndexVecWrapper& val)
-			{wrapper = val;});
-	if (wrapper.cached)
+std::vector<std::vector<FastaRecord::Id>> 
+	OverlapContainer::makeBatches(const std::vector<FastaRecord::Id>& readIds) const
+{
+	//large enough to amortize the index queries, 
+	//but keeps the per-thread buffers small
+	const size_t BATCH_LEN = 256 * 1024;
+
+	std::vector<std::vector<FastaRecord::Id>> batches;
+	size_t batchLen = BATCH_LEN;
+	for (auto readId : readIds)
 	{
-		return !flipped ? *wrapper.fwdOverlaps : *wrapper.revOverlaps;
+		if (batchLen >= BATCH_LEN)
+		{
+			batches.emplace_back();
+			batchLen = 0;
+		}
+		batches.back().push_back(readId);
+		batchLen += _queryContainer.seqLen(readId);
 	}
+	return batches;
+}
 
-	//otherwise, need to compute overlaps.
-	//do it for forward strand to be distinct
-	//bool suggestChimeric;
-	const bool DEFAULT_LOCAL = false;
-	const FastaRecord& record = _queryContainer.getRecord(readId);
-	auto overlaps = _ovlpDetect.getSeqOverlaps(record, DEFAULT_LOCAL, 
-											   _divergenceStats,
-											   _ovlpDetect._maxCurOverlaps);
+OverlapContainer::IndexVecWrapper 
+	OverlapContainer::storeOverlaps(FastaRecord::Id readId,
+									std::vector<OverlapRange>& overlaps)
+{
 	overlaps.shrink_to_fit();
-
 	std::vector<OverlapRange> revOverlaps;
 	revOverlaps.reserve(overlaps.size());
 	for (const auto& ovlp : overlaps) revOverlaps.push_back(ovlp.complement());
 
+	IndexVecWrapper wrapper;
+	_overlapIndex.insert(readId);	//ensure it's in the table
 	_overlapIndex.update_fn(readId,
 		[&wrapper, &overlaps, &revOverlaps, this]
 		(IndexVecWrapper& val)
@@ -580,6 +695,34 @@ const std::vector<OverlapRange>&
 			}
 			wrapper = val;
 		});
+	return wrapper;
+}
+
+const std::vector<OverlapRange>&
+	OverlapContainer::lazySeqOverlaps(FastaRecord::Id readId)
+{
+	bool flipped = !readId.strand();
+	if (flipped) readId = readId.rc();
+	IndexVecWrapper wrapper;
+
+	//upsert creates default value if it does not exist
+	_overlapIndex.upsert(readId, 	
+		[&wrapper](IndexVecWrapper& val)
+			{wrapper = val;});
+	if (wrapper.cached)
+	{
+		return !flipped ? *wrapper.fwdOverlaps : *wrapper.revOverlaps;
+	}
+
+	//otherwise, need to compute overlaps.
+	//do it for forward strand to be distinct
+	//bool suggestChimeric;
+	const bool DEFAULT_LOCAL = false;
+	const FastaRecord& record = _queryContainer.getRecord(readId);
+	auto overlaps = _ovlpDetect.getSeqOverlaps(record, DEFAULT_LOCAL, 
+											   _divergenceStats,
+											   _ovlpDetect._maxCurOverlaps);
+	wrapper = this->storeOverlaps(readId, overlaps);
 
 	return !flipped ? *wrapper.fwdOverlaps : *wrapper.revOverlaps;
 }
@@ -650,13 +793,20 @@ void OverlapContainer::findAllOverlaps()
 		}
 	}
 
-	std::mutex indexMutex;
-	std::function<void(const FastaRecord::Id&)> indexUpdate = 
-	[this] (const FastaRecord::Id& seqId)
+	auto queryBatches = this->makeBatches(allQueries);
+	std::function<void(const std::vector<FastaRecord::Id>&)> indexUpdate = 
+	[this] (const std::vector<FastaRecord::Id>& batch)
 	{
-		this->lazySeqOverlaps(seqId);	//automatically stores overlaps
+		const bool DEFAULT_LOCAL = false;
+		auto batchOverlaps = this->quickSeqOverlapsBatch(batch, 
+											_ovlpDetect._maxCurOverlaps,
+											DEFAULT_LOCAL);
+		for (size_t i = 0; i < batch.size(); ++i)
+		{
+			this->storeOverlaps(batch[i], batchOverlaps[i]);
+		}
 	};
-	processInParallel(allQueries, indexUpdate, 
+	processInParallel(queryBatches, indexUpdate, 
 					  Parameters::get().numThreads, true);
 	this->ensureTransitivity(false);
 
@@ -704,17 +854,13 @@ void OverlapContainer::filterOverlaps()
 	{
 		auto& overlaps = this->unsafeSeqOverlaps(seqId);
 		
-		SetVec<OverlapRange*> overlapSets;
-		for (auto& ovlp : overlaps) 
-		{
-			overlapSets.push_back(new SetNode<OverlapRange*>(&ovlp));
-		}
-		for (size_t i = 0; i < overlapSets.size(); ++i)
+		DisjointSet overlapSets(overlaps.size());
+		for (size_t i = 0; i < overlaps.size(); ++i)
 		{
-			for (size_t j = 0; j < overlapSets.size(); ++j)
+			for (size_t j = 0; j < overlaps.size(); ++j)
 			{
-				OverlapRange& ovlpOne = *overlapSets[i]->data;
-				OverlapRange& ovlpTwo = *overlapSets[j]->data;
+				OverlapRange& ovlpOne = overlaps[i];
+				OverlapRange& ovlpTwo = overlaps[j];
 
 				if (ovlpOne.extId != ovlpTwo.extId) continue;
 				int curDiff = ovlpOne.curRange() - ovlpOne.curIntersect(ovlpTwo);
@@ -722,20 +868,20 @@ void OverlapContainer::filterOverlaps()
 
 				if (curDiff < MAX_ENDS_DIFF && extDiff < MAX_ENDS_DIFF) 
 				{
-					unionSet(overlapSets[i], overlapSets[j]);
+					overlapSets.unionSet(i, j);
 				}
 			}
 		}
 		auto clusters = groupBySet(overlapSets);
 		std::vector<OverlapRange> newOvlps;
-		for (const auto& cluster : clusters)
+		for (size_t cl = 0; cl < clusters.size(); ++cl)
 		{
 			OverlapRange* maxOvlp = nullptr;
-			for (auto& ovlp : cluster.second)
+			for (size_t ovlpId : clusters[cl])
 			{
-				if (!maxOvlp || ovlp->score > maxOvlp->score)
+				if (!maxOvlp || overlaps[ovlpId].score > maxOvlp->score)
 				{
-					maxOvlp = ovlp;
+					maxOvlp = &overlaps[ovlpId];
 				}
 			}
 			newOvlps.push_back(*maxOvlp);
@@ -344,6 +344,12 @@ private:
 				   OvlpDivStats& divergenceStats,
 				   int maxOverlaps) const;
 
+	std::vector<std::vector<OverlapRange>>
+	getSeqOverlapsBatch(const std::vector<const FastaRecord*>& records, 
+				   		bool forceLocal,
+				   		OvlpDivStats& divergenceStats,
+				   		int maxOverlaps) const;
+
 	bool    overlapTest(const OverlapRange& ovlp, bool forceLocal) const;
 
 	const int   _maxJump;
@@ -414,6 +420,16 @@ public:
 											   int maxOverlaps=0,
 											   bool forceLocal=false);
 
+	//same as quickSeqOverlaps, but for a batch of reads. The k-mer
+	//index is queried once per distinct k-mer of the batch
+	std::vector<std::vector<OverlapRange>> 
+		quickSeqOverlapsBatch(const std::vector<FastaRecord::Id>& readIds, 
+							  int maxOverlaps=0, bool forceLocal=false);
+
+	//splits reads into batches of roughly equal total length
+	std::vector<std::vector<FastaRecord::Id>> 
+		makeBatches(const std::vector<FastaRecord::Id>& readIds) const;
+
 	size_t indexSize() {return _indexSize;}
 
 	void estimateOverlaperParameters();
@@ -442,6 +458,8 @@ public:
 
 private:
 	std::vector<OverlapRange>& unsafeSeqOverlaps(FastaRecord::Id);
+	IndexVecWrapper storeOverlaps(FastaRecord::Id readId,
+								  std::vector<OverlapRange>& overlaps);
 	//std::vector<OverlapRange>  seqOverlaps(FastaRecord::Id readId,
 	//									   bool& outSuggestChimeric) const;
 	void filterOverlaps();
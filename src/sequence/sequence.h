@@ -10,8 +10,10 @@
 #include <iostream>
 #include <algorithm>
 #include <stdexcept>
+#include <atomic>
 
-//Immutable dna sequence class
+//Immutable dna sequence class. Copies, complements and substrings
+//are views (offset and length) into the same shared buffer
 class DnaSequence
 {
 public:
@@ -24,14 +26,14 @@ private:
 	struct SharedBuffer
 	{
 		SharedBuffer(): useCount(0), length(0) {}
-		size_t useCount;
+		std::atomic<size_t> useCount;
 		size_t length;
 		std::vector<size_t> chunks;
 	};
 
 public:
 	DnaSequence():
-		_complement(false)
+		_offset(0), _length(0), _complement(false)
 	{
 		_data = new SharedBuffer;
 		++_data->useCount;
@@ -42,8 +44,7 @@ public:
 		if (_data != nullptr)
 		{
 			//std::cout << "Destructor!\n";
-			--_data->useCount;
-			if (_data->useCount == 0) 
+			if (--_data->useCount == 0) 
 			{
 				//std::cout << "Deleting\n";
 				delete _data;
@@ -52,7 +53,7 @@ public:
 	}
 
 	explicit DnaSequence(const std::string& string):
-		_complement(false)
+		_offset(0), _length(string.length()), _complement(false)
 	{
 		_data = new SharedBuffer;
 		++_data->useCount;
@@ -70,6 +71,8 @@ public:
 
 	DnaSequence(const DnaSequence& other):
 		_data(other._data),
+		_offset(other._offset),
+		_length(other._length),
 		_complement(other._complement)
 	{
 		++_data->useCount;
@@ -77,6 +80,8 @@ public:
 
 	DnaSequence(DnaSequence&& other):
 		_data(other._data),
+		_offset(other._offset),
+		_length(other._length),
 		_complement(other._complement)
 	{
 		other._data = nullptr;
@@ -86,10 +91,11 @@ public:
 	{
 		if (this == &other) return *this;
 
-		--_data->useCount;
-		if (_data->useCount == 0) delete _data;
+		if (--_data->useCount == 0) delete _data;
 
 		_complement = other._complement;
+		_offset = other._offset;
+		_length = other._length;
 		_data = other._data;
 		++_data->useCount;
 		return *this;
@@ -99,23 +105,21 @@ public:
 	{
 		if (this == &other) return *this;
 
-		--_data->useCount;
-		if (_data->useCount == 0) delete _data;
+		if (--_data->useCount == 0) delete _data;
 
 		_data = other._data;
+		_offset = other._offset;
+		_length = other._length;
 		_complement = other._complement;
 		other._data = nullptr;
 		return *this;
 	}
 
-	size_t length() const {return _data->length;}
+	size_t length() const {return _length;}
 
 	char at(size_t index) const 
 	{
-		if (_complement)
-		{
-			index = _data->length - index - 1;
-		}
+		index = this->bufferIndex(index);
 		size_t id = (_data->chunks[index / NUCL_IN_CHUNK] >> 
 					 (index % NUCL_IN_CHUNK) * 2 ) & 3;
 		return idToDna(!_complement ? id : ~id & 3);
@@ -123,21 +127,16 @@ public:
 
 	NuclType atRaw(size_t index) const 
 	{
-		if (_complement)
-		{
-			index = _data->length - index - 1;
-		}
+		index = this->bufferIndex(index);
 		size_t id = (_data->chunks[index / NUCL_IN_CHUNK] >> 
 					 (index % NUCL_IN_CHUNK) * 2 ) & 3;
 		return !_complement ? id : ~id & 3;
 	}
 	
-	//TODO: use the same shared buffer
-	
 	DnaSequence complement() const
 	{
 		DnaSequence complSequence(*this);
-		complSequence._complement = true;
+		complSequence._complement = !_complement;
 		return complSequence;
 	}
 
@@ -180,7 +179,15 @@ private:
 	};
 	static TableFiller _filler;
 
+	size_t bufferIndex(size_t index) const
+	{
+		return !_complement ? _offset + index : 
+							  _offset + _length - index - 1;
+	}
+
 	SharedBuffer* _data;
+	size_t _offset;
+	size_t _length;
 	bool _complement;
 };
 
@@ -198,23 +205,18 @@ inline std::string DnaSequence::str() const
 inline DnaSequence DnaSequence::substr(size_t start, size_t length) const 
 {
 	if (length == 0) throw std::runtime_error("Zero length subtring");
-	if (start >= _data->length) throw std::runtime_error("Incorrect substring start");
-
-	if (start + length > _data->length)
-	{
-		length = _data->length - start;
-	}
-
-	DnaSequence newSequence;
-	newSequence._data->length = length;
-	newSequence._data->chunks.assign((length - 1) / NUCL_IN_CHUNK + 1, 0);
+	if (start >= _length) throw std::runtime_error("Incorrect substring start");
 
-	for (size_t i = 0; i < length; ++i)
+	if (start + length > _length)
 	{
-		size_t nucId = this->atRaw(start + i);
-		size_t newChunkId = i / NUCL_IN_CHUNK;
-		newSequence._data->chunks[newChunkId] |= nucId << (i % NUCL_IN_CHUNK) * 2;
+		length = _length - start;
 	}
 
+	//the substring references the same buffer. For the complement
+	//sequence, the view is counted from the other end of the buffer
+	DnaSequence newSequence(*this);
+	newSequence._offset = !_complement ? _offset + start : 
+										 _offset + _length - start - length;
+	newSequence._length = length;
 	return newSequence;
 }
@@ -142,8 +142,69 @@ const FastaRecord&
 	return _seqIndex[newId._id - _seqIdOffest];
 }
 
+const FastaRecord& 
+	SequenceContainer::addMetadata(const std::string& description,
+								   int32_t length)
+{
+	if (_metadataLengths.size() != _seqIndex.size())
+	{
+		throw std::runtime_error("Can't mix metadata and sequence records");
+	}
+	auto newId = this->addSequence({DnaSequence(), description, 
+								   FastaRecord::ID_NONE});
+	_metadataLengths.push_back(length);
+	_metadataLengths.push_back(length);
+	return _seqIndex[newId._id - _seqIdOffest];
+}
+
+void SequenceContainer::loadSequences(const std::vector<std::string>& fileNames,
+									  const std::unordered_set<FastaRecord::Id>& seqIds)
+{
+	std::unordered_set<std::string> namesFilter;
+	for (auto seqId : seqIds)
+	{
+		if (!seqId.strand()) seqId = seqId.rc();
+		namesFilter.insert(this->seqName(seqId).substr(1));
+	}
+	if (namesFilter.empty()) return;
+
+	size_t numLoaded = 0;
+	for (auto& fileName : fileNames)
+	{
+		std::vector<FastaRecord> records;
+		if (this->isFasta(fileName))
+		{
+			this->readFasta(records, fileName, &namesFilter);
+		}
+		else
+		{
+			this->readFastq(records, fileName, &namesFilter);
+		}
+
+		for (auto& rec : records)
+		{
+			FastaRecord::Id seqId = _nameIndex.at("+" + rec.description);
+			size_t index = seqId._id - _seqIdOffest;
+			if ((int32_t)rec.sequence.length() != _metadataLengths[index])
+			{
+				throw ParseException("Read " + rec.description + 
+									 " does not match the metadata");
+			}
+			_seqIndex[index + 1].sequence = rec.sequence.complement();
+			_seqIndex[index].sequence = std::move(rec.sequence);
+			++numLoaded;
+		}
+	}
+	if (numLoaded != namesFilter.size())
+	{
+		throw ParseException("Some reads listed in the metadata "
+							 "were not found in the input");
+	}
+}
+
 size_t SequenceContainer::readFasta(std::vector<FastaRecord>& record, 
-									const std::string& fileName)
+									const std::string& fileName,
+									const std::unordered_set<std::string>* namesFilter)
 {
 	size_t BUF_SIZE = 32 * 1024 * 1024;
 	char* rawBuffer = new char[BUF_SIZE];
@@ -159,6 +220,7 @@ size_t SequenceContainer::readFasta(std::vector<FastaRecord>& record,
 	std::string header; 
 	std::string sequence;
 	std::string nextLine;
+	bool keepRecord = true;
 	try
 	{
 		while(!gzeof(fd))
@@ -182,19 +244,20 @@ size_t SequenceContainer::readFasta(std::vector<FastaRecord>& record,
 
 			if (nextLine[0] == '>')
 			{
-				if (!header.empty())
+				if (!header.empty() && keepRecord)
 				{
 					if (sequence.empty()) throw ParseException("empty sequence");
 
 					record.emplace_back(DnaSequence(sequence), header, 
 										FastaRecord::ID_NONE);
-					sequence.clear();
-					header.clear();
 				}
+				sequence.clear();
+				header.clear();
 				this->validateHeader(nextLine);
 				header = nextLine;
+				keepRecord = !namesFilter || namesFilter->count(header);
 			}
-			else
+			else if (keepRecord)
 			{
 				this->validateSequence(nextLine);
 				std::copy(nextLine.begin(), nextLine.end(), 
@@ -205,13 +268,16 @@ size_t SequenceContainer::readFasta(std::vector<FastaRecord>& record,
 			nextLine.clear();
 		}
 		
-		if (sequence.empty()) throw ParseException("empty sequence");
 		if (header.empty())
 		{
 			throw ParseException("Fasta fromat error");
 		}
-		record.emplace_back(DnaSequence(sequence), header, 
-							FastaRecord::ID_NONE);
+		if (keepRecord)
+		{
+			if (sequence.empty()) throw ParseException("empty sequence");
+			record.emplace_back(DnaSequence(sequence), header, 
+								FastaRecord::ID_NONE);
+		}
 
 	}
 	catch (ParseException& e)
@@ -228,7 +294,8 @@ size_t SequenceContainer::readFasta(std::vector<FastaRecord>& record,
 }
 
 size_t SequenceContainer::readFastq(std::vector<FastaRecord>& record, 
-									const std::string& fileName)
+									const std::string& fileName,
+									const std::unordered_set<std::string>* namesFilter)
 {
 
 	size_t BUF_SIZE = 32 * 1024 * 1024;
@@ -278,6 +345,13 @@ size_t SequenceContainer::readFastq(std::vector<FastaRecord>& record,
 			}
 			else if (stateCounter == 1)
 			{
+				if (namesFilter && !namesFilter->count(header))
+				{
+					stateCounter = (stateCounter + 1) % 4;
+					++lineNo;
+					nextLine.clear();
+					continue;
+				}
 				this->validateSequence(nextLine);
 				record.emplace_back(DnaSequence(nextLine), header, 
 									FastaRecord::ID_NONE);
@@ -7,6 +7,7 @@
 #include <cstdint>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <string>
 #include <limits>
 
@@ -45,6 +46,9 @@ struct FastaRecord
 		int signedId() const
 			{return (_id % 2) ? -((int)_id + 1) / 2 : (int)_id / 2 + 1;}
 
+		uint32_t rawId() const
+			{return _id;}
+
 		friend std::ostream& operator << (std::ostream& stream, const Id& id)
 		{
 			stream << std::to_string(id._id);
@@ -165,6 +169,17 @@ public:
 	const FastaRecord&  addSequence(const DnaSequence& sequence, 
 									const std::string& description);
 
+	//Adds a record with the given name and length, but without
+	//the sequence. Sequences of such records could be loaded later
+	//on demand with loadSequences()
+	const FastaRecord&  addMetadata(const std::string& description,
+									int32_t length);
+
+	//loads sequences of the selected metadata records (both strands)
+	//from the original reads files, skipping all other reads
+	void loadSequences(const std::vector<std::string>& fileNames,
+					   const std::unordered_set<FastaRecord::Id>& seqIds);
+
 	const SequenceIndex& iterSeqs() const
 	{
 		return _seqIndex;
@@ -188,6 +203,10 @@ public:
 	{
 		assert(readId._id - _seqIdOffest < _seqIndex.size());
 		assert(_seqIndex[readId._id - _seqIdOffest].id == readId);
+		if (readId._id - _seqIdOffest < _metadataLengths.size())
+		{
+			return _metadataLengths[readId._id - _seqIdOffest];
+		}
 		return _seqIndex[readId._id - _seqIdOffest].sequence.length();
 	}
 
@@ -249,11 +268,14 @@ private:
 
 	FastaRecord::Id addSequence(const FastaRecord& sequence);
 
+	//if namesFilter is set, only the reads with the given names are loaded
 	size_t readFasta(std::vector<FastaRecord>& record, 
-				     const std::string& fileName);
+				     const std::string& fileName,
+				     const std::unordered_set<std::string>* namesFilter = nullptr);
 
 	size_t readFastq(std::vector<FastaRecord>& record, 
-				     const std::string& fileName);
+				     const std::string& fileName,
+				     const std::unordered_set<std::string>* namesFilter = nullptr);
 
 	bool   isFasta(const std::string& fileName);
 
@@ -266,6 +288,9 @@ private:
 	bool   			_offsetInitialized;
 	std::unordered_map<std::string, 
 					   FastaRecord::Id> _nameIndex;
+	//lengths of the metadata records, which always precede
+	//the regular records in the index
+	std::vector<int32_t> _metadataLengths;
 
 	//global/local position convertions
 	const size_t MAX_SEQUENCE = 1ULL << (8 * 5);
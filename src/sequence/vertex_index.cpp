@@ -16,9 +16,9 @@
 #include "../common/memory_info.h"
 
 
-void VertexIndex::countKmers()
+void VertexIndex::countKmers(bool useFlatCounter, size_t expectedKmers)
 {
-	_kmerCounter.count(/*use flat counter*/ true);
+	_kmerCounter.count(useFlatCounter, expectedKmers);
 }
 
 
@@ -36,7 +36,8 @@ void VertexIndex::buildIndexUnevenCoverage(int globalMinFreq, float selectRate,
 	}
 
 	//first, count the number of k-mers that will be actually stored in the index
-	_kmerIndex.reserve(_kmerCounter.getKmerNum() / 10);
+	_kmerIndex.reserve(_expectedIndexSize > 0 ? _expectedIndexSize :
+					   _kmerCounter.getKmerNum() / 10);
 	if (_outputProgress) Logger::get().info() << "Filling index table (1/2)";
 	std::function<void(const FastaRecord::Id&)> initializeIndex = 
 	[this, globalMinFreq, selectRate, tandemFreq] (const FastaRecord::Id& readId)
@@ -262,7 +263,7 @@ void VertexIndex::buildIndexMinimizers(int minCoverage, int wndLen)
 		if (seq.id.strand()) totalLen += seq.sequence.length();
 	}
 
-	_kmerIndex.reserve(1000000);
+	_kmerIndex.reserve(_expectedIndexSize > 0 ? _expectedIndexSize : 1000000);
 	if (_outputProgress) Logger::get().info() << "Pre-calculating index storage";
 	std::function<void(const FastaRecord::Id&)> initializeIndex = 
 	[this, minCoverage, wndLen] (const FastaRecord::Id& readId)
@@ -347,6 +348,22 @@ void VertexIndex::buildIndexMinimizers(int minCoverage, int wndLen)
 }
 
 
+void VertexIndex::lookupKmers(const std::vector<Kmer>& stdKmers,
+							  std::vector<KmerLookup>& lookups) const
+{
+	//repetitive k-mers are removed from the index,
+	//so the second table is only checked on a miss
+	lookups.assign(stdKmers.size(), KmerLookup());
+	for (size_t i = 0; i < stdKmers.size(); ++i)
+	{
+		if (!_kmerIndex.find(stdKmers[i], lookups[i].positions))
+		{
+			lookups[i].repetitive = _repetitiveKmers.contains(stdKmers[i]);
+		}
+	}
+}
+
+
 void VertexIndex::clear()
 {
 	for (auto& chunk : _memoryChunks) delete[] chunk;
@@ -360,7 +377,7 @@ void VertexIndex::clear()
 }
 
 
-void KmerCounter::count(bool useFlatCounter)
+void KmerCounter::count(bool useFlatCounter, size_t expectedKmers)
 {
 	//Logger::get().debug() << "Before counter: " 
 	//	<< getPeakRSS() / 1024 / 1024 / 1024 << " Gb";
@@ -379,6 +396,10 @@ void KmerCounter::count(bool useFlatCounter)
 		_flatCounter = new std::atomic<uint8_t>[COUNTER_LEN];
 		std::memset(_flatCounter, 0, COUNTER_LEN);
 	}
+	else if (expectedKmers > 0)
+	{
+		_hashCounter.reserve(expectedKmers);
+	}
  
 	if (_outputProgress) Logger::get().info() << "Counting k-mers:";
 	std::function<void(const FastaRecord::Id&)> readUpdate = 
@@ -44,7 +44,7 @@ public:
 		return _kmerDistribution;
 	}
 
-	void   count(bool useFlatCounter);
+	void   count(bool useFlatCounter, size_t expectedKmers = 0);
 	size_t getFreq(Kmer kmer) const;
 	size_t getKmerNum() const;
 	void clear();
@@ -73,7 +73,7 @@ public:
 	VertexIndex(const SequenceContainer& seqContainer):
 		_seqContainer(seqContainer), _outputProgress(false), 
 		_sampleRate(1.0f), _repetitiveFrequency(0),
-		_kmerCounter(seqContainer)
+		_expectedIndexSize(0), _kmerCounter(seqContainer)
 		//_solidMultiplier(1)
 		//_flankRepeatSize(flankRepeatSize)
 	{}
@@ -210,7 +210,7 @@ public:
 		const SequenceContainer& seqContainer;
 	};
 
-	void countKmers();
+	void countKmers(bool useFlatCounter, size_t expectedKmers = 0);
 	void buildIndex(int minCoverage);
 	void buildIndexUnevenCoverage(int minCoverage, float selectRate, 
 								  int tandemFreq);
@@ -224,6 +224,29 @@ public:
 						  _seqContainer);
 	}
 
+	//result of the index query for a k-mer in standard form:
+	//its positions (empty if not indexed) and the repetitive flag
+	struct KmerLookup
+	{
+		KmerLookup(): repetitive(false) {}
+		ReadVector positions;
+		bool repetitive;
+	};
+
+	//queries a batch of k-mers (in standard form) at once
+	void lookupKmers(const std::vector<Kmer>& stdKmers,
+					 std::vector<KmerLookup>& lookups) const;
+
+	IterHelper iterKmerPos(const KmerLookup& lookup, bool revComp) const
+	{
+		return IterHelper(lookup.positions, revComp, _seqContainer);
+	}
+
+	void prefetchKmerPos(const KmerLookup& lookup) const
+	{
+		__builtin_prefetch(lookup.positions.data);
+	}
+
 	//__attribute__((always_inline))
 	/*bool isSolid(Kmer kmer) const
 	{
@@ -259,6 +282,10 @@ public:
 
 	float getSampleRate() const {return _sampleRate;}
 
+	//expected number of k-mers in the index, used to
+	//pre-allocate the index table. 0 if unknown
+	void setExpectedIndexSize(size_t size) {_expectedIndexSize = size;}
+
 private:
 	//void setRepeatCutoff(int minCoverage);
 
@@ -281,6 +308,7 @@ private:
 	bool    _outputProgress;
 	float   _sampleRate;
 	size_t  _repetitiveFrequency;
+	size_t  _expectedIndexSize;
 	//int32_t _solidMultiplier;
 
 	const size_t MEM_CHUNK = 32 * 1024 * 1024 / sizeof(IndexChunk);